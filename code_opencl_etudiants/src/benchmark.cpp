@@ -0,0 +1,229 @@
+#include<algorithm>
+#include<cmath>
+#include<cstdio>
+#include<ctime>
+
+#include<fcntl.h>
+#include<unistd.h>
+
+#include"benchmark.h"
+#include"roofline.h"
+
+
+/**
+  Bytes moved by a CSR MxV.
+*/
+double spmvCSRBytes(const MatrixCSR *m)
+{
+	return (double) m->nzNbr * (sizeof(float) + sizeof(uint)) + (double) (m->h + 1) * sizeof(uint)
+		+ (double) m->w * sizeof(float) + (double) m->h * sizeof(float);
+}
+
+
+/**
+  Value at rank p of sorted values, nearest rank method.
+*/
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	if( sorted.empty() )
+		return 0.0;
+
+	size_t rank = (size_t) ceil(p * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t) 1), sorted.size()) - 1];
+}
+
+
+// pure computation time of the last GPU MxV
+static double lastComputeTime = -1.0;
+
+
+/**
+  Record the pure computation time of a GPU MxV.
+*/
+void recordComputeTime(double ms)
+{
+	lastComputeTime = ms;
+}
+
+
+/**
+  Take the pure computation time of the last GPU MxV, -1 if none.
+*/
+double takeComputeTime()
+{
+	double ms = lastComputeTime;
+	lastComputeTime = -1.0;
+	return ms;
+}
+
+
+/**
+  Display the roofline figures of the last GPU MxV.
+*/
+void printRoofline(const char *name, double bytes)
+{
+	double ms = takeComputeTime();
+	if( ms <= 0.0 )
+		return;
+
+	double peakGBs = getBandwidthPeaks().gpuGBs;
+	printf("%s: %.0f bytes moved in %f ms, %f GB/s, %f%% of %f GB/s peak bandwidth.\n", name,
+		bytes, ms, bytes / (ms * 1e6), peakPercent(bytes, ms, peakGBs), peakGBs);
+}
+
+
+/**
+  Sort run times and compute the statistics of a benchmark.
+*/
+BenchResult summarizeRuns(const char *name, uint w, uint h, size_t nzNbr, double bytes,
+	std::vector<double> &times, std::vector<double> &computeTimes)
+{
+	std::sort(times.begin(), times.end());
+	std::sort(computeTimes.begin(), computeTimes.end());
+
+	BenchResult result;
+	result.name = name;
+	result.w = w;
+	result.h = h;
+	result.nzNbr = nzNbr;
+	result.bytes = bytes;
+	result.runs = (int) times.size();
+	result.min = times.empty() ? 0.0 : times[0];
+	result.median = percentile(times, 0.5);
+	result.p95 = percentile(times, 0.95);
+	result.p99 = percentile(times, 0.99);
+
+	result.computeMedian = percentile(computeTimes, 0.5);
+
+	// GPU methods are compared to the device bandwidth, without transfers
+	const BandwidthPeaks &peaks = getBandwidthPeaks();
+	bool gpu = ! computeTimes.empty();
+	double ms = gpu ? result.computeMedian : result.median;
+	result.peakGBs = gpu ? peaks.gpuGBs : peaks.cpuGBs;
+	result.peakPercent = peakPercent(bytes, ms, result.peakGBs);
+
+	// times are in ms
+	result.gflops = (ms > 0.0) ? 2.0 * nzNbr / (ms * 1e6) : 0.0;
+	result.gbs = (ms > 0.0) ? bytes / (ms * 1e6) : 0.0;
+
+	return result;
+}
+
+
+/**
+  Display the statistics of a benchmark.
+*/
+void printBenchResult(const BenchResult &result)
+{
+	printf("%s: %d runs, min %f ms, median %f ms, p95 %f ms, p99 %f ms", result.name.c_str(),
+		result.runs, result.min, result.median, result.p95, result.p99);
+	if( result.computeMedian > 0.0 )
+		printf(" (median %f ms of pure computation)", result.computeMedian);
+	printf(", %f GFLOP/s, %f GB/s, %f%% of %f GB/s peak bandwidth.\n",
+		result.gflops, result.gbs, result.peakPercent, result.peakGBs);
+}
+
+
+/**
+  Current date, ISO 8601.
+*/
+static std::string currentDate()
+{
+	char date[32];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	return date;
+}
+
+
+/**
+  Write benchmark results to a JSON file.
+*/
+bool writeBenchJSON(const char *fileName, const std::vector<BenchResult> &results)
+{
+	FILE *f = fopen(fileName, "w");
+	if( ! f )
+	{
+		printf("Warning: failed to write benchmark results in %s.\n", fileName);
+		return false;
+	}
+
+	fprintf(f, "{\n\t\"date\": \"%s\",\n\t\"results\": [\n", currentDate().c_str());
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		// method names are plain text, no character needs escaping
+		fprintf(f, "\t\t{ \"name\": \"%s\", \"width\": %u, \"height\": %u, \"nnz\": %lu, \"bytes\": %.0f, \"runs\": %d, "
+			"\"min_ms\": %g, \"median_ms\": %g, \"p95_ms\": %g, \"p99_ms\": %g, \"compute_median_ms\": %g, "
+			"\"gflops\": %g, \"gbs\": %g, \"peak_gbs\": %g, \"peak_percent\": %g }%s\n",
+			r.name.c_str(), r.w, r.h, (unsigned long) r.nzNbr, r.bytes, r.runs,
+			r.min, r.median, r.p95, r.p99, r.computeMedian, r.gflops, r.gbs, r.peakGBs, r.peakPercent,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(f, "\t]\n}\n");
+
+	fclose(f);
+	return true;
+}
+
+
+/**
+  Write benchmark results to a CSV file.
+*/
+bool writeBenchCSV(const char *fileName, const std::vector<BenchResult> &results)
+{
+	FILE *f = fopen(fileName, "w");
+	if( ! f )
+	{
+		printf("Warning: failed to write benchmark results in %s.\n", fileName);
+		return false;
+	}
+
+	std::string date = currentDate();
+	fprintf(f, "date,name,width,height,nnz,bytes,runs,min_ms,median_ms,p95_ms,p99_ms,compute_median_ms,gflops,gbs,peak_gbs,peak_percent\n");
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		fprintf(f, "%s,\"%s\",%u,%u,%lu,%.0f,%d,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", date.c_str(),
+			r.name.c_str(), r.w, r.h, (unsigned long) r.nzNbr, r.bytes, r.runs,
+			r.min, r.median, r.p95, r.p99, r.computeMedian, r.gflops, r.gbs, r.peakGBs, r.peakPercent);
+	}
+
+	fclose(f);
+	return true;
+}
+
+
+// stdout file descriptor saved while silenced
+static int savedStdout = -1;
+
+
+/**
+  Redirect stdout to /dev/null.
+*/
+void silenceStdout()
+{
+	fflush(stdout);
+	int devNull = open("/dev/null", O_WRONLY);
+	if( devNull < 0 )
+		return;
+
+	savedStdout = dup(STDOUT_FILENO);
+	dup2(devNull, STDOUT_FILENO);
+	close(devNull);
+}
+
+
+/**
+  Restore stdout redirected by silenceStdout().
+*/
+void restoreStdout()
+{
+	if( savedStdout < 0 )
+		return;
+
+	fflush(stdout);
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdout);
+	savedStdout = -1;
+}
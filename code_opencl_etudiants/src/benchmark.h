@@ -0,0 +1,168 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include<chrono>
+#include<string>
+#include<vector>
+
+#include"common.h"
+
+
+/**
+  Number of runs of a benchmark. Warm-up runs (program build, buffer pool
+  and caches filling) are not measured, the first one checks the result.
+*/
+typedef struct benchConfig
+{
+	int warmupRuns;
+	int runs;
+} BenchConfig;
+
+
+/**
+  Statistics of the runs of a MxV method. Times are wall clock times of
+  whole calls (with memory transfers for GPU methods), in ms. Throughputs
+  are computed from the median pure computation time recorded by GPU
+  methods, or from the median time for CPU ones, with 2 flops per non zero
+  value, and compared to the bandwidth of the device running the method.
+*/
+typedef struct benchResult
+{
+	std::string name;
+	uint w; // matrix width
+	uint h; // matrix height
+	size_t nzNbr; // number of non zero values
+	double bytes; // bytes moved by one MxV
+	int runs;
+	double min;
+	double median;
+	double p95;
+	double p99;
+	double computeMedian; // median pure computation time, 0 if not recorded
+	double gflops;
+	double gbs;
+	double peakGBs; // bandwidth of the host or of the GPU
+	double peakPercent; // share of peakGBs reached
+} BenchResult;
+
+
+/**
+  Bytes moved by a CSR MxV: values, column indices and row pointers of the
+  matrix, read once, x read once and y written once. It is the minimum for
+  any format, so it is used for all of them to compare them to the same
+  bound.
+*/
+double spmvCSRBytes(const MatrixCSR *m);
+
+/**
+  Pure computation time of a GPU MxV, in ms, recorded by GPU methods so
+  that benchmarks don't count memory transfers in bandwidth. Taking it
+  resets it to -1, the value returned when no time was recorded.
+*/
+void recordComputeTime(double ms);
+double takeComputeTime();
+
+/**
+  Display the bytes moved by the last GPU MxV and the share of the device
+  bandwidth it reached, from its recorded pure computation time, for the
+  single runs done outside benchmarks. Nothing is displayed if no time was
+  recorded, ie for CPU methods.
+*/
+void printRoofline(const char *name, double bytes);
+
+/**
+  Sort run times and compute the statistics of a benchmark. Compute times
+  may be empty.
+*/
+BenchResult summarizeRuns(const char *name, uint w, uint h, size_t nzNbr, double bytes,
+	std::vector<double> &times, std::vector<double> &computeTimes);
+
+/**
+  Display the statistics of a benchmark.
+*/
+void printBenchResult(const BenchResult &result);
+
+/**
+  Write benchmark results to a JSON or CSV file, to track performance
+  across versions. Return 'false' if the file can't be written.
+*/
+bool writeBenchJSON(const char *fileName, const std::vector<BenchResult> &results);
+bool writeBenchCSV(const char *fileName, const std::vector<BenchResult> &results);
+
+/**
+  Redirect stdout to /dev/null, so that the timed runs don't print their
+  own run time, and restore it.
+*/
+void silenceStdout();
+void restoreStdout();
+
+
+/**
+  Run a MxV method once with its output silenced, and return its time in ms:
+  the pure computation time recorded by GPU methods, the time of the whole
+  call for CPU ones. The result is returned in *result.
+*/
+template<typename F, typename M>
+double timeSpmv(F spmvFunction, const M *m, const Matrix *v, Matrix **result)
+{
+	silenceStdout();
+	takeComputeTime();
+	std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+	try
+	{
+		*result = spmvFunction(m, v, (const Matrix*) NULL);
+	}
+	catch( ... )
+	{
+		restoreStdout();
+		throw;
+	}
+	double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+	double computeTime = takeComputeTime();
+	restoreStdout();
+
+	return (computeTime >= 0.0) ? computeTime : t;
+}
+
+
+/**
+  Run a MxV method config.warmupRuns + config.runs times, the first run
+  checking the result against the reference, and return the statistics of
+  the last config.runs runs.
+*/
+template<typename M, typename F>
+BenchResult benchmarkSpmv(const char *name, F spmvFunction, const M *m, const Matrix *v, const Matrix *reference,
+	size_t nzNbr, double bytes, const BenchConfig &config)
+{
+	std::vector<double> times;
+	std::vector<double> computeTimes;
+	uint h = 0;
+	for(int i = 0; i < config.warmupRuns + config.runs; i++)
+	{
+		if( i > 0 )
+			silenceStdout();
+
+		takeComputeTime();
+		std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+		Matrix *mv = spmvFunction(m, v, (i == 0) ? reference : NULL);
+		double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+		double computeTime = takeComputeTime();
+		h = mv->h;
+		deleteMatrix(&mv);
+
+		if( i > 0 )
+			restoreStdout();
+		if( i >= config.warmupRuns )
+		{
+			times.push_back(t);
+			if( computeTime >= 0.0 )
+				computeTimes.push_back(computeTime);
+		}
+	}
+
+	BenchResult result = summarizeRuns(name, v->h, h, nzNbr, bytes, times, computeTimes);
+	printBenchResult(result);
+	return result;
+}
+
+#endif
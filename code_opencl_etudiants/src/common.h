@@ -1,3 +1,6 @@
+#ifndef __COMMON_H__
+#define __COMMON_H__
+
 #include <cstdio>
 #include <cstdlib>
 
@@ -168,3 +171,5 @@ bool checkResult(const char *title, const Matrix *reference, const Matrix *resul
 	}
 #endif
 #endif
+
+#endif
@@ -0,0 +1,181 @@
+#include<algorithm>
+#include<cmath>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+
+#include"csr_tools.h"
+
+
+/**
+  Create a CSR matrix structure.
+*/
+MatrixCSR* createMatrixCSR(uint w, uint h, uint nzNbr)
+{
+	MatrixCSR *m = (MatrixCSR*) malloc(sizeof(MatrixCSR));
+	if( ! m )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	m->w = w;
+	m->h = h;
+	m->nzNbr = nzNbr;
+	m->data = (float*) malloc((size_t) nzNbr * sizeof(float));
+	m->col_ind = (uint*) malloc((size_t) nzNbr * sizeof(uint));
+	m->row_ptr = (uint*) malloc((size_t) (h + 1) * sizeof(uint));
+	if( (nzNbr && (! m->data || ! m->col_ind)) || ! m->row_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	return m;
+}
+
+
+/**
+  Compute the transpose of a CSR matrix.
+*/
+MatrixCSR* transposeCSR(const MatrixCSR *m)
+{
+	MatrixCSR *t = createMatrixCSR(m->h, m->w, m->nzNbr);
+	uint *t_ptr = t->row_ptr;
+
+	// count non zero values in each column
+	for(uint c = 0; c <= m->w; c++)
+		t_ptr[c] = 0;
+
+	#pragma omp parallel for
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		#pragma omp atomic
+		t_ptr[m->col_ind[i] + 1]++;
+	}
+
+	for(uint c = 0; c < m->w; c++)
+		t_ptr[c + 1] += t_ptr[c];
+
+	// scatter values, the order in a column depends on thread scheduling
+	std::vector<uint> pos(t_ptr, t_ptr + m->w);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			uint p;
+			#pragma omp atomic capture
+			p = pos[m->col_ind[i]]++;
+
+			t->col_ind[p] = (uint) r;
+			t->data[p] = m->data[i];
+		}
+	}
+
+	// sort each column by row index, so the result does not depend on threads
+	#pragma omp parallel
+	{
+		std::vector< std::pair<uint, float> > tmp;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long c = 0; c < (long) m->w; c++)
+		{
+			uint beg = t_ptr[c];
+			uint end = t_ptr[c+1];
+
+			tmp.clear();
+			for(uint i = beg; i < end; i++)
+				tmp.push_back(std::make_pair(t->col_ind[i], t->data[i]));
+			std::sort(tmp.begin(), tmp.end());
+
+			for(uint i = beg; i < end; i++)
+			{
+				t->col_ind[i] = tmp[i - beg].first;
+				t->data[i] = tmp[i - beg].second;
+			}
+		}
+	}
+
+	return t;
+}
+
+
+/**
+  Rate of non zero values of a CSR matrix.
+*/
+float densityCSR(const MatrixCSR *m)
+{
+	double size = (double) m->w * m->h;
+	return size ? (float) (m->nzNbr / size) : 0.0f;
+}
+
+
+/**
+  Compare 2 CSR matrices with sorted column indices.
+*/
+bool checkResultCSR(const char *title, const MatrixCSR *reference, const MatrixCSR *result)
+{
+	if( reference->w != result->w || reference->h != result->h || reference->nzNbr != result->nzNbr )
+	{
+		printf("%s: wrong result, size mismatch (%dx%d, %d non zero values instead of %dx%d, %d).\n", title,
+			result->w, result->h, result->nzNbr, reference->w, reference->h, reference->nzNbr);
+		return false;
+	}
+
+	for(uint r = 0; r <= reference->h; r++)
+	{
+		if( reference->row_ptr[r] != result->row_ptr[r] )
+		{
+			printf("%s: wrong result, structure differs at row %d.\n", title, r);
+			return false;
+		}
+	}
+
+	for(uint i = 0; i < reference->nzNbr; i++)
+	{
+		float ref = reference->data[i];
+		float res = result->data[i];
+		if( reference->col_ind[i] != result->col_ind[i] || fabsf(ref - res) > 1e-5f * fmaxf(1.0f, fabsf(ref)) )
+		{
+			printf("%s: wrong result at non zero value %d (col %d, %f instead of col %d, %f).\n", title,
+				i, result->col_ind[i], res, reference->col_ind[i], ref);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+  Compare a result computed with reduced precision to a float reference.
+*/
+bool checkResultAccuracy(const char *title, const Matrix *reference, const Matrix *result, float tolerance)
+{
+	if( reference->w != result->w || reference->h != result->h )
+	{
+		printf("%s: wrong result, size mismatch (%dx%d instead of %dx%d).\n", title,
+			result->w, result->h, reference->w, reference->h);
+		return false;
+	}
+
+	size_t size = (size_t) reference->w * reference->h;
+	double maxAbs = 0.0;
+	double maxRel = 0.0;
+	double diff2 = 0.0;
+	double ref2 = 0.0;
+	for(size_t i = 0; i < size; i++)
+	{
+		double ref = reference->data[i];
+		double err = fabs((double) result->data[i] - ref);
+		if( ! (err <= maxAbs) ) // also catches NaN
+			maxAbs = err;
+		if( ref != 0.0 && ! (err / fabs(ref) <= maxRel) )
+			maxRel = err / fabs(ref);
+		diff2 += err * err;
+		ref2 += ref * ref;
+	}
+	double normRel = (ref2 > 0.0) ? sqrt(diff2 / ref2) : sqrt(diff2);
+
+	bool ok = normRel < tolerance;
+	printf("%s: %s, max abs error %e, max rel error %e, normwise rel error %e (tolerance %e).\n", title,
+		ok ? "accuracy ok" : "wrong result", maxAbs, maxRel, normRel, tolerance);
+
+	return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef __CSR_TOOLS_H__
+#define __CSR_TOOLS_H__
+
+#include"common.h"
+
+
+/**
+  Create a CSR matrix structure. Allocate memory for nzNbr values and
+  column indices, and h+1 row pointers, like matrixToCSR() does.
+  Memory must be deallocated by user by calling deleteMatrixCSR().
+*/
+MatrixCSR* createMatrixCSR(uint w, uint h, uint nzNbr);
+
+
+/**
+  Compute the transpose of a CSR matrix, which is also its CSC view.
+  Built in parallel; column indices are sorted in each row of the result.
+*/
+MatrixCSR* transposeCSR(const MatrixCSR *m);
+
+
+/**
+  Rate of non zero values of a CSR matrix, in [0;1].
+*/
+float densityCSR(const MatrixCSR *m);
+
+
+/**
+  Compare 2 CSR matrices with sorted column indices: same structure, and
+  values equal up to rounding errors. Returns 'true' if they are equal.
+*/
+bool checkResultCSR(const char *title, const MatrixCSR *reference, const MatrixCSR *result);
+
+
+/**
+  Compare a result computed with reduced precision to a float reference:
+  display the max absolute error, the max relative error and the normwise
+  relative error ||result - reference|| / ||reference||.
+  Returns 'true' if the normwise relative error is below tolerance.
+*/
+bool checkResultAccuracy(const char *title, const Matrix *reference, const Matrix *result, float tolerance);
+
+#endif
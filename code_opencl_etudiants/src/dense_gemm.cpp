@@ -0,0 +1,230 @@
+#include<algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include<immintrin.h>
+#endif
+
+#include"dense_gemm.h"
+#include"memory_pool.h"
+
+
+// micro kernel size, MR x NR values of C stay in registers
+#define MR 6
+#define NR 16
+
+// block sizes: an MC x KC block of A stays in L2, a KC x NR sliver of B in L1
+#define MC 120
+#define KC 256
+#define NC 4096
+
+
+/**
+  Pack an mc x kc block of A in slivers of MR rows, stored column by column.
+  Missing rows of the last sliver are padded with zeros.
+*/
+static void packA(uint mc, uint kc, const float *A, size_t lda, float *packed)
+{
+	for(uint i0 = 0; i0 < mc; i0 += MR)
+	{
+		for(uint k = 0; k < kc; k++)
+		{
+			for(uint i = 0; i < MR; i++)
+				*packed++ = (i0 + i < mc) ? A[(i0 + i) * lda + k] : 0.0f;
+		}
+	}
+}
+
+
+/**
+  Pack a kc x nc panel of B in slivers of NR columns, stored row by row.
+  Missing columns of the last sliver are padded with zeros.
+*/
+static void packBSliver(uint kc, uint nr, const float *B, size_t ldb, float *packed)
+{
+	for(uint k = 0; k < kc; k++)
+	{
+		for(uint j = 0; j < NR; j++)
+			*packed++ = (j < nr) ? B[k * ldb + j] : 0.0f;
+	}
+}
+
+
+/**
+  C(mr x nr) += packed A sliver x packed B sliver.
+*/
+static void microKernel(uint kc, const float *a, const float *b, float *C, size_t ldc, uint mr, uint nr)
+{
+	float c[MR * NR];
+
+#if defined(__AVX2__) && defined(__FMA__)
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+	__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+	__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+	__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+	__m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+	__m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+	for(uint k = 0; k < kc; k++, a += MR, b += NR)
+	{
+		__m256 b0 = _mm256_loadu_ps(b);
+		__m256 b1 = _mm256_loadu_ps(b + 8);
+		__m256 ai;
+
+		ai = _mm256_broadcast_ss(a + 0);
+		c00 = _mm256_fmadd_ps(ai, b0, c00); c01 = _mm256_fmadd_ps(ai, b1, c01);
+		ai = _mm256_broadcast_ss(a + 1);
+		c10 = _mm256_fmadd_ps(ai, b0, c10); c11 = _mm256_fmadd_ps(ai, b1, c11);
+		ai = _mm256_broadcast_ss(a + 2);
+		c20 = _mm256_fmadd_ps(ai, b0, c20); c21 = _mm256_fmadd_ps(ai, b1, c21);
+		ai = _mm256_broadcast_ss(a + 3);
+		c30 = _mm256_fmadd_ps(ai, b0, c30); c31 = _mm256_fmadd_ps(ai, b1, c31);
+		ai = _mm256_broadcast_ss(a + 4);
+		c40 = _mm256_fmadd_ps(ai, b0, c40); c41 = _mm256_fmadd_ps(ai, b1, c41);
+		ai = _mm256_broadcast_ss(a + 5);
+		c50 = _mm256_fmadd_ps(ai, b0, c50); c51 = _mm256_fmadd_ps(ai, b1, c51);
+	}
+
+	_mm256_storeu_ps(c + 0*NR, c00); _mm256_storeu_ps(c + 0*NR + 8, c01);
+	_mm256_storeu_ps(c + 1*NR, c10); _mm256_storeu_ps(c + 1*NR + 8, c11);
+	_mm256_storeu_ps(c + 2*NR, c20); _mm256_storeu_ps(c + 2*NR + 8, c21);
+	_mm256_storeu_ps(c + 3*NR, c30); _mm256_storeu_ps(c + 3*NR + 8, c31);
+	_mm256_storeu_ps(c + 4*NR, c40); _mm256_storeu_ps(c + 4*NR + 8, c41);
+	_mm256_storeu_ps(c + 5*NR, c50); _mm256_storeu_ps(c + 5*NR + 8, c51);
+#else
+	// generic version, inner loop on NR is left to the compiler vectorizer
+	for(uint i = 0; i < MR * NR; i++)
+		c[i] = 0.0f;
+
+	for(uint k = 0; k < kc; k++, a += MR, b += NR)
+	{
+		for(uint i = 0; i < MR; i++)
+		{
+			float ai = a[i];
+			#pragma omp simd
+			for(uint j = 0; j < NR; j++)
+				c[i * NR + j] += ai * b[j];
+		}
+	}
+#endif
+
+	for(uint i = 0; i < mr; i++)
+	{
+		for(uint j = 0; j < nr; j++)
+			C[i * ldc + j] += c[i * NR + j];
+	}
+}
+
+
+/**
+  Dense matrix product C = A x B on CPU.
+*/
+void cpuGemm(uint M, uint N, uint K, const float *A, size_t lda, const float *B, size_t ldb, float *C, size_t ldc)
+{
+	// panel of B shared by all threads, packing buffers come from the pool
+	// since GEMM is often called in loops
+	float *packedB = (float*) poolAlloc((size_t) KC * ((std::min(N, (uint) NC) + NR - 1) / NR) * NR * sizeof(float));
+
+	#pragma omp parallel
+	{
+		// block of A private to each thread
+		float *packedA = (float*) poolAlloc((size_t) ((MC + MR - 1) / MR) * MR * KC * sizeof(float));
+
+		#pragma omp for schedule(static)
+		for(long r = 0; r < (long) M; r++)
+			std::fill(C + r * ldc, C + r * ldc + N, 0.0f);
+
+		for(uint jc = 0; jc < N; jc += NC)
+		{
+			uint nc = std::min(N - jc, (uint) NC);
+			uint slivers = (nc + NR - 1) / NR;
+
+			for(uint pc = 0; pc < K; pc += KC)
+			{
+				uint kc = std::min(K - pc, (uint) KC);
+
+				#pragma omp for schedule(static)
+				for(long s = 0; s < (long) slivers; s++)
+				{
+					uint jr = s * NR;
+					packBSliver(kc, std::min(nc - jr, (uint) NR), B + pc * ldb + jc + jr, ldb, &packedB[s * NR * kc]);
+				}
+				// implicit barrier, packedB is ready
+
+				#pragma omp for schedule(dynamic)
+				for(long ic = 0; ic < (long) M; ic += MC)
+				{
+					uint mc = std::min(M - (uint) ic, (uint) MC);
+					packA(mc, kc, A + ic * lda + pc, lda, packedA);
+
+					for(uint s = 0; s < slivers; s++)
+					{
+						uint jr = s * NR;
+						uint nr = std::min(nc - jr, (uint) NR);
+						for(uint ir = 0; ir < mc; ir += MR)
+						{
+							microKernel(kc, &packedA[ir * kc], &packedB[s * NR * kc],
+								C + (ic + ir) * ldc + jc + jr, ldc, std::min(mc - ir, (uint) MR), nr);
+						}
+					}
+				}
+				// implicit barrier, packedB can be overwritten
+			}
+		}
+
+		poolFree(packedA);
+	}
+
+	poolFree(packedB);
+}
+
+
+/**
+  Dense matrix-vector product y = A x on CPU.
+*/
+void cpuGemv(uint M, uint K, const float *A, size_t lda, const float *x, float *y)
+{
+	#pragma omp parallel for schedule(static)
+	for(long r = 0; r < (long) M; r += 4)
+	{
+		uint rows = std::min(M - (uint) r, 4u);
+		const float *a0 = A + r * lda;
+		const float *a1 = (rows > 1) ? a0 + lda : a0;
+		const float *a2 = (rows > 2) ? a0 + 2 * lda : a0;
+		const float *a3 = (rows > 3) ? a0 + 3 * lda : a0;
+		float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+		uint k = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+		__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+		for(; k + 8 <= K; k += 8)
+		{
+			__m256 xv = _mm256_loadu_ps(x + k);
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + k), xv, acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + k), xv, acc1);
+			acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + k), xv, acc2);
+			acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + k), xv, acc3);
+		}
+
+		float tmp[8];
+		_mm256_storeu_ps(tmp, acc0); for(int i = 0; i < 8; i++) s0 += tmp[i];
+		_mm256_storeu_ps(tmp, acc1); for(int i = 0; i < 8; i++) s1 += tmp[i];
+		_mm256_storeu_ps(tmp, acc2); for(int i = 0; i < 8; i++) s2 += tmp[i];
+		_mm256_storeu_ps(tmp, acc3); for(int i = 0; i < 8; i++) s3 += tmp[i];
+#endif
+
+		#pragma omp simd reduction(+:s0,s1,s2,s3)
+		for(uint kk = k; kk < K; kk++)
+		{
+			s0 += a0[kk] * x[kk];
+			s1 += a1[kk] * x[kk];
+			s2 += a2[kk] * x[kk];
+			s3 += a3[kk] * x[kk];
+		}
+
+		y[r] = s0;
+		if( rows > 1 ) y[r + 1] = s1;
+		if( rows > 2 ) y[r + 2] = s2;
+		if( rows > 3 ) y[r + 3] = s3;
+	}
+}
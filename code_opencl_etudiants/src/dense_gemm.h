@@ -0,0 +1,40 @@
+#ifndef __DENSE_GEMM_H__
+#define __DENSE_GEMM_H__
+
+#include"common.h"
+
+
+/**
+  Dense matrix product C = A x B on CPU, all matrices stored row by row.
+  A is M x K with lda floats per row, B is K x N with ldb floats per row,
+  C is M x N with ldc floats per row.
+  Cache blocked with packed panels of A and B, register blocked micro kernel
+  (AVX2 + FMA when available), multithreaded with OpenMP.
+*/
+void cpuGemm(uint M, uint N, uint K, const float *A, size_t lda, const float *B, size_t ldb, float *C, size_t ldc);
+
+
+/**
+  Dense matrix-vector product y = A x on CPU, A is M x K with lda floats
+  per row. Rows are processed 4 by 4 to load each x value once for 4 rows.
+*/
+void cpuGemv(uint M, uint K, const float *A, size_t lda, const float *x, float *y);
+
+
+/**
+  Compute M1xM2 on GPU, dense matrices. Tiles of M1 and M2 are staged in
+  local memory, each work item computes several values of a row of the
+  result tile in registers.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuGemm(const Matrix *m1, const Matrix *m2, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, dense matrix. Each work group computes several rows,
+  work items read rows with coalesced accesses and each x value loaded is
+  used for all the rows of the work group.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuGemv(const Matrix *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,306 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+
+#include"tools.h"
+#include"dense_gemm.h"
+#include"benchmark.h"
+
+
+// GEMV: rows per work group, and work group size
+#define GEMV_ROWS 4
+#define GEMV_WG_SIZE 256
+
+// GEMM: TS x TS tile of the result per work group, WPT values per work item
+#define GEMM_TS 32
+#define GEMM_WPT 8
+
+
+//---------------------------------------------------------
+
+std::string kernelGemv_source =
+	"// y = A.x, A is h x w, ROWS rows per work group\n"
+	"__kernel void kernelGemv(uint h, uint w, const __global float *A, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	__local float partial[ROWS][WG_SIZE];\n"
+	"\n"
+	"	uint l = get_local_id(0);\n"
+	"	uint r0 = get_group_id(0) * ROWS;\n"
+	"	float acc[ROWS];\n"
+	"	for(uint i = 0; i < ROWS; i++)\n"
+	"		acc[i] = 0.0f;\n"
+	"\n"
+	"	// consecutive work items read consecutive values of a row\n"
+	"	for(uint k = l; k < w; k += WG_SIZE)\n"
+	"	{\n"
+	"		float xk = x[k];\n"
+	"		for(uint i = 0; i < ROWS; i++)\n"
+	"		{\n"
+	"			if( r0 + i < h )\n"
+	"				acc[i] += A[(size_t) (r0 + i) * w + k] * xk;\n"
+	"		}\n"
+	"	}\n"
+	"\n"
+	"	for(uint i = 0; i < ROWS; i++)\n"
+	"		partial[i][l] = acc[i];\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	// parallel reduction in local memory\n"
+	"	for(uint s = WG_SIZE/2; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( l < s )\n"
+	"		{\n"
+	"			for(uint i = 0; i < ROWS; i++)\n"
+	"				partial[i][l] += partial[i][l + s];\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( l < ROWS && r0 + l < h )\n"
+	"		y[r0 + l] = partial[l][0];\n"
+	"}\n";
+
+
+std::string kernelGemm_source =
+	"// C = A.B, A is M x K, B is K x N\n"
+	"// work group size is (TS/WPT, TS), each work item computes WPT values of\n"
+	"// a row of the TS x TS tile of C, strided by TS/WPT\n"
+	"#define RTS (TS/WPT)\n"
+	"\n"
+	"__kernel void kernelGemm(uint M, uint N, uint K, const __global float *A, const __global float *B, __global float *C)\n"
+	"{\n"
+	"	__local float tileA[TS][TS];\n"
+	"	__local float tileB[TS][TS];\n"
+	"\n"
+	"	uint lc = get_local_id(0);\n"
+	"	uint lr = get_local_id(1);\n"
+	"	uint row = get_group_id(1) * TS + lr;\n"
+	"	uint col0 = get_group_id(0) * TS;\n"
+	"\n"
+	"	float acc[WPT];\n"
+	"	for(uint w = 0; w < WPT; w++)\n"
+	"		acc[w] = 0.0f;\n"
+	"\n"
+	"	for(uint t = 0; t < K; t += TS)\n"
+	"	{\n"
+	"		// load tiles, padded with zeros\n"
+	"		for(uint w = 0; w < WPT; w++)\n"
+	"		{\n"
+	"			uint c = lc + w * RTS;\n"
+	"			tileA[lr][c] = (row < M && t + c < K) ? A[(size_t) row * K + t + c] : 0.0f;\n"
+	"			tileB[lr][c] = (t + lr < K && col0 + c < N) ? B[(size_t) (t + lr) * N + col0 + c] : 0.0f;\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"		for(uint k = 0; k < TS; k++)\n"
+	"		{\n"
+	"			float a = tileA[lr][k];\n"
+	"			for(uint w = 0; w < WPT; w++)\n"
+	"				acc[w] += a * tileB[k][lc + w * RTS];\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	for(uint w = 0; w < WPT; w++)\n"
+	"	{\n"
+	"		uint c = col0 + lc + w * RTS;\n"
+	"		if( row < M && c < N )\n"
+	"			C[(size_t) row * N + c] = acc[w];\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute M1xM2 on GPU, dense matrices.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuGemm(const Matrix *m1, const Matrix *m2, const Matrix *reference)
+{
+	const char *name = "Dense GEMM method on GPU";
+
+	if(m1->w != m2->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+
+	// output matrix size
+	uint width = m2->w;
+	uint height = m1->h;
+	Matrix *m1xm2 = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		std::ostringstream options;
+		options << "-D TS=" << GEMM_TS << " -D WPT=" << GEMM_WPT;
+		cl::Program program = buildProgram(kernelGemm_source, options.str());
+		cl::Kernel kernel(program, "kernelGemm");
+
+		// allocate global memory on GPU
+		size_t m1SizeInBytes = (size_t) m1->w * m1->h * sizeof(float);
+		size_t m2SizeInBytes = (size_t) m2->w * m2->h * sizeof(float);
+		size_t m1xm2SizeInBytes = (size_t) width * height * sizeof(float);
+		cl::Buffer gpuM1 = acquireBuffer(CL_MEM_READ_ONLY, m1SizeInBytes);
+		cl::Buffer gpuM2 = acquireBuffer(CL_MEM_READ_ONLY, m2SizeInBytes);
+		cl::Buffer gpuM1xM2 = acquireBuffer(CL_MEM_WRITE_ONLY, m1xm2SizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		queue.enqueueWriteBuffer(gpuM1, CL_TRUE, 0, m1SizeInBytes, m1->data);
+		queue.enqueueWriteBuffer(gpuM2, CL_TRUE, 0, m2SizeInBytes, m2->data);
+
+		// set workgroup and grid size
+		size_t tilesX = (width + GEMM_TS - 1) / GEMM_TS;
+		size_t tilesY = (height + GEMM_TS - 1) / GEMM_TS;
+		cl::NDRange work_group_size(GEMM_TS / GEMM_WPT, GEMM_TS);
+		cl::NDRange global_work_size(tilesX * (GEMM_TS / GEMM_WPT), tilesY * GEMM_TS);
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, height);
+		kernel.setArg(1, width);
+		kernel.setArg(2, m1->w);
+		kernel.setArg(3, gpuM1);
+		kernel.setArg(4, gpuM2);
+		kernel.setArg(5, gpuM1xM2);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, global_work_size, work_group_size);
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuM1xM2, CL_TRUE, 0, m1xm2SizeInBytes, m1xm2->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuM1);
+		releaseBuffer(gpuM2);
+		releaseBuffer(gpuM1xM2);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, m1xm2))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M1(%dx%d)xM2(%dx%d) computed in %f ms (%f ms of pure computation).\n", name, m1->w, m1->h, m2->w, m2->h, gpuRunTime, gpuComputeTime);
+
+	return m1xm2;
+}
+
+
+/**
+  Compute MxV on GPU, dense matrix.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuGemv(const Matrix *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "Dense GEMV method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		std::ostringstream options;
+		options << "-D ROWS=" << GEMV_ROWS << " -D WG_SIZE=" << GEMV_WG_SIZE;
+		cl::Program program = buildProgram(kernelGemv_source, options.str());
+		cl::Kernel kernel(program, "kernelGemv");
+
+		// allocate global memory on GPU
+		size_t mSizeInBytes = (size_t) m->w * m->h * sizeof(float);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuM = acquireBuffer(CL_MEM_READ_ONLY, mSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		queue.enqueueWriteBuffer(gpuM, CL_TRUE, 0, mSizeInBytes, m->data);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = GEMV_WG_SIZE;
+		size_t global_work_size = ((m->h + GEMV_ROWS - 1) / GEMV_ROWS) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, m->w);
+		kernel.setArg(2, gpuM);
+		kernel.setArg(3, gpuV);
+		kernel.setArg(4, gpuMV);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuM);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
@@ -0,0 +1,299 @@
+#include<algorithm>
+#include<climits>
+#include<cmath>
+#include<cstring>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+
+#include"csr_tools.h"
+#include"matrix_generator.h"
+
+
+// names of the patterns, in the order of MatrixPattern
+static const char *patternNames[PATTERNS_NBR] = {"banded", "block", "stencil2d", "stencil3d", "rmat", "uniform"};
+
+// independent random streams for structure and values
+#define STREAM_STRUCTURE 0x5851f42d4c957f2dULL
+#define STREAM_VALUES 0x14057b7ef767814fULL
+
+
+/**
+  Name of a pattern.
+*/
+const char* matrixPatternName(MatrixPattern pattern)
+{
+	return (pattern < PATTERNS_NBR) ? patternNames[pattern] : "unknown";
+}
+
+
+/**
+  Pattern of a name.
+*/
+MatrixPattern matrixPatternFromName(const char *name)
+{
+	for(int p = 0; p < PATTERNS_NBR; p++)
+	{
+		if( strcmp(name, patternNames[p]) == 0 )
+			return (MatrixPattern) p;
+	}
+	return PATTERNS_NBR;
+}
+
+
+/**
+  Usual parameters of a pattern.
+*/
+GeneratorParams defaultGeneratorParams(MatrixPattern pattern, uint n)
+{
+	GeneratorParams params;
+	params.pattern = pattern;
+	params.n = n;
+	params.param = (pattern == PATTERN_UNIFORM || pattern == PATTERN_RMAT) ? 16 : 8;
+	params.a = 0.57f;
+	params.b = 0.19f;
+	params.c = 0.19f;
+	params.seed = 42;
+	return params;
+}
+
+
+/**
+  Counter based random generator: SplitMix64 mix of a seed and a counter.
+  Each value is computed from its counter alone, without any state shared
+  between threads.
+*/
+static inline uint64_t counterRandom(uint64_t seed, uint64_t counter)
+{
+	uint64_t z = seed + (counter + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+
+/**
+  Uniform float in [0;1) from a random 64 bit value.
+*/
+static inline float unitFloat(uint64_t z)
+{
+	return (float) (z >> 40) / 16777216.0f;
+}
+
+
+/**
+  Random value of the matrix at (r, c), in [-1;1).
+*/
+static inline float randomValue(const GeneratorParams &p, uint r, uint c)
+{
+	return 2.0f * unitFloat(counterRandom(p.seed ^ STREAM_VALUES, ((uint64_t) r << 32) | c)) - 1.0f;
+}
+
+
+/**
+  Side of the grid of a stencil matrix.
+*/
+static uint gridSide(const GeneratorParams &p)
+{
+	uint side = (uint) (p.pattern == PATTERN_STENCIL_2D ? sqrt((double) p.n) : cbrt((double) p.n));
+	// fix rounding of the floating point root
+	uint dims = (p.pattern == PATTERN_STENCIL_2D) ? 2 : 3;
+	while( pow((double) side + 1, dims) <= p.n )
+		side++;
+	while( side > 0 && pow((double) side, dims) > p.n )
+		side--;
+	return side;
+}
+
+
+/**
+  Columns of a row of a R-MAT matrix. The number of values of the row is
+  its expected number of edges, each edge then picks its column quadrant by
+  quadrant knowing the quadrants of the row.
+*/
+static void rmatRow(const GeneratorParams &p, uint n, uint r, std::vector< std::pair<uint, float> > &row)
+{
+	uint scale = 0;
+	while( scale < 32 && ((uint64_t) 1 << scale) < n )
+		scale++;
+
+	double d = 1.0 - p.a - p.b - p.c;
+	double rowProb = 1.0;
+	for(uint l = 0; l < scale; l++)
+		rowProb *= ((r >> l) & 1) ? (p.c + d) : (p.a + p.b);
+
+	// expected degree, fractional part rounded randomly
+	double expected = (double) n * p.param * rowProb;
+	uint64_t degree = (uint64_t) expected;
+	if( unitFloat(counterRandom(p.seed ^ STREAM_STRUCTURE, (uint64_t) r)) < expected - degree )
+		degree++;
+	degree = std::min(degree, (uint64_t) n);
+
+	for(uint64_t k = 0; k < degree; k++)
+	{
+		uint64_t z = counterRandom(p.seed, ((uint64_t) r << 32) | k);
+		uint64_t c = 0;
+		for(uint l = scale; l-- > 0; )
+		{
+			z = counterRandom(z, l);
+			double right = ((r >> l) & 1) ? d / (p.c + d) : p.b / (p.a + p.b);
+			c = (c << 1) | (unitFloat(z) < right ? 1 : 0);
+		}
+
+		// n may not be a power of 2
+		if( c < n )
+			row.push_back(std::make_pair((uint) c, randomValue(p, r, (uint) c)));
+	}
+}
+
+
+/**
+  Values of a row of a synthetic matrix, sorted by column. s is the side of
+  the grid of stencils.
+*/
+static void generateRow(const GeneratorParams &p, uint n, uint s, uint r, std::vector< std::pair<uint, float> > &row)
+{
+	row.clear();
+
+	switch( p.pattern )
+	{
+		case PATTERN_BANDED:
+		{
+			uint beg = (r > p.param) ? r - p.param : 0;
+			uint end = (uint) std::min((uint64_t) r + p.param + 1, (uint64_t) n);
+			for(uint c = beg; c < end; c++)
+				row.push_back(std::make_pair(c, randomValue(p, r, c)));
+			break;
+		}
+
+		case PATTERN_BLOCK_DIAGONAL:
+		{
+			uint bs = std::max(p.param, 1u);
+			uint beg = r / bs * bs;
+			uint end = (uint) std::min((uint64_t) beg + bs, (uint64_t) n);
+			for(uint c = beg; c < end; c++)
+				row.push_back(std::make_pair(c, randomValue(p, r, c)));
+			break;
+		}
+
+		case PATTERN_STENCIL_2D:
+		case PATTERN_STENCIL_3D:
+		{
+			uint i = r % s;
+			uint j = (r / s) % s;
+			uint k = r / s / s;
+			bool is3D = (p.pattern == PATTERN_STENCIL_3D);
+
+			if( is3D && k > 0 ) row.push_back(std::make_pair(r - s * s, -1.0f));
+			if( j > 0 ) row.push_back(std::make_pair(r - s, -1.0f));
+			if( i > 0 ) row.push_back(std::make_pair(r - 1, -1.0f));
+			row.push_back(std::make_pair(r, is3D ? 6.0f : 4.0f));
+			if( i + 1 < s ) row.push_back(std::make_pair(r + 1, -1.0f));
+			if( j + 1 < s ) row.push_back(std::make_pair(r + s, -1.0f));
+			if( is3D && k + 1 < s ) row.push_back(std::make_pair(r + s * s, -1.0f));
+			return; // already sorted
+		}
+
+		case PATTERN_RMAT:
+			rmatRow(p, n, r, row);
+			break;
+
+		case PATTERN_UNIFORM:
+		{
+			uint count = std::min(p.param, n);
+			for(uint k = 0; k < count; k++)
+			{
+				uint c = (uint) (counterRandom(p.seed, ((uint64_t) r << 32) | k) % n);
+				row.push_back(std::make_pair(c, randomValue(p, r, c)));
+			}
+			break;
+		}
+
+		default:
+			throw std::runtime_error("Unknown matrix pattern.");
+	}
+
+	// random columns may repeat, values only depend on (r, c) so duplicates are equal
+	std::sort(row.begin(), row.end());
+	row.erase(std::unique(row.begin(), row.end()), row.end());
+}
+
+
+/**
+  Generate a synthetic matrix in a CSR structure with Offset row pointers.
+  create(w, h, nzNbr) allocates the structure.
+*/
+template<typename M, typename Offset, typename Create>
+static M* generate(const GeneratorParams &p, Create create, uint64_t maxNz)
+{
+	uint side = 0;
+	uint n = p.n;
+	if( p.pattern == PATTERN_STENCIL_2D || p.pattern == PATTERN_STENCIL_3D )
+	{
+		side = gridSide(p);
+		n = (p.pattern == PATTERN_STENCIL_2D) ? side * side : side * side * side;
+	}
+
+	// count values of each row
+	std::vector<uint> rowLen(n);
+	#pragma omp parallel
+	{
+		std::vector< std::pair<uint, float> > row;
+
+		#pragma omp for schedule(dynamic, 256)
+		for(long r = 0; r < (long) n; r++)
+		{
+			generateRow(p, n, side, (uint) r, row);
+			rowLen[r] = (uint) row.size();
+		}
+	}
+
+	uint64_t nzNbr = 0;
+	for(uint r = 0; r < n; r++)
+		nzNbr += rowLen[r];
+	if( nzNbr > maxNz )
+		throw std::runtime_error("Too many non zero values for 32 bit row pointers, use generateCSR64().");
+
+	M *m = create(n, n, (Offset) nzNbr);
+	m->row_ptr[0] = 0;
+	for(uint r = 0; r < n; r++)
+		m->row_ptr[r+1] = m->row_ptr[r] + rowLen[r];
+
+	// fill rows, generated again instead of stored
+	#pragma omp parallel
+	{
+		std::vector< std::pair<uint, float> > row;
+
+		#pragma omp for schedule(dynamic, 256)
+		for(long r = 0; r < (long) n; r++)
+		{
+			generateRow(p, n, side, (uint) r, row);
+			Offset beg = m->row_ptr[r];
+			for(size_t i = 0; i < row.size(); i++)
+			{
+				m->col_ind[beg + i] = row[i].first;
+				m->data[beg + i] = row[i].second;
+			}
+		}
+	}
+
+	return m;
+}
+
+
+/**
+  Generate a synthetic CSR matrix.
+*/
+MatrixCSR* generateCSR(const GeneratorParams &params)
+{
+	return generate<MatrixCSR, uint>(params, createMatrixCSR, (uint64_t) UINT_MAX);
+}
+
+
+/**
+  Generate a synthetic CSR matrix with 64 bit row pointers.
+*/
+MatrixCSR64* generateCSR64(const GeneratorParams &params)
+{
+	return generate<MatrixCSR64, uint64_t>(params, createMatrixCSR64, UINT64_MAX);
+}
@@ -0,0 +1,68 @@
+#ifndef __MATRIX_GENERATOR_H__
+#define __MATRIX_GENERATOR_H__
+
+#include<stdint.h>
+
+#include"common.h"
+#include"spmv_csr64.h"
+
+
+/**
+  Sparsity patterns of synthetic matrices.
+*/
+typedef enum matrixPattern
+{
+	PATTERN_BANDED,          // all values at most 'param' columns from the diagonal
+	PATTERN_BLOCK_DIAGONAL,  // dense blocks of param x param values on the diagonal
+	PATTERN_STENCIL_2D,      // 5 point Laplacian on a square grid
+	PATTERN_STENCIL_3D,      // 7 point Laplacian on a cubic grid
+	PATTERN_RMAT,            // power law graph, param values per row on average
+	PATTERN_UNIFORM,         // param random columns per row
+	PATTERNS_NBR
+} MatrixPattern;
+
+/**
+  Name of a pattern, as used on the command line.
+*/
+const char* matrixPatternName(MatrixPattern pattern);
+
+/**
+  Pattern of a name, PATTERNS_NBR if the name is unknown.
+*/
+MatrixPattern matrixPatternFromName(const char *name);
+
+
+/**
+  Parameters of a synthetic matrix. Matrices are square, n x n, except
+  stencils whose size is rounded down to a whole grid (side^2 or side^3).
+*/
+typedef struct generatorParams
+{
+	MatrixPattern pattern;
+	uint n; // number of rows and columns
+	uint param; // half bandwidth, block size, or non zero values per row
+	float a, b, c; // R-MAT probabilities of the quadrants, d = 1 - a - b - c
+	uint64_t seed;
+} GeneratorParams;
+
+/**
+  Usual parameters of a pattern for a n x n matrix.
+*/
+GeneratorParams defaultGeneratorParams(MatrixPattern pattern, uint n);
+
+
+/**
+  Generate a synthetic CSR matrix, never stored as dense. Rows are generated
+  in parallel, twice: once to count their values, once to fill them. Random
+  values come from a counter based generator indexed by row and column, so
+  the matrix only depends on the parameters, not on the number of threads.
+  Column indices are sorted in each row.
+  generateCSR() throws if there are 2^32 non zero values or more,
+  generateCSR64() handles billions of them.
+  Memory must be deallocated by user by calling deleteMatrixCSR() or
+  deleteMatrixCSR64().
+*/
+MatrixCSR* generateCSR(const GeneratorParams &params);
+MatrixCSR64* generateCSR64(const GeneratorParams &params);
+
+#endif
@@ -0,0 +1,368 @@
+#include<algorithm>
+#include<cctype>
+#include<climits>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<stdexcept>
+#include<string>
+#include<utility>
+#include<vector>
+
+#include<stdint.h>
+#include<omp.h>
+
+#include"csr_tools.h"
+#include"matrix_market.h"
+#include"spmv_csr64.h"
+
+
+/**
+  Values of the header line of a Matrix Market file.
+*/
+typedef struct mtxHeader
+{
+	bool pattern; // no values
+	bool symmetric; // lower triangle only
+	bool skew; // skew-symmetric, a(j,i) = -a(i,j)
+} MtxHeader;
+
+
+/**
+  Parse the header line, throw if the format isn't supported.
+*/
+static MtxHeader parseHeader(const char *line, const char *fileName)
+{
+	char banner[64], object[64], format[64], field[64], symmetry[64];
+	if( sscanf(line, "%63s %63s %63s %63s %63s", banner, object, format, field, symmetry) != 5 ||
+		strcmp(banner, "%%MatrixMarket") != 0 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", wrong header.");
+
+	for(char *s = object; *s; s++) *s = tolower(*s);
+	for(char *s = format; *s; s++) *s = tolower(*s);
+	for(char *s = field; *s; s++) *s = tolower(*s);
+	for(char *s = symmetry; *s; s++) *s = tolower(*s);
+
+	if( strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", only coordinate matrices are supported.");
+	if( strcmp(field, "real") != 0 && strcmp(field, "integer") != 0 && strcmp(field, "double") != 0 && strcmp(field, "pattern") != 0 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", unsupported " + field + " values.");
+	if( strcmp(symmetry, "general") != 0 && strcmp(symmetry, "symmetric") != 0 && strcmp(symmetry, "skew-symmetric") != 0 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", unsupported " + symmetry + " storage.");
+
+	MtxHeader header;
+	header.pattern = (strcmp(field, "pattern") == 0);
+	header.symmetric = (strcmp(symmetry, "general") != 0);
+	header.skew = (strcmp(symmetry, "skew-symmetric") == 0);
+	return header;
+}
+
+
+/**
+  Next line of a buffer, pointer past its end.
+*/
+static inline const char* nextLine(const char *p, const char *end)
+{
+	const char *eol = (const char*) memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+
+/**
+  Is a line an entry, ie not empty nor a comment.
+*/
+static inline bool isEntry(const char *p, const char *end)
+{
+	while( p < end && (*p == ' ' || *p == '\t' || *p == '\r') )
+		p++;
+	return p < end && *p != '\n' && *p != '%';
+}
+
+
+/**
+  Read a Matrix Market file in a CSR structure with Offset row pointers.
+  create(w, h, nzNbr) allocates the structure.
+*/
+template<typename M, typename Offset, typename Create>
+static M* readCSR(const char *fileName, bool expandSymmetric, bool *symmetric, Create create, uint64_t maxNz)
+{
+	// read the whole file
+	FILE *f = fopen(fileName, "rb");
+	if( ! f )
+		throw std::runtime_error(std::string("Failed to open Matrix Market file ") + fileName + ".");
+
+	fseek(f, 0, SEEK_END);
+	size_t fileSize = (size_t) ftell(f);
+	fseek(f, 0, SEEK_SET);
+	std::vector<char> text(fileSize + 1);
+	size_t readSize = fread(&text[0], 1, fileSize, f);
+	fclose(f);
+	if( readSize != fileSize )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ".");
+	text[fileSize] = '\0';
+
+	const char *p = &text[0];
+	const char *end = p + fileSize;
+
+	// header, comments, then size line
+	MtxHeader header = parseHeader(p, fileName);
+	p = nextLine(p, end);
+	while( p < end && ! isEntry(p, nextLine(p, end)) )
+		p = nextLine(p, end);
+
+	unsigned long h, w, entriesNbr;
+	if( sscanf(p, "%lu %lu %lu", &h, &w, &entriesNbr) != 3 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", wrong size line.");
+	if( h > UINT_MAX || w > UINT_MAX )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", more than 2^32 - 1 rows or columns.");
+	p = nextLine(p, end);
+
+	if( symmetric )
+		*symmetric = header.symmetric;
+
+	// split entries in one chunk per thread, at line boundaries
+	int chunksNbr = omp_get_max_threads();
+	std::vector<const char*> chunk(chunksNbr + 1);
+	for(int c = 0; c <= chunksNbr; c++)
+	{
+		const char *q = p + (size_t) (end - p) * c / chunksNbr;
+		if( c > 0 && c < chunksNbr && q > p && q[-1] != '\n' )
+			q = nextLine(q, end);
+		chunk[c] = std::max(q, chunk[c ? c - 1 : 0]);
+	}
+	chunk[0] = p;
+	chunk[chunksNbr] = end;
+
+	// count entries of each chunk, then parse them at their place
+	std::vector<size_t> chunkPos(chunksNbr + 1, 0);
+	#pragma omp parallel for schedule(static, 1)
+	for(int c = 0; c < chunksNbr; c++)
+	{
+		size_t count = 0;
+		for(const char *q = chunk[c]; q < chunk[c+1]; q = nextLine(q, chunk[c+1]))
+			count += isEntry(q, nextLine(q, chunk[c+1])) ? 1 : 0;
+		chunkPos[c + 1] = count;
+	}
+	for(int c = 0; c < chunksNbr; c++)
+		chunkPos[c + 1] += chunkPos[c];
+
+	if( chunkPos[chunksNbr] != entriesNbr )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", wrong number of entries.");
+
+	std::vector<uint> rows(entriesNbr);
+	std::vector<uint> cols(entriesNbr);
+	std::vector<float> vals(entriesNbr);
+	bool valid = true;
+
+	#pragma omp parallel for schedule(static, 1) reduction(&&:valid)
+	for(int c = 0; c < chunksNbr; c++)
+	{
+		size_t i = chunkPos[c];
+		for(const char *q = chunk[c]; q < chunk[c+1]; q = nextLine(q, chunk[c+1]))
+		{
+			if( ! isEntry(q, nextLine(q, chunk[c+1])) )
+				continue;
+
+			char *next;
+			unsigned long r = strtoul(q, &next, 10);
+			unsigned long col = strtoul(next, &next, 10);
+			float val = header.pattern ? 1.0f : strtof(next, &next);
+
+			// 1 based indices
+			if( r < 1 || r > h || col < 1 || col > w )
+				valid = false;
+			rows[i] = (uint) (r - 1);
+			cols[i] = (uint) (col - 1);
+			vals[i] = val;
+			i++;
+		}
+	}
+
+	if( ! valid )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", index out of bounds.");
+
+	// count values of each row, mirrored ones included
+	bool mirror = header.symmetric && expandSymmetric;
+	std::vector<uint> rowLen(h + 1, 0);
+	#pragma omp parallel for
+	for(long i = 0; i < (long) entriesNbr; i++)
+	{
+		#pragma omp atomic
+		rowLen[rows[i] + 1]++;
+		if( mirror && rows[i] != cols[i] )
+		{
+			#pragma omp atomic
+			rowLen[cols[i] + 1]++;
+		}
+	}
+
+	uint64_t nzNbr = 0;
+	for(unsigned long r = 0; r < h; r++)
+		nzNbr += rowLen[r + 1];
+	if( nzNbr > maxNz )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName
+			+ ", too many non zero values for 32 bit row pointers, use readMatrixMarket64().");
+
+	M *m = create((uint) w, (uint) h, (Offset) nzNbr);
+	m->row_ptr[0] = 0;
+	for(unsigned long r = 0; r < h; r++)
+		m->row_ptr[r + 1] = m->row_ptr[r] + rowLen[r + 1];
+
+	// scatter values in their rows, the order in a row depends on threads
+	std::vector<Offset> pos(m->row_ptr, m->row_ptr + h);
+	#pragma omp parallel for
+	for(long i = 0; i < (long) entriesNbr; i++)
+	{
+		Offset dst;
+		#pragma omp atomic capture
+		dst = pos[rows[i]]++;
+		m->col_ind[dst] = cols[i];
+		m->data[dst] = vals[i];
+
+		if( mirror && rows[i] != cols[i] )
+		{
+			#pragma omp atomic capture
+			dst = pos[cols[i]]++;
+			m->col_ind[dst] = rows[i];
+			m->data[dst] = header.skew ? -vals[i] : vals[i];
+		}
+	}
+
+	// sort each row by column index, so the result does not depend on threads
+	#pragma omp parallel
+	{
+		std::vector< std::pair<uint, float> > tmp;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long r = 0; r < (long) h; r++)
+		{
+			Offset beg = m->row_ptr[r];
+			Offset end = m->row_ptr[r+1];
+
+			tmp.clear();
+			for(Offset i = beg; i < end; i++)
+				tmp.push_back(std::make_pair(m->col_ind[i], m->data[i]));
+			std::sort(tmp.begin(), tmp.end());
+
+			for(Offset i = beg; i < end; i++)
+			{
+				m->col_ind[i] = tmp[i - beg].first;
+				m->data[i] = tmp[i - beg].second;
+			}
+		}
+	}
+
+	return m;
+}
+
+
+/**
+  Read a Matrix Market file in a CSR matrix.
+*/
+MatrixCSR* readMatrixMarket(const char *fileName, bool expandSymmetric, bool *symmetric)
+{
+	return readCSR<MatrixCSR, uint>(fileName, expandSymmetric, symmetric, createMatrixCSR, (uint64_t) UINT_MAX);
+}
+
+
+/**
+  Read a Matrix Market file in a CSR matrix with 64 bit row pointers.
+*/
+MatrixCSR64* readMatrixMarket64(const char *fileName, bool expandSymmetric, bool *symmetric)
+{
+	return readCSR<MatrixCSR64, uint64_t>(fileName, expandSymmetric, symmetric, createMatrixCSR64, UINT64_MAX);
+}
+
+
+/**
+  Upper bound of the number of non zero values of a Matrix Market file.
+*/
+uint64_t matrixMarketNzBound(const char *fileName, bool expandSymmetric)
+{
+	FILE *f = fopen(fileName, "rb");
+	if( ! f )
+		throw std::runtime_error(std::string("Failed to open Matrix Market file ") + fileName + ".");
+
+	// header, comments, then size line
+	std::string line;
+	int c = 0;
+	bool first = true;
+	MtxHeader header = {false, false, false};
+	unsigned long h, w, entriesNbr;
+	while( c != EOF )
+	{
+		line.clear();
+		while( (c = fgetc(f)) != EOF && c != '\n' )
+			line.push_back((char) c);
+		line.push_back('\n');
+
+		if( first )
+		{
+			header = parseHeader(line.c_str(), fileName);
+			first = false;
+		}
+		else if( isEntry(line.c_str(), line.c_str() + line.size()) )
+			break;
+	}
+	fclose(f);
+
+	if( first || sscanf(line.c_str(), "%lu %lu %lu", &h, &w, &entriesNbr) != 3 )
+		throw std::runtime_error(std::string("Failed to read Matrix Market file ") + fileName + ", wrong size line.");
+
+	// values off the diagonal of symmetric matrices are mirrored
+	return (header.symmetric && expandSymmetric) ? 2 * (uint64_t) entriesNbr : (uint64_t) entriesNbr;
+}
+
+
+/**
+  Write a CSR matrix in a Matrix Market file.
+*/
+bool writeMatrixMarket(const char *fileName, const MatrixCSR *m)
+{
+	FILE *f = fopen(fileName, "w");
+	if( ! f )
+	{
+		printf("Warning: failed to write Matrix Market file %s.\n", fileName);
+		return false;
+	}
+
+	fprintf(f, "%%%%MatrixMarket matrix coordinate real general\n");
+	fprintf(f, "%u %u %u\n", m->h, m->w, m->nzNbr);
+
+	// blocks of rows are formatted in parallel, then written in order
+	const long rowsPerBlock = 4096;
+	long blocksNbr = ((long) m->h + rowsPerBlock - 1) / rowsPerBlock;
+	int threadsNbr = omp_get_max_threads();
+	bool ok = true;
+
+	for(long b0 = 0; b0 < blocksNbr; b0 += threadsNbr)
+	{
+		long b1 = std::min(b0 + threadsNbr, blocksNbr);
+		std::vector<std::string> text(b1 - b0);
+
+		#pragma omp parallel for schedule(static, 1)
+		for(long b = b0; b < b1; b++)
+		{
+			std::string &s = text[b - b0];
+			char line[64];
+			uint r1 = (uint) std::min((b + 1) * rowsPerBlock, (long) m->h);
+			for(uint r = (uint) (b * rowsPerBlock); r < r1; r++)
+			{
+				for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+				{
+					// 9 significant digits give back the same float
+					int len = snprintf(line, sizeof(line), "%u %u %.9g\n", r + 1, m->col_ind[i] + 1, m->data[i]);
+					s.append(line, len);
+				}
+			}
+		}
+
+		for(long b = b0; b < b1; b++)
+			ok = ok && fwrite(text[b - b0].data(), 1, text[b - b0].size(), f) == text[b - b0].size();
+	}
+
+	ok = (fclose(f) == 0) && ok;
+	if( ! ok )
+		printf("Warning: failed to write Matrix Market file %s.\n", fileName);
+	return ok;
+}
@@ -0,0 +1,44 @@
+#ifndef __MATRIX_MARKET_H__
+#define __MATRIX_MARKET_H__
+
+#include<stdint.h>
+
+#include"common.h"
+#include"spmv_csr64.h"
+
+
+/**
+  Read a Matrix Market file in coordinate format (real, integer or pattern
+  values, general, symmetric or skew-symmetric storage). The file is read
+  at once and its lines are parsed in parallel, then COO values are sorted
+  by rows with a parallel counting sort; column indices are sorted in each
+  row. Pattern values are set to 1.
+  Symmetric matrices are stored by their lower triangle: with
+  expandSymmetric the other triangle is rebuilt, otherwise the stored
+  triangle is returned as is. If symmetric isn't NULL, it is set to the
+  symmetry of the file.
+  readMatrixMarket() throws if there are 2^32 non zero values or more,
+  readMatrixMarket64() handles billions of them. Both throw if there are
+  2^32 rows or columns or more.
+  Memory must be deallocated by user by calling deleteMatrixCSR() or
+  deleteMatrixCSR64().
+*/
+MatrixCSR* readMatrixMarket(const char *fileName, bool expandSymmetric = true, bool *symmetric = NULL);
+MatrixCSR64* readMatrixMarket64(const char *fileName, bool expandSymmetric = true, bool *symmetric = NULL);
+
+/**
+  Upper bound of the number of non zero values of a Matrix Market file, read
+  from its size line without reading its entries: the number of entries,
+  doubled for symmetric files with expandSymmetric. Tells which of
+  readMatrixMarket() and readMatrixMarket64() to call.
+*/
+uint64_t matrixMarketNzBound(const char *fileName, bool expandSymmetric = true);
+
+/**
+  Write a CSR matrix in a Matrix Market file, coordinate real general
+  format. Lines are formatted in parallel.
+  Returns 'false' if the file can't be written.
+*/
+bool writeMatrixMarket(const char *fileName, const MatrixCSR *m);
+
+#endif
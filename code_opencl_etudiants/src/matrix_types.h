@@ -0,0 +1,330 @@
+#ifndef __MATRIX_TYPES_H__
+#define __MATRIX_TYPES_H__
+
+#include<cstdlib>
+#include<cstring>
+#include<new>
+#include<stdexcept>
+#include<utility>
+
+#include"common.h"
+#include"spmv_csr64.h"
+
+
+// alignment of matrix arrays, a cache line (and an AVX-512 register)
+#define MATRIX_ALIGNMENT 64
+
+
+/**
+  Non owning view of a contiguous array.
+*/
+template<typename T>
+struct Span
+{
+	T *ptr;
+	size_t size;
+
+	Span(T *ptr = NULL, size_t size = 0) : ptr(ptr), size(size) {}
+
+	T& operator[](size_t i) const { return ptr[i]; }
+	T* begin() const { return ptr; }
+	T* end() const { return ptr + size; }
+};
+
+
+/**
+  Owning array aligned on MATRIX_ALIGNMENT bytes, move only. Memory comes
+  from posix_memalign() and is released with free(), like the arrays of the
+  C structures, so ownership can be passed to and taken from them. Arrays
+  adopted from C structures keep the alignment malloc() gave them.
+  Ownership rule: every C structure and array, from libcommon (createMatrix(),
+  matrixToCSR()) or from this code (createMatrixCSR(), createMatrixCSR64()),
+  is allocated with malloc() and destroyed with free(), as libcommon's
+  deleteMatrixCSR() already does for createMatrixCSR() results. So any of
+  them can be adopted, and released ones destroyed by the usual functions.
+*/
+template<typename T>
+class AlignedBuffer
+{
+public:
+	AlignedBuffer() : ptr(NULL), n(0) {}
+
+	explicit AlignedBuffer(size_t n) : ptr(NULL), n(n)
+	{
+		void *p = NULL;
+		if( n && posix_memalign(&p, MATRIX_ALIGNMENT, n * sizeof(T)) )
+			throw std::bad_alloc();
+		ptr = (T*) p;
+	}
+
+	// take ownership of an array allocated with malloc()
+	static AlignedBuffer adopt(T *p, size_t n)
+	{
+		AlignedBuffer b;
+		b.ptr = p;
+		b.n = n;
+		return b;
+	}
+
+	AlignedBuffer(AlignedBuffer &&o) : ptr(o.ptr), n(o.n) { o.ptr = NULL; o.n = 0; }
+	AlignedBuffer& operator=(AlignedBuffer &&o)
+	{
+		if( this != &o )
+		{
+			free(ptr);
+			ptr = o.ptr; n = o.n;
+			o.ptr = NULL; o.n = 0;
+		}
+		return *this;
+	}
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	~AlignedBuffer() { free(ptr); }
+
+	// give up ownership, the caller must free() the array
+	T* release() { T *p = ptr; ptr = NULL; n = 0; return p; }
+
+	T* data() const { return ptr; }
+	size_t size() const { return n; }
+	T& operator[](size_t i) const { return ptr[i]; }
+	Span<T> span() const { return Span<T>(ptr, n); }
+
+private:
+	T *ptr;
+	size_t n;
+};
+
+
+/**
+  Non owning view of a dense matrix or of a block of it, stored row by row
+  with stride elements between rows.
+*/
+template<typename T>
+struct DenseView
+{
+	uint w;
+	uint h;
+	size_t stride;
+	T *ptr;
+
+	T& operator()(uint r, uint c) const { return ptr[r * stride + c]; }
+	Span<T> row(uint r) const { return Span<T>(ptr + r * stride, w); }
+
+	// sub-block of h x w values starting at (r, c), no copy
+	DenseView block(uint r, uint c, uint bh, uint bw) const
+	{
+		DenseView v = {bw, bh, stride, ptr + r * stride + c};
+		return v;
+	}
+};
+
+
+/**
+  Dense matrix stored row by row, owning its aligned values, move only.
+*/
+template<typename T>
+class DenseMatrix
+{
+public:
+	DenseMatrix() : w_(0), h_(0) {}
+	DenseMatrix(uint w, uint h) : w_(w), h_(h), values((size_t) w * h) {}
+
+	DenseMatrix(DenseMatrix&&) = default;
+	DenseMatrix& operator=(DenseMatrix&&) = default;
+
+	uint w() const { return w_; }
+	uint h() const { return h_; }
+	T* data() const { return values.data(); }
+	T& operator()(uint r, uint c) const { return values[(size_t) r * w_ + c]; }
+
+	DenseView<T> view() const
+	{
+		DenseView<T> v = {w_, h_, w_, values.data()};
+		return v;
+	}
+	DenseView<T> block(uint r, uint c, uint bh, uint bw) const { return view().block(r, c, bh, bw); }
+	Span<T> row(uint r) const { return view().row(r); }
+
+	// take ownership of the values of a C Matrix and destroy the structure
+	static DenseMatrix adopt(Matrix **m)
+	{
+		DenseMatrix d;
+		d.w_ = (*m)->w;
+		d.h_ = (*m)->h;
+		d.values = AlignedBuffer<T>::adopt((*m)->data, (size_t) d.w_ * d.h_);
+		free(*m);
+		*m = NULL;
+		return d;
+	}
+
+	// C Matrix sharing the values, to call the existing functions without copy
+	Matrix cView() const
+	{
+		Matrix m = {w_, h_, values.data()};
+		return m;
+	}
+
+	// give the values to a C Matrix, to be destroyed with deleteMatrix()
+	Matrix* release()
+	{
+		Matrix *m = (Matrix*) malloc(sizeof(Matrix));
+		if( ! m )
+			throw std::bad_alloc();
+		m->w = w_;
+		m->h = h_;
+		m->data = values.release();
+		w_ = h_ = 0;
+		return m;
+	}
+
+private:
+	uint w_;
+	uint h_;
+	AlignedBuffer<T> values;
+};
+
+
+/**
+  Non owning view of a block of rows of a CSR matrix. Row pointers are not
+  rebased, they index the values of the whole matrix.
+*/
+template<typename T, typename Index>
+struct CsrView
+{
+	uint w;
+	uint h;
+	T *values;
+	uint *col_ind;
+	Index *row_ptr; // h+1 pointers
+
+	Index nzNbr() const { return row_ptr[h] - row_ptr[0]; }
+	Span<T> rowValues(uint r) const { return Span<T>(values + row_ptr[r], row_ptr[r+1] - row_ptr[r]); }
+	Span<uint> rowColumns(uint r) const { return Span<uint>(col_ind + row_ptr[r], row_ptr[r+1] - row_ptr[r]); }
+
+	// rows r0 to r1 excluded, no copy
+	CsrView rows(uint r0, uint r1) const
+	{
+		CsrView v = {w, r1 - r0, values, col_ind, row_ptr + r0};
+		return v;
+	}
+};
+
+
+/**
+  CSR matrix owning its aligned arrays, move only. Index is the type of row
+  pointers and of the number of non zero values, column indices are uint.
+*/
+template<typename T, typename Index>
+class CsrMatrix
+{
+public:
+	CsrMatrix() : w_(0), h_(0), nzNbr_(0) {}
+	CsrMatrix(uint w, uint h, Index nzNbr) : w_(w), h_(h), nzNbr_(nzNbr),
+		values(nzNbr), col_ind(nzNbr), row_ptr((size_t) h + 1) {}
+
+	CsrMatrix(CsrMatrix&&) = default;
+	CsrMatrix& operator=(CsrMatrix&&) = default;
+
+	uint w() const { return w_; }
+	uint h() const { return h_; }
+	Index nzNbr() const { return nzNbr_; }
+	T* data() const { return values.data(); }
+	uint* colInd() const { return col_ind.data(); }
+	Index* rowPtr() const { return row_ptr.data(); }
+
+	CsrView<T, Index> view() const
+	{
+		CsrView<T, Index> v = {w_, h_, values.data(), col_ind.data(), row_ptr.data()};
+		return v;
+	}
+	CsrView<T, Index> rows(uint r0, uint r1) const { return view().rows(r0, r1); }
+
+	// C structure sharing the arrays, to call the existing functions without copy
+	matrixCSRT<Index> cView() const
+	{
+		matrixCSRT<Index> m = {w_, h_, nzNbr_, values.data(), col_ind.data(), row_ptr.data()};
+		return m;
+	}
+
+	// take ownership of the arrays of a C CSR matrix and destroy the structure
+	static CsrMatrix adopt(matrixCSRT<Index> **m)
+	{
+		CsrMatrix c;
+		c.w_ = (*m)->w;
+		c.h_ = (*m)->h;
+		c.nzNbr_ = (*m)->nzNbr;
+		c.values = AlignedBuffer<T>::adopt((*m)->data, c.nzNbr_);
+		c.col_ind = AlignedBuffer<uint>::adopt((*m)->col_ind, c.nzNbr_);
+		c.row_ptr = AlignedBuffer<Index>::adopt((*m)->row_ptr, (size_t) c.h_ + 1);
+		free(*m);
+		*m = NULL;
+		return c;
+	}
+
+	// give the arrays to a C CSR matrix, to be destroyed with deleteMatrixCSR()
+	// or deleteMatrixCSR64()
+	matrixCSRT<Index>* release()
+	{
+		matrixCSRT<Index> *m = (matrixCSRT<Index>*) malloc(sizeof(matrixCSRT<Index>));
+		if( ! m )
+			throw std::bad_alloc();
+		m->w = w_;
+		m->h = h_;
+		m->nzNbr = nzNbr_;
+		m->data = values.release();
+		m->col_ind = col_ind.release();
+		m->row_ptr = row_ptr.release();
+		w_ = h_ = 0;
+		nzNbr_ = 0;
+		return m;
+	}
+
+private:
+	uint w_;
+	uint h_;
+	Index nzNbr_;
+	AlignedBuffer<T> values;
+	AlignedBuffer<uint> col_ind;
+	AlignedBuffer<Index> row_ptr;
+};
+
+
+/**
+  Adapters between MatrixCSR and CsrMatrix<float, uint>, whose C structures
+  have the same fields.
+*/
+inline CsrMatrix<float, uint> adoptCSR(MatrixCSR **m)
+{
+	matrixCSRT<uint> *t = (matrixCSRT<uint>*) malloc(sizeof(matrixCSRT<uint>));
+	if( ! t )
+		throw std::bad_alloc();
+	*t = csrView(*m);
+	free(*m);
+	*m = NULL;
+	return CsrMatrix<float, uint>::adopt(&t);
+}
+
+inline MatrixCSR* releaseCSR(CsrMatrix<float, uint> &c)
+{
+	matrixCSRT<uint> *t = c.release();
+	MatrixCSR *m = (MatrixCSR*) malloc(sizeof(MatrixCSR));
+	if( ! m )
+		throw std::bad_alloc();
+	m->w = t->w;
+	m->h = t->h;
+	m->nzNbr = t->nzNbr;
+	m->data = t->data;
+	m->col_ind = t->col_ind;
+	m->row_ptr = t->row_ptr;
+	free(t);
+	return m;
+}
+
+inline MatrixCSR cViewCSR(const CsrMatrix<float, uint> &c)
+{
+	MatrixCSR m = {c.w(), c.h(), c.nzNbr(), c.data(), c.colInd(), c.rowPtr()};
+	return m;
+}
+
+#endif
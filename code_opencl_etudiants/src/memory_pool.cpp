@@ -0,0 +1,115 @@
+#include<cstdio>
+#include<cstdlib>
+#include<map>
+#include<mutex>
+#include<new>
+#include<vector>
+
+#include"memory_pool.h"
+
+
+// blocks start with a header holding their size class, user memory is
+// aligned like the header
+#define POOL_ALIGNMENT 64
+#define POOL_MIN_CLASS 4096
+
+
+/**
+  Size class of an allocation.
+*/
+size_t poolSizeClass(size_t bytes)
+{
+	if( bytes <= POOL_MIN_CLASS )
+		return POOL_MIN_CLASS;
+
+	size_t p = POOL_MIN_CLASS;
+	while( p < bytes / 2 )
+		p <<= 1;
+	// p < bytes <= 2p, round up to a multiple of p/4
+	size_t step = p / 4;
+	return (bytes + step - 1) / step * step;
+}
+
+
+/**
+  Display the statistics of a pool.
+*/
+void printPoolStats(const char *title, const PoolStats &stats)
+{
+	printf("%s: %lu allocations, %f%% served from cache, peak footprint %f MB, %f MB in use.\n", title,
+		stats.requests, stats.requests ? 100.0 * stats.hits / stats.requests : 0.0,
+		stats.peakFootprint / 1048576.0, stats.inUse / 1048576.0);
+}
+
+
+// host pool state
+static std::mutex hostMutex;
+static std::map< size_t, std::vector<void*> > hostFreeBlocks;
+static PoolStats hostStats = {0, 0, 0, 0, 0};
+
+
+/**
+  Allocate host memory from the pool.
+*/
+void* poolAlloc(size_t bytes)
+{
+	size_t sizeClass = poolSizeClass(bytes);
+	void *block = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(hostMutex);
+		hostStats.requests++;
+		hostStats.inUse += sizeClass;
+
+		std::vector<void*> &blocks = hostFreeBlocks[sizeClass];
+		if( ! blocks.empty() )
+		{
+			hostStats.hits++;
+			block = blocks.back();
+			blocks.pop_back();
+		}
+		else
+		{
+			hostStats.footprint += sizeClass;
+			if( hostStats.footprint > hostStats.peakFootprint )
+				hostStats.peakFootprint = hostStats.footprint;
+		}
+	}
+
+	if( ! block )
+	{
+		if( posix_memalign(&block, POOL_ALIGNMENT, POOL_ALIGNMENT + sizeClass) )
+			throw std::bad_alloc();
+		*(size_t*) block = sizeClass;
+	}
+
+	return (char*) block + POOL_ALIGNMENT;
+}
+
+
+/**
+  Give back a block allocated by poolAlloc() to the pool.
+*/
+void poolFree(void *p)
+{
+	if( ! p )
+		return;
+
+	void *block = (char*) p - POOL_ALIGNMENT;
+	size_t sizeClass = *(size_t*) block;
+
+	std::lock_guard<std::mutex> lock(hostMutex);
+	hostStats.inUse -= sizeClass;
+	hostFreeBlocks[sizeClass].push_back(block);
+}
+
+
+/**
+  Statistics of the host pool.
+*/
+PoolStats getHostPoolStats()
+{
+	std::lock_guard<std::mutex> lock(hostMutex);
+	return hostStats;
+}
+
@@ -0,0 +1,52 @@
+#ifndef __MEMORY_POOL_H__
+#define __MEMORY_POOL_H__
+
+#include<cstddef>
+
+#include"common.h"
+
+
+/**
+  Usage statistics of a memory pool.
+*/
+typedef struct poolStats
+{
+	unsigned long requests; // number of allocations
+	unsigned long hits; // allocations served by a cached block
+	size_t inUse; // bytes of the blocks in use
+	size_t footprint; // bytes of the blocks in use or cached
+	size_t peakFootprint; // largest footprint so far
+} PoolStats;
+
+
+/**
+  Size class of an allocation: sizes are rounded up to a quarter of their
+  power of 2 (with 4 KB at least), so a cached block is at most 25% larger
+  than needed.
+*/
+size_t poolSizeClass(size_t bytes);
+
+/**
+  Display the statistics of a pool.
+*/
+void printPoolStats(const char *title, const PoolStats &stats);
+
+
+/**
+  Allocate host memory from the pool, aligned on 64 bytes. Freed blocks are
+  kept by size class and reused by the next allocations of the same class.
+  Memory must be given back by calling poolFree(). Thread safe.
+*/
+void* poolAlloc(size_t bytes);
+
+/**
+  Give back a block allocated by poolAlloc() to the pool.
+*/
+void poolFree(void *p);
+
+/**
+  Statistics of the host pool.
+*/
+PoolStats getHostPoolStats();
+
+#endif
@@ -1,9 +1,37 @@
 #include<stdio.h>
+#include<algorithm>
+#include<climits>
 #include<stdexcept>
+#include<vector>
 
 #include"tools.h"
 #include"common.h"
 #include"mult_mat_vect_opencl.h"
+#include"dense_gemm.h"
+#include"power_iteration.h"
+#include"transpose_spmv.h"
+#include"spgemm.h"
+#include"spmv_formats.h"
+#include"spmv_half.h"
+#include"spmv_quant.h"
+#include"spmv_delta.h"
+#include"spmv_csr64.h"
+#include"numa_alloc.h"
+#include"benchmark.h"
+#include"roofline.h"
+#include"matrix_generator.h"
+#include"matrix_market.h"
+#include"reordering.h"
+#include"spmv_binned.h"
+#include"spmv_colblock.h"
+#include"spmv_bsr.h"
+#include"spmv_dia.h"
+#include"spmv_csr5.h"
+#include"spmv_coo.h"
+#include"spmv_symmetric.h"
+#include"memory_pool.h"
+#include"opencl_tools.h"
+#include"spmv_dispatch.h"
 
 
 /**
@@ -20,18 +48,10 @@ Matrix* cpuSpmvClassical(const Matrix *m1, const Matrix *m2)
 	Matrix *m1xm2 = createMatrix(width, height);
 
 	top(0);
-	for(uint r = 0; r < height; r++)
-	{
-		for(uint c = 0; c < width; c++)
-		{
-			float tmp = 0;
-
-			for(uint k = 0; k < m1->w; k++)
-				tmp += m1->data[r*(m1->w) + k] * m2->data[k*(m2->w) + c];
-
-			m1xm2->data[r*width + c] = tmp;
-		}
-	}
+	if(width == 1)
+		cpuGemv(height, m1->w, m1->data, m1->w, m2->data, m1xm2->data);
+	else
+		cpuGemm(height, width, m1->w, m1->data, m1->w, m2->data, m2->w, m1xm2->data, width);
 	double cpuRunTime = top(0);
 
 	printf("Classical method on cpu: M(%dx%d)xV computed in %f ms.\n", m1->w, m1->h, cpuRunTime);
@@ -40,41 +60,471 @@ Matrix* cpuSpmvClassical(const Matrix *m1, const Matrix *m2)
 }
 
 
+/**
+  Benchmark the main MxV methods, and save the results if file names are
+  given.
+*/
+void benchmarkMethods(const MatrixCSR *mCSR, const Matrix *v, const Matrix *reference, const BenchConfig &config,
+	const char *jsonFileName, const char *csvFileName)
+{
+	std::vector<BenchResult> results;
+	double bytes = spmvCSRBytes(mCSR);
+	getBandwidthPeaks(); // measured before the runs, not in the middle of them
+
+	matrixCSRT<uint> view = csrView(mCSR);
+	results.push_back(benchmarkSpmv("CSR method on CPU", cpuSpmvCSRT<uint>, &view, v, reference, mCSR->nzNbr, bytes, config));
+	results.push_back(benchmarkSpmv("CSR method on GPU", gpuSpmvCSR, mCSR, v, reference, mCSR->nzNbr, bytes, config));
+	results.push_back(benchmarkSpmv("CSR-Vect method on GPU", gpuSpmvCSRVect, mCSR, v, reference, mCSR->nzNbr, bytes, config));
+
+	if( isELLCandidate(mCSR, NULL) )
+	{
+		MatrixELL *mELL = csrToELL(mCSR);
+		results.push_back(benchmarkSpmv("ELL method on GPU", gpuSpmvELL, mELL, v, reference, mCSR->nzNbr, bytes, config));
+		deleteMatrixELL(&mELL);
+	}
+
+	MatrixHYB *mHYB = csrToHYB(mCSR, computeRowStats(mCSR).hybRowSz);
+	results.push_back(benchmarkSpmv("HYB method on GPU", gpuSpmvHYB, mHYB, v, reference, mCSR->nzNbr, bytes, config));
+	deleteMatrixHYB(&mHYB);
+
+	MatrixCSRBinned *mBinned = csrToBinned(mCSR);
+	results.push_back(benchmarkSpmv("CSR binned method on GPU", gpuSpmvCSRBinned, mBinned, v, reference, mCSR->nzNbr, bytes, config));
+	deleteMatrixCSRBinned(&mBinned);
+
+	MatrixCSR5 *mCSR5 = csrToCSR5(mCSR, CSR5_GPU_OMEGA);
+	results.push_back(benchmarkSpmv("CSR5 method on GPU", gpuSpmvCSR5, mCSR5, v, reference, mCSR->nzNbr, bytes, config));
+	deleteMatrixCSR5(&mCSR5);
+
+	MatrixCOO *mCOO = csrToCOO(mCSR);
+	results.push_back(benchmarkSpmv("COO method on GPU", gpuSpmvCOO, mCOO, v, reference, mCSR->nzNbr, bytes, config));
+	deleteMatrixCOO(&mCOO);
+
+	results.push_back(benchmarkSpmv("Format chosen by the cost model", spmv, mCSR, v, reference, mCSR->nzNbr, bytes, config));
+
+	if( jsonFileName )
+		writeBenchJSON(jsonFileName, results);
+	if( csvFileName )
+		writeBenchCSV(csvFileName, results);
+}
+
+
+/**
+  Run the MxV methods of matrices with 2^32 non zero values or more, CSR
+  with 64 bit row pointers being the only format able to index them. The
+  CSR 64 bit method on CPU is used as reference.
+*/
+void spmvCSR64Methods(const MatrixCSR64 *mCSR64, const BenchConfig &config, const char *jsonFileName,
+	const char *csvFileName)
+{
+	Matrix *v = createMatrix(1, mCSR64->w);
+	initMatrix(v, 0.0f);
+
+	// same bytes as spmvCSRBytes(), with 64 bit row pointers
+	double bytes = (double) mCSR64->nzNbr * (sizeof(float) + sizeof(uint)) + (double) (mCSR64->h + 1) * sizeof(uint64_t)
+		+ (double) mCSR64->w * sizeof(float) + (double) mCSR64->h * sizeof(float);
+
+	Matrix *mv_cpu_csr64 = cpuSpmvCSRT(mCSR64, v);
+	Matrix *mv_gpu_csr64 = gpuSpmvCSR64(mCSR64, v, mv_cpu_csr64);
+	printRoofline("CSR 64 bit method on GPU", bytes);
+	deleteMatrix(&mv_gpu_csr64);
+
+	if( config.runs > 0 )
+	{
+		std::vector<BenchResult> results;
+		getBandwidthPeaks(); // measured before the runs, not in the middle of them
+
+		results.push_back(benchmarkSpmv("CSR 64 bit method on CPU", cpuSpmvCSRT<uint64_t>, mCSR64, v, mv_cpu_csr64,
+			mCSR64->nzNbr, bytes, config));
+		results.push_back(benchmarkSpmv("CSR 64 bit method on GPU", gpuSpmvCSR64, mCSR64, v, mv_cpu_csr64,
+			mCSR64->nzNbr, bytes, config));
+
+		if( jsonFileName )
+			writeBenchJSON(jsonFileName, results);
+		if( csvFileName )
+			writeBenchCSV(csvFileName, results);
+	}
+
+	deleteMatrix(&mv_cpu_csr64);
+	deleteMatrix(&v);
+}
+
+
 /**
   Do matrix-vector multiplication with various methods.
 */
 int main(int argc, const char **argv)
 {
-	if(argc != 2)
+	const char *pattern = getArgValueFromCmdl(argc, argv, "-generate");
+	if(argc < 2 || (argv[1][0] == '-' && ! pattern))
 	{
-		printf("Usage: %s dataset_basename\n", argv[0]);
+		printf("Usage: %s dataset_basename [-bench=runs] [-warmup=runs] [-json=file] [-csv=file]\n", argv[0]);
+		printf("       %s matrix.mtx [-bench=runs] ...\n", argv[0]);
+		printf("       %s -generate=pattern [-n=size] [-param=value] [-bench=runs] ...\n", argv[0]);
 		printf("Example: %s  mat_1000x1500_0.50\n", argv[0]);
+		printf("Patterns: banded, block, stencil2d, stencil3d, rmat, uniform\n");
 		return 1;
 	}
 
-	std::string matrixFileName = std::string(argv[1]) + ".M";
-	std::string vectorFileName = std::string(argv[1]) + ".V";
+	// optional benchmark of the main methods
+	BenchConfig benchConfig = {3, 0};
+	const char *benchArg = getArgValueFromCmdl(argc, argv, "-bench");
+	const char *warmupArg = getArgValueFromCmdl(argc, argv, "-warmup");
+	const char *jsonFileName = getArgValueFromCmdl(argc, argv, "-json");
+	const char *csvFileName = getArgValueFromCmdl(argc, argv, "-csv");
+	if( benchArg )
+		benchConfig.runs = atoi(benchArg);
+	if( warmupArg )
+		benchConfig.warmupRuns = std::max(atoi(warmupArg), 1);
+
+	Matrix *m = NULL;
+	Matrix *v = NULL;
+	MatrixCSR *mCSR = NULL;
+	Matrix *mv_cpu_classical = NULL;
+	std::string dataset = argv[1];
+	bool isMatrixMarket = dataset.size() > 4 && dataset.compare(dataset.size() - 4, 4, ".mtx") == 0;
+	if( isMatrixMarket && ! pattern )
+	{
+		// sparse matrix file, only read in CSR, CSR method on CPU used as reference
+		if( matrixMarketNzBound(dataset.c_str()) > UINT_MAX )
+		{
+			MatrixCSR64 *mCSR64 = readMatrixMarket64(dataset.c_str());
+			printf("%u x %u matrix with %lu non zero values, only CSR 64 bit methods are run.\n",
+				mCSR64->w, mCSR64->h, (unsigned long) mCSR64->nzNbr);
+			spmvCSR64Methods(mCSR64, benchConfig, jsonFileName, csvFileName);
+			deleteMatrixCSR64(&mCSR64);
+			return 0;
+		}
+
+		mCSR = readMatrixMarket(dataset.c_str());
+		v = createMatrix(1, mCSR->w);
+		initMatrix(v, 0.0f);
+
+		matrixCSRT<uint> view = csrView(mCSR);
+		mv_cpu_classical = cpuSpmvCSRT(&view, v);
+	}
+	else if( pattern )
+	{
+		// synthetic matrix, only built in CSR, CSR method on CPU used as reference
+		MatrixPattern p = matrixPatternFromName(pattern);
+		if( p == PATTERNS_NBR )
+		{
+			printf("Unknown matrix pattern %s.\n", pattern);
+			return 1;
+		}
+
+		const char *nArg = getArgValueFromCmdl(argc, argv, "-n");
+		const char *paramArg = getArgValueFromCmdl(argc, argv, "-param");
+		GeneratorParams params = defaultGeneratorParams(p, nArg ? (uint) atol(nArg) : 65536);
+		if( paramArg )
+			params.param = (uint) atol(paramArg);
+
+		// the count of values is only known once rows are generated, 32 bit
+		// row pointers are tried first
+		MatrixCSR64 *mCSR64 = NULL;
+		try
+		{
+			mCSR = generateCSR(params);
+		}
+		catch( std::runtime_error &e )
+		{
+			printf("%s\n", e.what());
+			mCSR64 = generateCSR64(params);
+		}
 
-	Matrix *m = readMatrixFromFile(matrixFileName.c_str());
-	Matrix *v = readMatrixFromFile(vectorFileName.c_str());
+		if( mCSR64 )
+		{
+			printf("%u x %u matrix with %lu non zero values, only CSR 64 bit methods are run.\n",
+				mCSR64->w, mCSR64->h, (unsigned long) mCSR64->nzNbr);
+			spmvCSR64Methods(mCSR64, benchConfig, jsonFileName, csvFileName);
+			deleteMatrixCSR64(&mCSR64);
+			return 0;
+		}
 
-	// classical method on CPU, used as reference
-	Matrix *mv_cpu_classical = cpuSpmvClassical(m, v);
+		v = createMatrix(1, mCSR->w);
+		initMatrix(v, 0.0f);
+
+		matrixCSRT<uint> view = csrView(mCSR);
+		mv_cpu_classical = cpuSpmvCSRT(&view, v);
+	}
+	else
+	{
+		std::string matrixFileName = std::string(argv[1]) + ".M";
+		std::string vectorFileName = std::string(argv[1]) + ".V";
+
+		m = readMatrixFromFile(matrixFileName.c_str());
+		v = readMatrixFromFile(vectorFileName.c_str());
+
+		// classical method on CPU, used as reference
+		mv_cpu_classical = cpuSpmvClassical(m, v);
+		mCSR = matrixToCSR(m);
+	}
+
+	// bytes moved by one MxV, to compare the GPU methods to the device bandwidth
+	double bytes = spmvCSRBytes(mCSR);
 
 	// CSR method on GPU
-	MatrixCSR *mCSR = matrixToCSR(m);
 	Matrix *mv_gpu_csr = gpuSpmvCSR(mCSR, v, mv_cpu_classical);
+	printRoofline("CSR method on GPU", bytes);
 	deleteMatrix(&mv_gpu_csr);
 
 	// CSR-Vect method on GPU
 	Matrix *mv_gpu_csr_vect = gpuSpmvCSRVect(mCSR, v, mv_cpu_classical);
+	printRoofline("CSR-Vect method on GPU", bytes);
 	deleteMatrix(&mv_gpu_csr_vect);
 
+	// dense method on GPU, synthetic and Matrix Market matrices are never stored as dense
+	if( m )
+	{
+		Matrix *mv_gpu_dense = gpuGemv(m, v, mv_cpu_classical);
+		deleteMatrix(&mv_gpu_dense);
+
+		// dense product with several right hand sides, checked against the CPU GEMM
+		Matrix *vs = createMatrix(16, m->w);
+		initMatrix(vs, 0.0f);
+		Matrix *mvs_cpu = cpuSpmvClassical(m, vs);
+		Matrix *mvs_gpu = gpuGemm(m, vs, mvs_cpu);
+		deleteMatrix(&mvs_gpu);
+		deleteMatrix(&mvs_cpu);
+		deleteMatrix(&vs);
+	}
+
+	// ELL and HYB methods on GPU, ELL only if padding is small
+	uint ellRowSz = 0;
+	if( isELLCandidate(mCSR, &ellRowSz) )
+	{
+		MatrixELL *mELL = csrToELL(mCSR);
+		Matrix *mv_gpu_ell = gpuSpmvELL(mELL, v, mv_cpu_classical);
+		printRoofline("ELL method on GPU", bytes);
+		deleteMatrix(&mv_gpu_ell);
+		deleteMatrixELL(&mELL);
+	}
+	else
+		printf("ELL: longest row of %d values, %f times the values with padding, skipped.\n", ellRowSz,
+			(double) mCSR->h * ellRowSz / std::max(mCSR->nzNbr, 1u));
+
+	MatrixHYB *mHYB = csrToHYB(mCSR, computeRowStats(mCSR).hybRowSz);
+	Matrix *mv_gpu_hyb = gpuSpmvHYB(mHYB, v, mv_cpu_classical);
+	printRoofline("HYB method on GPU", bytes);
+	deleteMatrix(&mv_gpu_hyb);
+	deleteMatrixHYB(&mHYB);
+
+	// 16 bit values, float accumulation, accuracy checked against float result
+	for(int f = HALF_FP16; f <= HALF_BF16; f++)
+	{
+		MatrixCSRHalf *mHalf = csrToHalf(mCSR, (HalfFormat) f);
+		Matrix *mv_cpu_half = cpuSpmvCSRHalf(mHalf, v, mv_cpu_classical);
+		Matrix *mv_gpu_half = gpuSpmvCSRHalf(mHalf, v, mv_cpu_classical);
+		deleteMatrix(&mv_cpu_half);
+		deleteMatrix(&mv_gpu_half);
+		deleteMatrixCSRHalf(&mHalf);
+	}
+
+	// integer codes, when values can be quantized exactly
+	MatrixCSRQuant *mQuant = csrToQuant(mCSR);
+	if( mQuant )
+	{
+		Matrix *mv_cpu_quant = cpuSpmvCSRQuant(mQuant, v, mv_cpu_classical);
+		Matrix *mv_gpu_quant = gpuSpmvCSRQuant(mQuant, v, mv_cpu_classical);
+		deleteMatrix(&mv_cpu_quant);
+		deleteMatrix(&mv_gpu_quant);
+		deleteMatrixCSRQuant(&mQuant);
+	}
+
+	// delta encoded column indices
+	MatrixCSRDelta *mDelta = csrToDelta(mCSR);
+	printDeltaBytes(mCSR, mDelta);
+	Matrix *mv_cpu_delta = cpuSpmvCSRDelta(mDelta, v, mv_cpu_classical);
+	Matrix *mv_gpu_delta = gpuSpmvCSRDelta(mDelta, v, mv_cpu_classical);
+	deleteMatrix(&mv_cpu_delta);
+	deleteMatrix(&mv_gpu_delta);
+	deleteMatrixCSRDelta(&mDelta);
+
+	// 64 bit row pointers, as needed for more than 2^32 non zero values
+	MatrixCSR64 *mCSR64 = csrTo64(mCSR);
+	Matrix *mv_cpu_csr64 = cpuSpmvCSRT(mCSR64, v, mv_cpu_classical);
+	Matrix *mv_gpu_csr64 = gpuSpmvCSR64(mCSR64, v, mv_cpu_classical);
+	deleteMatrix(&mv_cpu_csr64);
+	deleteMatrix(&mv_gpu_csr64);
+	deleteMatrixCSR64(&mCSR64);
+
+	// arrays first touched by the thread processing them, x replicated per node
+	MatrixCSRNuma *mNuma = csrToNuma(mCSR, HUGE_PAGES_TRANSPARENT);
+	ReplicatedVector *vNuma = replicateVector(v, HUGE_PAGES_TRANSPARENT);
+	Matrix *mv_cpu_numa = cpuSpmvCSRNuma(mNuma, vNuma, mv_cpu_classical);
+	deleteMatrix(&mv_cpu_numa);
+	deleteReplicatedVector(&vNuma);
+	deleteMatrixCSRNuma(&mNuma);
+
+	// rows sorted by length, one kernel per bin of rows
+	MatrixCSRBinned *mBinned = csrToBinned(mCSR);
+	Matrix *mv_gpu_binned = gpuSpmvCSRBinned(mBinned, v, mv_cpu_classical);
+	printRoofline("CSR binned method on GPU", bytes);
+	deleteMatrix(&mv_gpu_binned);
+	deleteMatrixCSRBinned(&mBinned);
+
+	// vertical strips, x segment of a strip in L2 on CPU and in local memory on GPU
+	MatrixCSRColBlocked *mColBlockedCPU = csrToColBlocked(mCSR, cpuStripWidth(), COLBLOCK_CPU_ROWS);
+	Matrix *mv_cpu_colblocked = cpuSpmvCSRColBlocked(mColBlockedCPU, v, mv_cpu_classical);
+	deleteMatrix(&mv_cpu_colblocked);
+	deleteMatrixCSRColBlocked(&mColBlockedCPU);
+
+	MatrixCSRColBlocked *mColBlockedGPU = csrToColBlocked(mCSR, gpuStripWidth(), COLBLOCK_GPU_ROWS);
+	Matrix *mv_gpu_colblocked = gpuSpmvCSRColBlocked(mColBlockedGPU, v, mv_cpu_classical);
+	printRoofline("CSR column blocked method on GPU", bytes);
+	deleteMatrix(&mv_gpu_colblocked);
+	deleteMatrixCSRColBlocked(&mColBlockedGPU);
+
+	// register blocking, block size chosen from the fill ratio
+	float bsrFill = 1.0f;
+	uint bsrSize = detectBlockSize(mCSR, &bsrFill);
+	if( bsrSize > 1 )
+	{
+		printf("BSR: %dx%d blocks, fill ratio %f.\n", bsrSize, bsrSize, bsrFill);
+		MatrixBSR *mBSR = csrToBSR(mCSR, bsrSize);
+		Matrix *mv_cpu_bsr = cpuSpmvBSR(mBSR, v, mv_cpu_classical);
+		Matrix *mv_gpu_bsr = gpuSpmvBSR(mBSR, v, mv_cpu_classical);
+		printRoofline("BSR method on GPU", bytes);
+		deleteMatrix(&mv_cpu_bsr);
+		deleteMatrix(&mv_gpu_bsr);
+		deleteMatrixBSR(&mBSR);
+	}
+	else
+		printf("BSR: no block size reduces the matrix size, skipped.\n");
+
+	// diagonal storage, only for matrices with a few diagonals
+	uint diagsNbr = 0;
+	if( isDIACandidate(mCSR, &diagsNbr) )
+	{
+		MatrixDIA *mDIA = csrToDIA(mCSR);
+		Matrix *mv_cpu_dia = cpuSpmvDIA(mDIA, v, mv_cpu_classical);
+		Matrix *mv_gpu_dia = gpuSpmvDIA(mDIA, v, mv_cpu_classical);
+		printRoofline("DIA method on GPU", bytes);
+		deleteMatrix(&mv_cpu_dia);
+		deleteMatrix(&mv_gpu_dia);
+		deleteMatrixDIA(&mDIA);
+	}
+	else
+		printf("DIA: %d diagonals, skipped.\n", diagsNbr);
+
+	// CSR5 tiles, one AVX2 register or one warp wide, balanced whatever the rows
+	MatrixCSR5 *mCSR5CPU = csrToCSR5(mCSR, CSR5_CPU_OMEGA);
+	Matrix *mv_cpu_csr5 = cpuSpmvCSR5(mCSR5CPU, v, mv_cpu_classical);
+	deleteMatrix(&mv_cpu_csr5);
+	deleteMatrixCSR5(&mCSR5CPU);
+
+	MatrixCSR5 *mCSR5GPU = csrToCSR5(mCSR, CSR5_GPU_OMEGA);
+	Matrix *mv_gpu_csr5 = gpuSpmvCSR5(mCSR5GPU, v, mv_cpu_classical);
+	printRoofline("CSR5 method on GPU", bytes);
+	deleteMatrix(&mv_gpu_csr5);
+	deleteMatrixCSR5(&mCSR5GPU);
+
+	// COO triples, read directly from Matrix Market files
+	MatrixCOO *mCOO = (isMatrixMarket && ! pattern) ? readMatrixMarketCOO(dataset.c_str()) : csrToCOO(mCSR);
+	Matrix *mv_cpu_coo = cpuSpmvCOO(mCOO, v, mv_cpu_classical);
+	Matrix *mv_gpu_coo = gpuSpmvCOO(mCOO, v, mv_cpu_classical);
+	printRoofline("COO method on GPU", bytes);
+	deleteMatrix(&mv_cpu_coo);
+	deleteMatrix(&mv_gpu_coo);
+	deleteMatrixCOO(&mCOO);
+
+	// symmetric matrices, upper triangle only
+	if( isSymmetricCSR(mCSR) )
+	{
+		MatrixCSRSym *mSym = csrToSymmetric(mCSR);
+		Matrix *mv_cpu_sym = cpuSpmvSymmetric(mSym, v, mv_cpu_classical);
+		Matrix *mv_gpu_sym = gpuSpmvSymmetric(mSym, v, mv_cpu_classical);
+		deleteMatrix(&mv_cpu_sym);
+		deleteMatrix(&mv_gpu_sym);
+		deleteMatrixCSRSym(&mSym);
+	}
+	else
+		printf("Symmetric storage: matrix isn't symmetric, skipped.\n");
+
+	// reorderings of square matrices, x and y stay in the original order,
+	// compared to the same methods on the original matrix
+	if(mCSR->w == mCSR->h)
+	{
+		Matrix *mv_gpu_original = NULL;
+		double csrTime = timeSpmv(gpuSpmvCSR, mCSR, v, &mv_gpu_original);
+		deleteMatrix(&mv_gpu_original);
+		double csrVectTime = timeSpmv(gpuSpmvCSRVect, mCSR, v, &mv_gpu_original);
+		deleteMatrix(&mv_gpu_original);
+
+		for(int r = 0; r < REORDER_METHODS_NBR; r++)
+		{
+			ReorderedCSR *mReordered = reorderCSR(mCSR, (ReorderMethod) r);
+			printReorderReport(mCSR, mReordered);
+
+			double reorderedTime = 0.0;
+			Matrix *mv_gpu_reordered = spmvReordered("CSR method on GPU", gpuSpmvCSR, mReordered, v,
+				mv_cpu_classical, &reorderedTime);
+			printReorderSpeedup(mReordered, "CSR method on GPU", csrTime, reorderedTime);
+			Matrix *mv_gpu_reordered_vect = spmvReordered("CSR-Vect method on GPU", gpuSpmvCSRVect, mReordered, v,
+				mv_cpu_classical, &reorderedTime);
+			printReorderSpeedup(mReordered, "CSR-Vect method on GPU", csrVectTime, reorderedTime);
+			deleteMatrix(&mv_gpu_reordered);
+			deleteMatrix(&mv_gpu_reordered_vect);
+			deleteReorderedCSR(&mReordered);
+		}
+	}
+
+	// format chosen by the cost model
+	Matrix *mv_gpu = spmv(mCSR, v, mv_cpu_classical);
+	deleteMatrix(&mv_gpu);
+
+	// transpose product Mt(MV), CSC view is built once for both CSC methods
+	MatrixCSR *mCSC = NULL;
+	Matrix *mtv_cpu_scatter = cpuSpmvTranspose(mCSR, mv_cpu_classical, NULL, NULL, TRANSPOSE_SCATTER);
+	Matrix *mtv_cpu_csc = cpuSpmvTranspose(mCSR, mv_cpu_classical, &mCSC, mtv_cpu_scatter, TRANSPOSE_CSC);
+	Matrix *mtv_gpu_scatter = gpuSpmvTranspose(mCSR, mv_cpu_classical, NULL, mtv_cpu_scatter, TRANSPOSE_SCATTER);
+	Matrix *mtv_gpu_csc = gpuSpmvTranspose(mCSR, mv_cpu_classical, &mCSC, mtv_cpu_scatter, TRANSPOSE_CSC);
+	deleteMatrix(&mtv_cpu_scatter);
+	deleteMatrix(&mtv_cpu_csc);
+	deleteMatrix(&mtv_gpu_scatter);
+	deleteMatrix(&mtv_gpu_csc);
+
+	// sparse product MtxM, with the CSC view of M as Mt, skipped if the
+	// product is too large for 32 bit offsets
+	MatrixCSR *mtm_cpu = NULL;
+	MatrixCSR *mtm_gpu = NULL;
+	try
+	{
+		mtm_cpu = cpuSpgemm(mCSC, mCSR);
+		mtm_gpu = gpuSpgemm(mCSC, mCSR, mtm_cpu);
+	}
+	catch( std::runtime_error &e )
+	{
+		printf("SpGEMM: %s Skipped.\n", e.what());
+	}
+	if( mtm_cpu )
+		deleteMatrixCSR(&mtm_cpu);
+	if( mtm_gpu )
+		deleteMatrixCSR(&mtm_gpu);
+
+	// power iteration, only meaningful for square matrices
+	if(mCSR->w == mCSR->h)
+	{
+		Matrix *x_cpu_power = cpuPowerIteration(mCSR, 1.0f, 1e-6f, 1000);
+		Matrix *x_gpu_power = gpuPowerIteration(mCSR, 1.0f, 1e-6f, 1000, x_cpu_power);
+		deleteMatrix(&x_cpu_power);
+		deleteMatrix(&x_gpu_power);
+	}
+
+	// repeated runs with statistics
+	if( benchConfig.runs > 0 )
+		benchmarkMethods(mCSR, v, mv_cpu_classical, benchConfig, jsonFileName, csvFileName);
+
+	// reuse of temporary buffers across calls
+	printPoolStats("Host pool", getHostPoolStats());
+	printPoolStats("Device buffer pool", getDevicePoolStats());
+
 	// release memory
-	deleteMatrix(&m);
+	if( m )
+		deleteMatrix(&m);
 	deleteMatrix(&v);
 	deleteMatrix(&mv_cpu_classical);
 	deleteMatrixCSR(&mCSR);
+	deleteMatrixCSR(&mCSC);
 
 	return 0;
 }
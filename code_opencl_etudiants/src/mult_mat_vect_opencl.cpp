@@ -1,5 +1,4 @@
-#define __CL_ENABLE_EXCEPTIONS
-#include"cl.hpp"
+#include"opencl_tools.h"
 
 #include<cstdio>
 #include<cstdlib>
@@ -9,6 +8,7 @@
 
 #include"tools.h"
 #include"common.h"
+#include"benchmark.h"
 
 
 //---------------------------------------------------------
@@ -16,22 +16,21 @@
 // STUDENTS BEGIN
 
 std::string kernelSpmvCSR_source =
-"__kernel__ void spmvCSR(uint rowsNbr, const __global float *values, const __global uint *col_ind, const __global uint *row_ptr, const __global float *v, __global float *y)
-{\n\
-	uint r = get_global_id(0);\n\
-	if( r < rowsNbr )\n\
-	{\n\
-		float dot = 0.0f;\n\
-		int row_beg = row_ptr[r];\n\
-		int row_end = row_ptr[r+1];\n\
-\n\
-		for(uint i = row_beg; i < row_end; i++)\n\
-			dot += values[i] * v[col_ind[i]];\n\
-\n\
-		y[r] = dot;\n\
-	}\n\
-}\n\
-";
+	"__kernel void kernelSpmvCSR(uint rowsNbr, const __global float *values, const __global uint *col_ind, const __global uint *row_ptr, const __global float *v, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_beg = row_ptr[r];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_beg; i < row_end; i++)\n"
+	"			dot += values[i] * v[col_ind[i]];\n"
+	"\n"
+	"		y[r] = dot;\n"
+	"	}\n"
+	"}\n";
 
 // STUDENTS END
 
@@ -61,74 +60,29 @@ Matrix* gpuSpmvCSR(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
 
 	try
 	{
-		// init OpenCL
-
-		// retreive list of available platforms and select the first one
-		std::vector<cl::Platform> platforms;
-		cl::Platform::get(&platforms);
-		if( platforms.size() == 0 )
-			throw std::runtime_error("No OpenCL platform found. Check installation!\n");
-		cl::Platform platform = platforms[0];
-		std::cout << "Using platform: " << platform.getInfo<CL_PLATFORM_NAME>() << "\n";
-
-		// get the first GPU device of the selected platform
-		std::vector<cl::Device> devices;
-		platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
-		cl::Device device = devices[0];
-
-		// display informations on device
-		std::cout << "Using device:\n";
-		std::cout << "  CL_DEVICE_NAME    = " << device.getInfo<CL_DEVICE_NAME>() << "\n";
-		std::cout << "  CL_DEVICE_VENDOR  = " << device.getInfo<CL_DEVICE_VENDOR>() << "\n";
-		std::cout << "  CL_DEVICE_VERSION = " << device.getInfo<CL_DEVICE_VERSION>() << "\n";
-		std::cout << "  CL_DRIVER_VERSION = " << device.getInfo<CL_DRIVER_VERSION>() << "\n";
-
-		// create a context with the GPU device
-		cl::Context context(devices);
-
-		// create command queue using the context and device
-		cl::CommandQueue queue(context, device);
-		
-		// init ok
-		printf("Compute device successfully initialized.\n");
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
 
 		// compile kernel
 
-		// create a program from the kernel source code
-		cl::Program::Sources sources;
-		sources.push_back(std::make_pair(kernelSpmvCSR_source.c_str(), kernelSpmvCSR_source.length()));
-		cl::Program program(context, sources);
-
-		// compile program
-		try
-		{
-			program.build(devices);
-		}
-		catch( cl::Error err )
-		{
-			// display build log
-			std::cout << "Program build log:\n";
-			std::cout << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << "\n";
-
-			throw; // propagate exception
-		}
-		printf("Program successfully built.\n");
+		// build the program from the kernel source code, or get it from the cache
+		cl::Program program = buildProgram(kernelSpmvCSR_source);
 
 		// specify which kernel to execute
 		// (the program may contain several kernels)
 		cl::Kernel kernel(program, "kernelSpmvCSR");
 
 		// allocate global memory on GPU
-		uint valuesSizeInBytes = m->nzNbr * sizeof(float);
-		uint col_indSizeInBytes = m->nzNbr * sizeof(uint);
-		uint row_ptrSizeInBytes = (m->h + 1) * sizeof(uint);
-		uint vSizeInBytes = (v->h) * sizeof(float);
-		uint mvSizeInBytes = (m->h) * sizeof(float);
-		cl::Buffer gpuValues(context, CL_MEM_READ_ONLY, valuesSizeInBytes);
-		cl::Buffer gpuCol_ind(context, CL_MEM_READ_ONLY, col_indSizeInBytes);
-		cl::Buffer gpuRow_ptr(context, CL_MEM_READ_ONLY, row_ptrSizeInBytes);
-		cl::Buffer gpuV(context, CL_MEM_READ_ONLY, vSizeInBytes);
-		cl::Buffer gpuMV(context, CL_MEM_WRITE_ONLY, mvSizeInBytes); // result of matrix-vect multiplication
+		size_t valuesSizeInBytes = (size_t) m->nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) m->nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) (v->h) * sizeof(float);
+		size_t mvSizeInBytes = (size_t) (m->h) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes); // result of matrix-vect multiplication
 
 		// transfer data from CPU memory to GPU memory
 		top(0); // start time measurement
@@ -140,13 +94,21 @@ Matrix* gpuSpmvCSR(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
 
 		// STUDENTS BEGIN
 
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = ((m->h + work_group_size - 1) / work_group_size) * work_group_size;
+
 		// Set the arguments to our compute kernel
-		//TODO
-		//kernel.setArg(0, m->h);
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuV);
+		kernel.setArg(5, gpuMV);
 
 		// run kernel
 		top(1);
-		//TODO
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
 
 		// STUDENTS END
 
@@ -157,6 +119,13 @@ Matrix* gpuSpmvCSR(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
 		// transfer data from GPU memory to CPU memory
 		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
 		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
 	}
 	catch( cl::Error err )
 	{
@@ -199,6 +168,8 @@ Matrix* gpuSpmvCSR(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
 		throw std::runtime_error("Aborting.");
 	}
 
+	recordComputeTime(gpuComputeTime);
+
 	// check result, display run time if result is correct
 	bool displayRunTime = true;
 	if( reference )
@@ -218,40 +189,43 @@ Matrix* gpuSpmvCSR(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
 // STUDENTS BEGIN
 
 std::string kernelSpmvCSRVect_source =
-"__kernel__ void kernelSpmvCSRVect(uint rowsNbr, const __global float *values, const __global uint *col_ind, const __global uint *row_ptr, 
-const __global float *v, __global float *y, __local float *dots)
-{
-	// dots is dynamically allocated in local memory, size given as kernel arg
-	
-	uint threadId = get_global_id(0); // global thread index
-	uint localId = get_local_id(0); // thread index in workgroup
-	uint warpId = threadId / 32; // global warp index
-	uint lane = threadId % 32; // thread index within the warp
-
-	uint r = warpId; // one row per warp
-
-	if( r < rowsNbr )
-	{
-		int row_beg = row_ptr[r];
-		int row_end = row_ptr[r+1];
-		dots[localId] = 0.0f;
-
-		for(uint i = row_beg + lane; i < row_end; i+=32)
-			dots[localId] += values[i] * v[col_ind[i]];
-
-		// parallel reduction in shared memory
-		if( lane < 16 )  dots[localId] += dots[localId + 16];
-		if( lane <  8 )  dots[localId] += dots[localId +  8];
-		if( lane <  4 )  dots[localId] += dots[localId +  4];
-		if( lane <  2 )  dots[localId] += dots[localId +  2];
-		if( lane <  1 )  dots[localId] += dots[localId +  1];
-
-		// first thread writes the result in global memory
-		if( lane == 0 )
-			y[r] = dots[localId];
-	}
-}
-";
+	"__kernel void kernelSpmvCSRVect(uint rowsNbr, const __global float *values, const __global uint *col_ind, const __global uint *row_ptr,\n"
+	"	const __global float *v, __global float *y, __local float *dots)\n"
+	"{\n"
+	"	// dots is dynamically allocated in local memory, size given as kernel arg\n"
+	"\n"
+	"	size_t threadId = get_global_id(0); // global thread index, may exceed 32 bits\n"
+	"	uint localId = get_local_id(0); // thread index in workgroup\n"
+	"	uint warpId = threadId / 32; // global warp index\n"
+	"	uint lane = threadId % 32; // thread index within the warp\n"
+	"\n"
+	"	uint r = warpId; // one row per warp\n"
+	"\n"
+	"	float dot = 0.0f;\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		uint row_beg = row_ptr[r];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_beg + lane; i < row_end; i+=32)\n"
+	"			dot += values[i] * v[col_ind[i]];\n"
+	"	}\n"
+	"	dots[localId] = dot;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	// parallel reduction in local memory; barriers are reached by all the\n"
+	"	// work items, warps are not assumed to run in lockstep\n"
+	"	for(uint s = 16; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( lane < s )\n"
+	"			dots[localId] += dots[localId + s];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	// first thread writes the result in global memory\n"
+	"	if( lane == 0 && r < rowsNbr )\n"
+	"		y[r] = dots[localId];\n"
+	"}\n";
 
 // STUDENTS END
 
@@ -279,65 +253,35 @@ Matrix* gpuSpmvCSRVect(const MatrixCSR *m, const Matrix *v, const Matrix *refere
 	double gpuRunTime = 0;
 	double gpuComputeTime = 0;
 
-#if 0
 	try
 	{
-		// init OpenCL
-
-		// retreive list of available platforms and select the first one
-		std::vector<cl::Platform> platforms;
-		cl::Platform::get(&platforms);
-		if( platforms.size() == 0 )
-			throw std::runtime_error("No OpenCL platform found. Check installation!\n");
-		cl::Platform platform = platforms[0];
-		std::cout << "Using platform: " << platform.getInfo<CL_PLATFORM_NAME>() << "\n";
-
-		// get the first GPU device of the selected platform
-		std::vector<cl::Device> devices;
-		platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
-		cl::Device device = devices[0];
-
-		// display informations on device
-		std::cout << "Using device:\n";
-		std::cout << "  CL_DEVICE_NAME    = " << device.getInfo<CL_DEVICE_NAME>() << "\n";
-		std::cout << "  CL_DEVICE_VENDOR  = " << device.getInfo<CL_DEVICE_VENDOR>() << "\n";
-		std::cout << "  CL_DEVICE_VERSION = " << device.getInfo<CL_DEVICE_VERSION>() << "\n";
-		std::cout << "  CL_DRIVER_VERSION = " << device.getInfo<CL_DRIVER_VERSION>() << "\n";
-
-		// create a context with the GPU device
-		cl::Context context(devices);
-
-		// create command queue using the context and device
-		cl::CommandQueue queue(context, device);
-		
-		// init ok
-		printf("Compute device successfully initialized.\n");
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
 
 		// compile kernel
 
 		// STUDENTS BEGIN
 
-		// create a program from the kernel source code
-		
-		// compile program
+		// build the program from the kernel source code, or get it from the cache
+		cl::Program program = buildProgram(kernelSpmvCSRVect_source);
 
 		// specify which kernel to execute
 		// (the program may contain several kernels)
-		//TODO
-		
+		cl::Kernel kernel(program, "kernelSpmvCSRVect");
+
 		// STUDENTS END
 
 		// allocate global memory on GPU
-		uint valuesSizeInBytes = m->nzNbr * sizeof(float);
-		uint col_indSizeInBytes = m->nzNbr * sizeof(uint);
-		uint row_ptrSizeInBytes = (m->h + 1) * sizeof(uint);
-		uint vSizeInBytes = (v->h) * sizeof(float);
-		uint mvSizeInBytes = (m->h) * sizeof(float);
-		cl::Buffer gpuValues(context, CL_MEM_READ_ONLY, valuesSizeInBytes);
-		cl::Buffer gpuCol_ind(context, CL_MEM_READ_ONLY, col_indSizeInBytes);
-		cl::Buffer gpuRow_ptr(context, CL_MEM_READ_ONLY, row_ptrSizeInBytes);
-		cl::Buffer gpuV(context, CL_MEM_READ_ONLY, vSizeInBytes);
-		cl::Buffer gpuMV(context, CL_MEM_WRITE_ONLY, mvSizeInBytes); // result of matrix-vect multiplication
+		size_t valuesSizeInBytes = (size_t) m->nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) m->nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) (v->h) * sizeof(float);
+		size_t mvSizeInBytes = (size_t) (m->h) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes); // result of matrix-vect multiplication
 
 		// transfer data from CPU memory to GPU memory
 		top(0); // start time measurement
@@ -348,21 +292,27 @@ Matrix* gpuSpmvCSRVect(const MatrixCSR *m, const Matrix *v, const Matrix *refere
 		queue.enqueueWriteBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
 
 		// set workgroup and grid size
-		uint nbWarpsPerBlock = 1;
+		uint nbWarpsPerBlock = 8;
 		size_t work_group_size = 32*nbWarpsPerBlock; // 1 warp = 32 threads;
-		size_t global_work_size = ((int) ceilf(m->h*1.0/nbWarpsPerBlock)) * work_group_size;
+		size_t global_work_size = ((m->h + nbWarpsPerBlock - 1) / nbWarpsPerBlock) * work_group_size;
 
 		// STUDENTS BEGIN
 
 		// set the arguments to our compute kernel
-		//TODO
-		//kernel.setArg(0, m->h);
-		//kernel.setArg(6, sizeof(float)*work_group_size, NULL);
-		
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuV);
+		kernel.setArg(5, gpuMV);
+		kernel.setArg(6, sizeof(float)*work_group_size, NULL);
+
 		// run kernel
 		top(1);
-		//TODO
-		
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// STUDENTS END
+
 		// Wait for the command queue to get serviced before reading back results
 		queue.finish();
 		gpuComputeTime = top(1); // pure computation duration
@@ -370,6 +320,13 @@ Matrix* gpuSpmvCSRVect(const MatrixCSR *m, const Matrix *v, const Matrix *refere
 		// transfer data from GPU memory to CPU memory
 		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
 		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
 	}
 	catch( cl::Error err )
 	{
@@ -411,10 +368,11 @@ Matrix* gpuSpmvCSRVect(const MatrixCSR *m, const Matrix *v, const Matrix *refere
 
 		throw std::runtime_error("Aborting.");
 	}
-#endif
 
 	// REMOVE FOR STUDENTS END
 
+	recordComputeTime(gpuComputeTime);
+
 	// check result, display run time if result is correct
 	bool displayRunTime = true;
 	if( reference )
@@ -0,0 +1,340 @@
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#include<dirent.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+
+#include<omp.h>
+
+#include"tools.h"
+#include"numa_alloc.h"
+
+
+// size of the huge pages used by the transparent and explicit policies
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+
+/**
+  Size really mapped for an array, whole huge pages if they are used.
+*/
+static size_t mappedSize(size_t bytes, HugePagePolicy policy)
+{
+	if( bytes == 0 )
+		bytes = 1;
+	if( policy == HUGE_PAGES_NONE )
+		return bytes;
+	return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+
+/**
+  Allocate a large array with mmap(), without touching it.
+*/
+void* allocLarge(size_t bytes, HugePagePolicy policy)
+{
+	size_t size = mappedSize(bytes, policy);
+	void *p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if( policy == HUGE_PAGES_EXPLICIT )
+	{
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if( p != MAP_FAILED )
+			return p;
+
+		// no huge page reserved in /proc/sys/vm/nr_hugepages, use transparent ones
+		static bool warned = false;
+		if( ! warned )
+			printf("Warning: no explicit huge page available, using transparent huge pages.\n");
+		warned = true;
+	}
+#endif
+
+	if( policy == HUGE_PAGES_NONE )
+	{
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if( p == MAP_FAILED )
+			throw std::runtime_error("Failed to allocate large array.");
+		return p;
+	}
+
+	// map one more huge page and trim, so the array starts on a huge page boundary
+	char *raw = (char*) mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if( raw == MAP_FAILED )
+		throw std::runtime_error("Failed to allocate large array.");
+
+	char *aligned = (char*) (((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+	if( aligned > raw )
+		munmap(raw, aligned - raw);
+	munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+
+#ifdef MADV_HUGEPAGE
+	// only a hint, ignored if transparent huge pages are disabled
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+	return aligned;
+}
+
+
+/**
+  Deallocate an array allocated by allocLarge().
+*/
+void freeLarge(void *p, size_t bytes, HugePagePolicy policy)
+{
+	if( p )
+		munmap(p, mappedSize(bytes, policy));
+}
+
+
+/**
+  Number of NUMA nodes of the host.
+*/
+int numaNodesNbr()
+{
+	static int nodesNbr = 0;
+	if( nodesNbr )
+		return nodesNbr;
+
+	// nodes are listed as /sys/devices/system/node/nodeN
+	int maxNode = -1;
+	DIR *dir = opendir("/sys/devices/system/node");
+	if( dir )
+	{
+		struct dirent *entry;
+		while( (entry = readdir(dir)) )
+		{
+			int node;
+			if( sscanf(entry->d_name, "node%d", &node) == 1 )
+				maxNode = std::max(maxNode, node);
+		}
+		closedir(dir);
+	}
+
+	nodesNbr = std::max(maxNode + 1, 1);
+	return nodesNbr;
+}
+
+
+/**
+  NUMA node of the CPU running the calling thread.
+*/
+int currentNumaNode()
+{
+#ifdef SYS_getcpu
+	unsigned cpu = 0;
+	unsigned node = 0;
+	if( syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && (int) node < numaNodesNbr() )
+		return (int) node;
+#endif
+	return 0;
+}
+
+
+/**
+  Split rows in blocks with the same number of non zero values, one per thread.
+*/
+static void balanceRows(const MatrixCSR *m, int blocksNbr, uint *block_ptr)
+{
+	block_ptr[0] = 0;
+	for(int b = 1; b < blocksNbr; b++)
+	{
+		uint target = (uint) ((double) m->nzNbr * b / blocksNbr);
+		uint r = (uint) (std::lower_bound(m->row_ptr, m->row_ptr + m->h + 1, target) - m->row_ptr);
+		block_ptr[b] = std::max(block_ptr[b-1], std::min(r, m->h));
+	}
+	block_ptr[blocksNbr] = m->h;
+}
+
+
+/**
+  Copy a MatrixCSR in a MatrixCSRNuma.
+*/
+MatrixCSRNuma* csrToNuma(const MatrixCSR *m, HugePagePolicy policy)
+{
+	MatrixCSRNuma *n = (MatrixCSRNuma*) malloc(sizeof(MatrixCSRNuma));
+	if( ! n )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	if( omp_get_proc_bind() == omp_proc_bind_false )
+		printf("Warning: OpenMP threads are not bound to CPUs, set OMP_PROC_BIND=true to keep NUMA placement.\n");
+
+	n->policy = policy;
+	n->threadsNbr = omp_get_max_threads();
+	n->block_ptr = (uint*) malloc((n->threadsNbr + 1) * sizeof(uint));
+	if( ! n->block_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+	balanceRows(m, n->threadsNbr, n->block_ptr);
+
+	MatrixCSR *csr = &n->csr;
+	csr->w = m->w;
+	csr->h = m->h;
+	csr->nzNbr = m->nzNbr;
+	csr->data = (float*) allocLarge((size_t) m->nzNbr * sizeof(float), policy);
+	csr->col_ind = (uint*) allocLarge((size_t) m->nzNbr * sizeof(uint), policy);
+	csr->row_ptr = (uint*) allocLarge((size_t) (m->h + 1) * sizeof(uint), policy);
+
+	// first touch: each thread writes the block it will process, so its pages
+	// are mapped on the thread's node. Blocks are dealt with schedule(static, 1)
+	// rather than indexed by thread number, so that all of them are copied even
+	// if the runtime gives fewer threads than asked, block b then going to the
+	// same thread here and in cpuSpmvCSRNuma()
+	#pragma omp parallel for schedule(static, 1) num_threads(n->threadsNbr)
+	for(int b = 0; b < n->threadsNbr; b++)
+	{
+		uint r0 = n->block_ptr[b];
+		uint r1 = n->block_ptr[b+1];
+
+		memcpy(csr->row_ptr + r0, m->row_ptr + r0, (size_t) (r1 - r0) * sizeof(uint));
+		if( b == n->threadsNbr - 1 )
+			csr->row_ptr[m->h] = m->row_ptr[m->h];
+
+		size_t i0 = m->row_ptr[r0];
+		size_t i1 = m->row_ptr[r1];
+		memcpy(csr->data + i0, m->data + i0, (i1 - i0) * sizeof(float));
+		memcpy(csr->col_ind + i0, m->col_ind + i0, (i1 - i0) * sizeof(uint));
+	}
+
+	return n;
+}
+
+
+/**
+  Destroy a MatrixCSRNuma structure.
+*/
+void deleteMatrixCSRNuma(MatrixCSRNuma **m)
+{
+	if( ! *m )
+		return;
+
+	MatrixCSR *csr = &(*m)->csr;
+	freeLarge(csr->data, (size_t) csr->nzNbr * sizeof(float), (*m)->policy);
+	freeLarge(csr->col_ind, (size_t) csr->nzNbr * sizeof(uint), (*m)->policy);
+	freeLarge(csr->row_ptr, (size_t) (csr->h + 1) * sizeof(uint), (*m)->policy);
+	free((*m)->block_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Replicate a column vector on each NUMA node.
+*/
+ReplicatedVector* replicateVector(const Matrix *v, HugePagePolicy policy)
+{
+	if(v->w != 1)
+		throw std::runtime_error("Failed to replicate vector, vector size mismatch.");
+
+	ReplicatedVector *rv = (ReplicatedVector*) malloc(sizeof(ReplicatedVector));
+	if( ! rv )
+		throw std::runtime_error("Failed to allocate vector.");
+
+	rv->n = v->h;
+	rv->nodesNbr = numaNodesNbr();
+	rv->policy = policy;
+	rv->copies = (float**) malloc(rv->nodesNbr * sizeof(float*));
+	if( ! rv->copies )
+		throw std::runtime_error("Failed to allocate vector.");
+
+	size_t bytes = (size_t) v->h * sizeof(float);
+	std::vector<int> written(rv->nodesNbr, 0);
+	for(int node = 0; node < rv->nodesNbr; node++)
+		rv->copies[node] = (float*) allocLarge(bytes, policy);
+
+	// the first thread running on each node writes the copy of the node
+	#pragma omp parallel
+	{
+		int node = currentNumaNode();
+		int first;
+		#pragma omp atomic capture
+		first = written[node]++;
+
+		if( first == 0 )
+			memcpy(rv->copies[node], v->data, bytes);
+	}
+
+	// nodes without thread (e.g. memory only nodes) still get a valid copy
+	for(int node = 0; node < rv->nodesNbr; node++)
+	{
+		if( ! written[node] )
+			memcpy(rv->copies[node], v->data, bytes);
+	}
+
+	return rv;
+}
+
+
+/**
+  Destroy a ReplicatedVector structure.
+*/
+void deleteReplicatedVector(ReplicatedVector **v)
+{
+	if( ! *v )
+		return;
+
+	for(int node = 0; node < (*v)->nodesNbr; node++)
+		freeLarge((*v)->copies[node], (size_t) (*v)->n * sizeof(float), (*v)->policy);
+	free((*v)->copies);
+	free(*v);
+	*v = NULL;
+}
+
+
+/**
+  Compute MxV on CPU, one row block per thread, x read on the local node.
+*/
+Matrix* cpuSpmvCSRNuma(const MatrixCSRNuma *m, const ReplicatedVector *v, const Matrix *reference)
+{
+	const char *name = "CSR NUMA method on CPU";
+	const MatrixCSR *csr = &m->csr;
+
+	if(csr->w != v->n)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+
+	Matrix *mv = createMatrix(1, csr->h);
+
+	top(0);
+
+	// same threads and same row blocks as the first touch in csrToNuma()
+	#pragma omp parallel num_threads(m->threadsNbr)
+	{
+		const float *x = v->copies[currentNumaNode()];
+
+		#pragma omp for schedule(static, 1)
+		for(int b = 0; b < m->threadsNbr; b++)
+		{
+			for(uint r = m->block_ptr[b]; r < m->block_ptr[b+1]; r++)
+			{
+				float dot = 0.0f;
+				uint row_end = csr->row_ptr[r+1];
+
+				#pragma omp simd reduction(+:dot)
+				for(uint i = csr->row_ptr[r]; i < row_end; i++)
+					dot += csr->data[i] * x[csr->col_ind[i]];
+
+				mv->data[r] = dot;
+			}
+		}
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, csr->w, csr->h, cpuRunTime);
+
+	return mv;
+}
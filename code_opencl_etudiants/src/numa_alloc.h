@@ -0,0 +1,103 @@
+#ifndef __NUMA_ALLOC_H__
+#define __NUMA_ALLOC_H__
+
+#include<cstddef>
+
+#include"common.h"
+
+
+/**
+  Page size used for large arrays.
+*/
+typedef enum hugePagePolicy
+{
+	HUGE_PAGES_NONE,        // default pages
+	HUGE_PAGES_TRANSPARENT, // 2 MB aligned, madvise(MADV_HUGEPAGE)
+	HUGE_PAGES_EXPLICIT     // MAP_HUGETLB, transparent ones if none are reserved
+} HugePagePolicy;
+
+
+/**
+  Allocate a large array with mmap(), without touching it: each page is
+  placed on the NUMA node of the thread that first writes it.
+  Memory must be deallocated by user by calling freeLarge() with the same
+  size and policy.
+*/
+void* allocLarge(size_t bytes, HugePagePolicy policy);
+
+/**
+  Deallocate an array allocated by allocLarge().
+*/
+void freeLarge(void *p, size_t bytes, HugePagePolicy policy);
+
+/**
+  Number of NUMA nodes of the host, 1 if unknown.
+*/
+int numaNodesNbr();
+
+/**
+  NUMA node of the CPU running the calling thread, 0 if unknown.
+*/
+int currentNumaNode();
+
+
+/**
+  CSR matrix whose arrays are placed on the NUMA node of the thread that
+  processes them: rows are split in one block per thread, with the same
+  number of non zero values, and each block is first touched by its thread.
+  Threads must be bound to CPUs (OMP_PROC_BIND=true) for the placement to
+  last.
+*/
+typedef struct matrixCSRNuma
+{
+	MatrixCSR csr; // arrays are allocated by allocLarge()
+	HugePagePolicy policy; // pages of the arrays
+	int threadsNbr; // number of row blocks
+	uint *block_ptr; // first row of each block, threadsNbr+1 values
+} MatrixCSRNuma;
+
+/**
+  Copy a MatrixCSR in a MatrixCSRNuma, each row block being written by the
+  thread that will process it in cpuSpmvCSRNuma().
+  Memory must be deallocated by user by calling deleteMatrixCSRNuma().
+*/
+MatrixCSRNuma* csrToNuma(const MatrixCSR *m, HugePagePolicy policy);
+
+/**
+  Destroy a MatrixCSRNuma structure.
+*/
+void deleteMatrixCSRNuma(MatrixCSRNuma **m);
+
+
+/**
+  One copy of a vector per NUMA node, so that the random reads of x in MxV
+  stay on the local node.
+*/
+typedef struct replicatedVector
+{
+	uint n; // number of values
+	int nodesNbr; // number of copies
+	HugePagePolicy policy; // pages of the copies
+	float **copies; // copy of each node, written by a thread of the node
+} ReplicatedVector;
+
+/**
+  Replicate a column vector on each NUMA node.
+  Memory must be deallocated by user by calling deleteReplicatedVector().
+*/
+ReplicatedVector* replicateVector(const Matrix *v, HugePagePolicy policy);
+
+/**
+  Destroy a ReplicatedVector structure.
+*/
+void deleteReplicatedVector(ReplicatedVector **v);
+
+
+/**
+  Compute MxV on CPU, each thread processing its row block with the copy
+  of x of its NUMA node.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCSRNuma(const MatrixCSRNuma *m, const ReplicatedVector *v, const Matrix *reference = NULL);
+
+#endif
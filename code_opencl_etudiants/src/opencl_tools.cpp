@@ -0,0 +1,186 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<iostream>
+#include<map>
+#include<stdexcept>
+
+
+/**
+  Return the shared OpenCL environment. Init OpenCL on first call.
+*/
+OpenCLEnv& getOpenCLEnv()
+{
+	static OpenCLEnv *env = NULL;
+
+	if( env )
+		return *env;
+
+	// retreive list of available platforms and select the first one
+	std::vector<cl::Platform> platforms;
+	cl::Platform::get(&platforms);
+	if( platforms.size() == 0 )
+		throw std::runtime_error("No OpenCL platform found. Check installation!\n");
+	cl::Platform platform = platforms[0];
+	std::cout << "Using platform: " << platform.getInfo<CL_PLATFORM_NAME>() << "\n";
+
+	// get the first GPU device of the selected platform
+	std::vector<cl::Device> devices;
+	platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
+	cl::Device device = devices[0];
+
+	// display informations on device
+	std::cout << "Using device:\n";
+	std::cout << "  CL_DEVICE_NAME    = " << device.getInfo<CL_DEVICE_NAME>() << "\n";
+	std::cout << "  CL_DEVICE_VENDOR  = " << device.getInfo<CL_DEVICE_VENDOR>() << "\n";
+	std::cout << "  CL_DEVICE_VERSION = " << device.getInfo<CL_DEVICE_VERSION>() << "\n";
+	std::cout << "  CL_DRIVER_VERSION = " << device.getInfo<CL_DRIVER_VERSION>() << "\n";
+
+	env = new OpenCLEnv;
+	env->device = device;
+
+	// create a context with the GPU device
+	env->context = cl::Context(devices);
+
+	// create command queue using the context and device
+	env->queue = cl::CommandQueue(env->context, device);
+
+	// init ok
+	printf("Compute device successfully initialized.\n");
+
+	return *env;
+}
+
+
+/**
+  Build a program from kernel source code, with optional build options.
+*/
+cl::Program buildProgram(const std::string &source, const std::string &options)
+{
+	static std::map<std::string, cl::Program> cache;
+
+	std::string key = options + '\n' + source;
+	std::map<std::string, cl::Program>::iterator it = cache.find(key);
+	if( it != cache.end() )
+		return it->second;
+
+	OpenCLEnv &env = getOpenCLEnv();
+
+	// create a program from the kernel source code
+	cl::Program::Sources sources;
+	sources.push_back(std::make_pair(source.c_str(), source.length()));
+	cl::Program program(env.context, sources);
+
+	// compile program
+	std::vector<cl::Device> devices(1, env.device);
+	try
+	{
+		program.build(devices, options.c_str());
+	}
+	catch( cl::Error err )
+	{
+		// display build log
+		std::cout << "Program build log:\n";
+		std::cout << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(env.device) << "\n";
+
+		throw; // propagate exception
+	}
+
+	cache[key] = program;
+
+	return program;
+}
+
+
+// device buffer pool state, buffers are keyed by size class and flags
+typedef std::pair<size_t, cl_mem_flags> BufferKey;
+static std::multimap<BufferKey, cl::Buffer> freeBuffers;
+static PoolStats deviceStats = {0, 0, 0, 0, 0};
+
+
+/**
+  Get a buffer from the device buffer pool.
+*/
+cl::Buffer acquireBuffer(cl_mem_flags flags, size_t bytes)
+{
+	BufferKey key(poolSizeClass(bytes), flags);
+	deviceStats.requests++;
+	deviceStats.inUse += key.first;
+
+	std::multimap<BufferKey, cl::Buffer>::iterator it = freeBuffers.find(key);
+	if( it != freeBuffers.end() )
+	{
+		deviceStats.hits++;
+		cl::Buffer buffer = it->second;
+		freeBuffers.erase(it);
+		return buffer;
+	}
+
+	deviceStats.footprint += key.first;
+	if( deviceStats.footprint > deviceStats.peakFootprint )
+		deviceStats.peakFootprint = deviceStats.footprint;
+
+	return cl::Buffer(getOpenCLEnv().context, flags, key.first);
+}
+
+
+/**
+  Give back a buffer to the device buffer pool.
+*/
+void releaseBuffer(const cl::Buffer &buffer)
+{
+	// the size of pooled buffers is their size class
+	BufferKey key(buffer.getInfo<CL_MEM_SIZE>(), buffer.getInfo<CL_MEM_FLAGS>());
+	deviceStats.inUse -= key.first;
+	freeBuffers.insert(std::make_pair(key, buffer));
+}
+
+
+/**
+  Statistics of the device buffer pool.
+*/
+PoolStats getDevicePoolStats()
+{
+	return deviceStats;
+}
+
+
+/**
+  Display an OpenCL error on stderr, with details for build errors.
+*/
+void printOpenCLError(const cl::Error &err)
+{
+	std::cerr
+		<< "ERROR: "
+		<< err.what()
+		<< "("
+		<< err.err()
+		<< ")"
+		<< std::endl;
+
+	if( err.what() == std::string("clBuildProgram") )
+	{
+		const char* error_type = "unknown";
+
+		if( err.err() == CL_INVALID_PROGRAM )
+			error_type = "CL_INVALID_PROGRAM";
+		else if( err.err() == CL_INVALID_VALUE )
+			error_type = "CL_INVALID_VALUE";
+		else if( err.err() == CL_INVALID_DEVICE )
+			error_type = "CL_INVALID_DEVICE";
+		else if( err.err() == CL_INVALID_BINARY )
+			error_type = "CL_INVALID_BINARY";
+		else if( err.err() == CL_INVALID_BUILD_OPTIONS )
+			error_type = "CL_INVALID_BUILD_OPTIONS";
+		else if( err.err() == CL_INVALID_OPERATION )
+			error_type = "CL_INVALID_OPERATION";
+		else if( err.err() ==  CL_COMPILER_NOT_AVAILABLE )
+			error_type = "CL_COMPILER_NOT_AVAILABLE";
+		else if( err.err() == CL_BUILD_PROGRAM_FAILURE )
+			error_type = "CL_BUILD_PROGRAM_FAILURE";
+		else if( err.err() == CL_OUT_OF_HOST_MEMORY )
+			error_type = "CL_OUT_OF_HOST_MEMORY";
+
+		printf( "Program build error: %s.\n", error_type);
+	}
+}
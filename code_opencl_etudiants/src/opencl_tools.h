@@ -0,0 +1,90 @@
+#ifndef __OPENCL_TOOLS_H__
+#define __OPENCL_TOOLS_H__
+
+#define __CL_ENABLE_EXCEPTIONS
+#include"cl.hpp"
+
+#include<string>
+
+#include"memory_pool.h"
+
+
+/**
+  OpenCL objects shared by GPU methods.
+  Initialized once, on the first GPU device of the first platform.
+*/
+typedef struct openCLEnv
+{
+	cl::Context context;
+	cl::Device device;
+	cl::CommandQueue queue;
+} OpenCLEnv;
+
+
+/**
+  Return the shared OpenCL environment. Init OpenCL on first call.
+*/
+OpenCLEnv& getOpenCLEnv();
+
+
+/**
+  Build a program from kernel source code, with optional build options
+  (ie "-D WG_SIZE=256"). Built programs are cached, so building the same
+  source with the same options twice does not recompile it.
+*/
+cl::Program buildProgram(const std::string &source, const std::string &options = "");
+
+
+/**
+  Kernel source of helpers shared by programs, to be put at the start of
+  their source (string literals are concatenated):
+  - atomicAddFloat(addr, val), since OpenCL 1.1 has no atomic add on float,
+  - kernelZero(n, y), which clears y before values are added to it.
+*/
+#define KERNEL_ATOMICS_SOURCE \
+	"// OpenCL 1.1 has no atomic add on float, emulate it with compare and swap\n" \
+	"void atomicAddFloat(volatile __global float *addr, float val)\n" \
+	"{\n" \
+	"	union { uint u; float f; } prev, next;\n" \
+	"	do\n" \
+	"	{\n" \
+	"		prev.f = *addr;\n" \
+	"		next.f = prev.f + val;\n" \
+	"	}\n" \
+	"	while( atomic_cmpxchg((volatile __global uint *) addr, prev.u, next.u) != prev.u );\n" \
+	"}\n" \
+	"\n" \
+	"__kernel void kernelZero(uint n, __global float *y)\n" \
+	"{\n" \
+	"	uint i = get_global_id(0);\n" \
+	"	if( i < n )\n" \
+	"		y[i] = 0.0f;\n" \
+	"}\n" \
+	"\n"
+
+
+/**
+  Get a buffer of at least 'bytes' bytes from the device buffer pool. Buffers
+  given back by releaseBuffer() are kept by size class and flags, and reused
+  instead of creating new ones. Buffer content is undefined.
+*/
+cl::Buffer acquireBuffer(cl_mem_flags flags, size_t bytes);
+
+/**
+  Give back a buffer obtained by acquireBuffer() to the device buffer pool.
+  Commands using it must be completed.
+*/
+void releaseBuffer(const cl::Buffer &buffer);
+
+/**
+  Statistics of the device buffer pool.
+*/
+PoolStats getDevicePoolStats();
+
+
+/**
+  Display an OpenCL error on stderr, with details for build errors.
+*/
+void printOpenCLError(const cl::Error &err);
+
+#endif
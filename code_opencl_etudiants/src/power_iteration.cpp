@@ -0,0 +1,78 @@
+#include<cmath>
+#include<cstring>
+#include<stdexcept>
+
+#include"tools.h"
+#include"power_iteration.h"
+
+
+/**
+  Power iteration (or PageRank) on CPU.
+*/
+Matrix* cpuPowerIteration(const MatrixCSR *m, float damping, float tolerance, uint maxIter, const Matrix *reference)
+{
+	const char *name = (damping < 1.0f) ? "PageRank on cpu" : "Power iteration on cpu";
+
+	if(m->w != m->h)
+		throw std::runtime_error("Failed to run power iteration, matrix is not square.");
+
+	uint n = m->h;
+	bool normL2 = (damping >= 1.0f);
+	float teleport = (1.0f - damping) / n;
+
+	Matrix *x = createMatrix(1, n);
+	Matrix *y = createMatrix(1, n);
+
+	top(0);
+
+	// uniform initial vector
+	float x0 = normL2 ? 1.0f / sqrtf((float) n) : 1.0f / n;
+	for(uint r = 0; r < n; r++)
+		x->data[r] = x0;
+
+	uint iter = 0;
+	float diff = tolerance;
+	while( iter < maxIter && diff >= tolerance )
+	{
+		// y = damping.M.x + teleport
+		double norm = 0.0;
+		for(uint r = 0; r < n; r++)
+		{
+			float dot = 0.0f;
+			for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+				dot += m->data[i] * x->data[m->col_ind[i]];
+
+			float yr = damping * dot + teleport;
+			y->data[r] = yr;
+			norm += normL2 ? yr * yr : fabsf(yr);
+		}
+
+		// x = y / ||y||, convergence check
+		float scale = (float) (1.0 / (normL2 ? sqrt(norm) : norm));
+		diff = 0.0f;
+		for(uint r = 0; r < n; r++)
+		{
+			float xr = y->data[r] * scale;
+			diff += fabsf(xr - x->data[r]);
+			x->data[r] = xr;
+		}
+
+		iter++;
+	}
+	double cpuRunTime = top(0);
+
+	deleteMatrix(&y);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, x))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d) converged to %g in %d iterations, computed in %f ms.\n", name, m->w, m->h, diff, iter, cpuRunTime);
+
+	return x;
+}
@@ -0,0 +1,27 @@
+#ifndef __POWER_ITERATION_H__
+#define __POWER_ITERATION_H__
+
+#include"common.h"
+
+
+/**
+  Power iteration on a square CSR matrix.
+  With damping == 1, computes the dominant eigenvector of M:
+    x = M.x / ||M.x||_2
+  With damping < 1, computes the PageRank vector of the column-stochastic
+  matrix M:
+    x = damping.M.x + (1-damping)/n, normalized with ||x||_1
+  Iterations stop when ||x(k) - x(k-1)||_1 < tolerance, or after maxIter
+  iterations. Result is a column vector of size M->h.
+*/
+Matrix* cpuPowerIteration(const MatrixCSR *m, float damping, float tolerance, uint maxIter, const Matrix *reference = NULL);
+
+/**
+  Same as cpuPowerIteration(), entirely on GPU.
+  Normalization and damping are fused into the SpMV kernel, and convergence
+  is checked on GPU, so the host only reads the convergence status every
+  checkInterval iterations.
+*/
+Matrix* gpuPowerIteration(const MatrixCSR *m, float damping, float tolerance, uint maxIter, const Matrix *reference = NULL, uint checkInterval = 16);
+
+#endif
@@ -0,0 +1,299 @@
+#include"opencl_tools.h"
+
+#include<cmath>
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+#include<vector>
+
+#include"tools.h"
+#include"power_iteration.h"
+
+
+//---------------------------------------------------------
+
+/**
+  One power iteration step, y = damping.M.x(k) + teleport.
+  Vectors are stored unnormalized, x(k) = scales[k&1] * x, so normalization
+  costs nothing more than a multiplication in the SpMV epilogue.
+  y holds the previous vector x(k-1) = scales[(k+1)&1] * y on entry, which
+  is used to compute ||x(k) - x(k-1)||_1 on the fly before it is overwritten.
+  Each work group writes its partial norm of y and partial diff in partials.
+*/
+std::string kernelPowerSpmv_source =
+	"__kernel void kernelPowerSpmv(uint rowsNbr, uint k, float damping, float teleport,\n"
+	"	const __global float *values, const __global uint *col_ind, const __global uint *row_ptr,\n"
+	"	const __global float *x, __global float *y, const __global float *scales,\n"
+	"	const __global uint *status, __global float *partials)\n"
+	"{\n"
+	"	__local float normPart[WG_SIZE];\n"
+	"	__local float diffPart[WG_SIZE];\n"
+	"\n"
+	"	// nothing more to do once converged\n"
+	"	if( status[0] )\n"
+	"		return;\n"
+	"\n"
+	"	uint r = get_global_id(0);\n"
+	"	uint l = get_local_id(0);\n"
+	"	float scaleX = scales[k & 1];\n"
+	"	float scaleY = scales[(k+1) & 1];\n"
+	"	float yr = 0.0f;\n"
+	"	float diff = 0.0f;\n"
+	"\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_beg = row_ptr[r];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_beg; i < row_end; i++)\n"
+	"			dot += values[i] * x[col_ind[i]];\n"
+	"\n"
+	"		// fused epilogue: normalization of x(k), damping, teleportation\n"
+	"		yr = damping * scaleX * dot + teleport;\n"
+	"		diff = fabs(scaleX * x[r] - scaleY * y[r]);\n"
+	"		y[r] = yr;\n"
+	"	}\n"
+	"\n"
+	"#ifdef NORM_L2\n"
+	"	normPart[l] = yr * yr;\n"
+	"#else\n"
+	"	normPart[l] = fabs(yr);\n"
+	"#endif\n"
+	"	diffPart[l] = diff;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	// parallel reduction in local memory\n"
+	"	for(uint s = WG_SIZE/2; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( l < s )\n"
+	"		{\n"
+	"			normPart[l] += normPart[l + s];\n"
+	"			diffPart[l] += diffPart[l + s];\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( l == 0 )\n"
+	"	{\n"
+	"		partials[2*get_group_id(0)] = normPart[0];\n"
+	"		partials[2*get_group_id(0) + 1] = diffPart[0];\n"
+	"	}\n"
+	"}\n"
+	"\n"
+	"\n"
+	"/**\n"
+	"  Reduce the partial norms and diffs of step k, run by a single work group.\n"
+	"  Stores the scale of x(k+1), or marks the iteration as converged on x(k).\n"
+	"  status[0] is the converged flag, status[1] the index of the result vector.\n"
+	"  scales[2] receives ||x(k) - x(k-1)||_1.\n"
+	"*/\n"
+	"__kernel void kernelPowerReduce(uint groupsNbr, uint k, float tolerance,\n"
+	"	const __global float *partials, __global float *scales, __global uint *status)\n"
+	"{\n"
+	"	__local float normPart[WG_SIZE];\n"
+	"	__local float diffPart[WG_SIZE];\n"
+	"\n"
+	"	if( status[0] )\n"
+	"		return;\n"
+	"\n"
+	"	uint l = get_local_id(0);\n"
+	"	float norm = 0.0f;\n"
+	"	float diff = 0.0f;\n"
+	"	for(uint g = l; g < groupsNbr; g += WG_SIZE)\n"
+	"	{\n"
+	"		norm += partials[2*g];\n"
+	"		diff += partials[2*g + 1];\n"
+	"	}\n"
+	"	normPart[l] = norm;\n"
+	"	diffPart[l] = diff;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	for(uint s = WG_SIZE/2; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( l < s )\n"
+	"		{\n"
+	"			normPart[l] += normPart[l + s];\n"
+	"			diffPart[l] += diffPart[l + s];\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( l == 0 )\n"
+	"	{\n"
+	"		// x(-1) does not exist, so step 0 can not converge\n"
+	"		if( k > 0 && diffPart[0] < tolerance )\n"
+	"		{\n"
+	"			status[0] = 1;\n"
+	"			status[1] = k;\n"
+	"			scales[2] = diffPart[0];\n"
+	"		}\n"
+	"		else\n"
+	"		{\n"
+	"#ifdef NORM_L2\n"
+	"			scales[(k+1) & 1] = 1.0f / sqrt(normPart[0]);\n"
+	"#else\n"
+	"			scales[(k+1) & 1] = 1.0f / normPart[0];\n"
+	"#endif\n"
+	"			status[1] = k + 1;\n"
+	"			scales[2] = diffPart[0];\n"
+	"		}\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Power iteration (or PageRank) on GPU.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuPowerIteration(const MatrixCSR *m, float damping, float tolerance, uint maxIter, const Matrix *reference, uint checkInterval)
+{
+	const char *name = (damping < 1.0f) ? "PageRank on GPU" : "Power iteration on GPU";
+
+	if(m->w != m->h)
+		throw std::runtime_error("Failed to run power iteration, matrix is not square.");
+	if(checkInterval == 0)
+		checkInterval = 1;
+
+	uint n = m->h;
+	bool normL2 = (damping >= 1.0f);
+	float teleport = (1.0f - damping) / n;
+	Matrix *x = createMatrix(1, n);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+	uint iter = 0;
+	float diff = 0.0f;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		// compile kernels
+		const uint wgSize = 256;
+		std::ostringstream options;
+		options << "-D WG_SIZE=" << wgSize;
+		if( normL2 )
+			options << " -D NORM_L2";
+		cl::Program program = buildProgram(kernelPowerSpmv_source, options.str());
+		cl::Kernel spmv(program, "kernelPowerSpmv");
+		cl::Kernel reduce(program, "kernelPowerReduce");
+
+		uint groupsNbr = (n + wgSize - 1) / wgSize;
+
+		// allocate global memory on GPU
+		size_t valuesSizeInBytes = (size_t) m->nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) m->nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t xSizeInBytes = (size_t) n * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuX[2] = {
+			acquireBuffer(CL_MEM_READ_WRITE, xSizeInBytes),
+			acquireBuffer(CL_MEM_READ_WRITE, xSizeInBytes) };
+		cl::Buffer gpuScales = acquireBuffer(CL_MEM_READ_WRITE, 3 * sizeof(float));
+		cl::Buffer gpuStatus = acquireBuffer(CL_MEM_READ_WRITE, 2 * sizeof(uint));
+		cl::Buffer gpuPartials = acquireBuffer(CL_MEM_READ_WRITE, 2 * groupsNbr * sizeof(float));
+
+		// x(0) is uniform, x(-1) is null
+		std::vector<float> x0(n, 1.0f);
+		std::vector<float> xm1(n, 0.0f);
+		float scales[3] = { normL2 ? 1.0f / sqrtf((float) n) : 1.0f / n, 0.0f, 0.0f };
+		uint status[2] = { 0, 0 };
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, valuesSizeInBytes, m->data);
+		queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, col_indSizeInBytes, m->col_ind);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuX[0], CL_TRUE, 0, xSizeInBytes, &x0[0]);
+		queue.enqueueWriteBuffer(gpuX[1], CL_TRUE, 0, xSizeInBytes, &xm1[0]);
+		queue.enqueueWriteBuffer(gpuScales, CL_TRUE, 0, sizeof(scales), scales);
+		queue.enqueueWriteBuffer(gpuStatus, CL_TRUE, 0, sizeof(status), status);
+
+		// set the arguments that do not change between iterations
+		spmv.setArg(0, n);
+		spmv.setArg(2, damping);
+		spmv.setArg(3, teleport);
+		spmv.setArg(4, gpuValues);
+		spmv.setArg(5, gpuCol_ind);
+		spmv.setArg(6, gpuRow_ptr);
+		spmv.setArg(9, gpuScales);
+		spmv.setArg(10, gpuStatus);
+		spmv.setArg(11, gpuPartials);
+		reduce.setArg(0, groupsNbr);
+		reduce.setArg(2, tolerance);
+		reduce.setArg(3, gpuPartials);
+		reduce.setArg(4, gpuScales);
+		reduce.setArg(5, gpuStatus);
+
+		// run kernels, the host only waits for the GPU every checkInterval iterations
+		top(1);
+		for(uint k = 0; k < maxIter; k++)
+		{
+			spmv.setArg(1, k);
+			spmv.setArg(7, gpuX[k & 1]);
+			spmv.setArg(8, gpuX[(k+1) & 1]);
+			queue.enqueueNDRangeKernel(spmv, cl::NullRange, cl::NDRange(groupsNbr * wgSize), cl::NDRange(wgSize));
+
+			reduce.setArg(1, k);
+			queue.enqueueNDRangeKernel(reduce, cl::NullRange, cl::NDRange(wgSize), cl::NDRange(wgSize));
+
+			if( (k + 1) % checkInterval == 0 )
+			{
+				queue.enqueueReadBuffer(gpuStatus, CL_TRUE, 0, sizeof(status), status);
+				if( status[0] )
+					break;
+			}
+		}
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuStatus, CL_TRUE, 0, sizeof(status), status);
+		queue.enqueueReadBuffer(gpuScales, CL_TRUE, 0, sizeof(scales), scales);
+		iter = status[1];
+		diff = scales[2];
+		queue.enqueueReadBuffer(gpuX[iter & 1], CL_TRUE, 0, xSizeInBytes, x->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuX[0]);
+		releaseBuffer(gpuX[1]);
+		releaseBuffer(gpuScales);
+		releaseBuffer(gpuStatus);
+		releaseBuffer(gpuPartials);
+
+		// result vector is stored unnormalized
+		for(uint r = 0; r < n; r++)
+			x->data[r] *= scales[iter & 1];
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, x))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d) converged to %g in %d iterations, computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, diff, iter, gpuRunTime, gpuComputeTime);
+
+	return x;
+}
@@ -0,0 +1,394 @@
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+
+#include"csr_tools.h"
+#include"reordering.h"
+
+
+/**
+  Name of a method.
+*/
+const char* reorderMethodName(ReorderMethod method)
+{
+	switch( method )
+	{
+		case REORDER_RCM: return "RCM";
+		case REORDER_DEGREE: return "degree";
+		case REORDER_CLUSTER: return "cluster";
+		default: return "unknown";
+	}
+}
+
+
+/**
+  Adjacency graph of A + At, without the diagonal. Neighbors are sorted.
+*/
+static MatrixCSR* symmetricGraph(const MatrixCSR *m)
+{
+	MatrixCSR *t = transposeCSR(m);
+	std::vector<uint> len(m->h);
+
+	// 2 passes: count the union of the rows of A and At, then fill it
+	MatrixCSR *g = NULL;
+	for(int pass = 0; pass < 2; pass++)
+	{
+		#pragma omp parallel for schedule(dynamic, 64)
+		for(long r = 0; r < (long) m->h; r++)
+		{
+			uint i = m->row_ptr[r], iEnd = m->row_ptr[r+1];
+			uint j = t->row_ptr[r], jEnd = t->row_ptr[r+1];
+			uint k = pass ? g->row_ptr[r] : 0;
+			uint count = 0;
+
+			// merge of 2 sorted lists
+			while( i < iEnd || j < jEnd )
+			{
+				uint c;
+				if( j >= jEnd || (i < iEnd && m->col_ind[i] < t->col_ind[j]) )
+					c = m->col_ind[i++];
+				else if( i >= iEnd || t->col_ind[j] < m->col_ind[i] )
+					c = t->col_ind[j++];
+				else
+				{
+					c = m->col_ind[i++];
+					j++;
+				}
+
+				if( c == (uint) r )
+					continue;
+				if( pass )
+					g->col_ind[k + count] = c;
+				count++;
+			}
+			len[r] = count;
+		}
+
+		if( pass == 0 )
+		{
+			uint nzNbr = 0;
+			for(uint r = 0; r < m->h; r++)
+				nzNbr += len[r];
+			g = createMatrixCSR(m->w, m->h, nzNbr);
+			g->row_ptr[0] = 0;
+			for(uint r = 0; r < m->h; r++)
+				g->row_ptr[r+1] = g->row_ptr[r] + len[r];
+		}
+	}
+
+	deleteMatrixCSR(&t);
+	return g;
+}
+
+
+/**
+  Breadth first search from a node, neighbors visited by increasing degree.
+  Visited nodes are appended to order, and marked. Stops after maxNodes
+  nodes. Returns the last level of the search.
+*/
+static uint bfs(const MatrixCSR *g, uint start, std::vector<char> &visited, std::vector<uint> &order, uint maxNodes,
+	std::vector<uint> *lastLevel = NULL)
+{
+	size_t first = order.size();
+	order.push_back(start);
+	visited[start] = 1;
+
+	std::vector< std::pair<uint, uint> > neighbors;
+	size_t levelBeg = first;
+	size_t levelEnd = order.size();
+	size_t lastLevelBeg = first;
+	uint levels = 0;
+	while( levelBeg < levelEnd && order.size() - first < maxNodes )
+	{
+		for(size_t q = levelBeg; q < levelEnd && order.size() - first < maxNodes; q++)
+		{
+			uint u = order[q];
+			neighbors.clear();
+			for(uint i = g->row_ptr[u]; i < g->row_ptr[u+1]; i++)
+			{
+				uint w = g->col_ind[i];
+				if( ! visited[w] )
+				{
+					visited[w] = 1;
+					neighbors.push_back(std::make_pair(g->row_ptr[w+1] - g->row_ptr[w], w));
+				}
+			}
+			std::sort(neighbors.begin(), neighbors.end());
+
+			for(size_t k = 0; k < neighbors.size(); k++)
+			{
+				if( order.size() - first < maxNodes )
+					order.push_back(neighbors[k].second);
+				else
+					visited[neighbors[k].second] = 0; // cluster full, left for the next one
+			}
+		}
+
+		levelBeg = levelEnd;
+		levelEnd = order.size();
+		if( levelBeg < levelEnd )
+		{
+			lastLevelBeg = levelBeg;
+			levels++;
+		}
+	}
+
+	if( lastLevel )
+		lastLevel->assign(order.begin() + lastLevelBeg, order.end());
+	return levels;
+}
+
+
+/**
+  Pseudo peripheral node of the component of a node (George-Liu): nodes at
+  the end of the longest breadth first search, so that levels are narrow.
+*/
+static uint peripheralNode(const MatrixCSR *g, uint start, std::vector<char> &visited)
+{
+	std::vector<uint> order;
+	std::vector<uint> lastLevel;
+	uint levels = 0;
+
+	for(int iter = 0; iter < 8; iter++)
+	{
+		order.clear();
+		uint l = bfs(g, start, visited, order, (uint) -1, &lastLevel);
+		for(size_t i = 0; i < order.size(); i++)
+			visited[order[i]] = 0;
+
+		if( iter > 0 && l <= levels )
+			break;
+		levels = l;
+
+		// node of min degree of the last level
+		uint next = lastLevel.empty() ? start : lastLevel[0];
+		for(size_t i = 1; i < lastLevel.size(); i++)
+		{
+			uint u = lastLevel[i];
+			if( g->row_ptr[u+1] - g->row_ptr[u] < g->row_ptr[next+1] - g->row_ptr[next] )
+				next = u;
+		}
+		if( next == start )
+			break;
+		start = next;
+	}
+
+	return start;
+}
+
+
+/**
+  Compute a symmetric ordering of a square matrix.
+*/
+uint* computeOrdering(const MatrixCSR *m, ReorderMethod method)
+{
+	if( m->w != m->h )
+		throw std::runtime_error("Failed to reorder matrix, it is not square.");
+
+	uint n = m->h;
+	uint *perm = (uint*) malloc((size_t) n * sizeof(uint));
+	if( ! perm )
+		throw std::runtime_error("Failed to allocate permutation.");
+
+	if( method == REORDER_DEGREE )
+	{
+		// decreasing degree, rows of same degree keep their order
+		std::vector< std::pair<uint, uint> > rows(n);
+		#pragma omp parallel for
+		for(long r = 0; r < (long) n; r++)
+			rows[r] = std::make_pair(~(m->row_ptr[r+1] - m->row_ptr[r]), (uint) r);
+		std::sort(rows.begin(), rows.end());
+
+		for(uint i = 0; i < n; i++)
+			perm[i] = rows[i].second;
+		return perm;
+	}
+
+	MatrixCSR *g = symmetricGraph(m);
+
+	// nodes by increasing degree, to start each component from a low degree node
+	std::vector< std::pair<uint, uint> > nodes(n);
+	for(uint u = 0; u < n; u++)
+		nodes[u] = std::make_pair(g->row_ptr[u+1] - g->row_ptr[u], u);
+	std::stable_sort(nodes.begin(), nodes.end());
+
+	std::vector<char> visited(n, 0);
+	std::vector<uint> order;
+	order.reserve(n);
+
+	if( method == REORDER_RCM )
+	{
+		for(uint k = 0; k < n; k++)
+		{
+			uint u = nodes[k].second;
+			if( visited[u] )
+				continue;
+			bfs(g, peripheralNode(g, u, visited), visited, order, (uint) -1);
+		}
+		std::reverse(order.begin(), order.end());
+	}
+	else if( method == REORDER_CLUSTER )
+	{
+		// clusters are grown one after the other, from the first node left
+		// in the original order, so that clusters of a same region are close
+		for(uint u = 0; u < n; u++)
+		{
+			if( ! visited[u] )
+				bfs(g, u, visited, order, REORDER_CLUSTER_SIZE);
+		}
+	}
+	else
+	{
+		deleteMatrixCSR(&g);
+		free(perm);
+		throw std::runtime_error("Unknown reordering method.");
+	}
+
+	std::copy(order.begin(), order.end(), perm);
+	deleteMatrixCSR(&g);
+	return perm;
+}
+
+
+/**
+  Compute P.M.Pt.
+*/
+MatrixCSR* permuteCSR(const MatrixCSR *m, const uint *perm)
+{
+	uint n = m->h;
+	std::vector<uint> inv(n);
+	#pragma omp parallel for
+	for(long i = 0; i < (long) n; i++)
+		inv[perm[i]] = (uint) i;
+
+	MatrixCSR *p = createMatrixCSR(m->w, m->h, m->nzNbr);
+	p->row_ptr[0] = 0;
+	for(uint i = 0; i < n; i++)
+		p->row_ptr[i+1] = p->row_ptr[i] + (m->row_ptr[perm[i]+1] - m->row_ptr[perm[i]]);
+
+	#pragma omp parallel
+	{
+		std::vector< std::pair<uint, float> > tmp;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long i = 0; i < (long) n; i++)
+		{
+			uint r = perm[i];
+			tmp.clear();
+			for(uint k = m->row_ptr[r]; k < m->row_ptr[r+1]; k++)
+				tmp.push_back(std::make_pair(inv[m->col_ind[k]], m->data[k]));
+			std::sort(tmp.begin(), tmp.end());
+
+			uint beg = p->row_ptr[i];
+			for(size_t k = 0; k < tmp.size(); k++)
+			{
+				p->col_ind[beg + k] = tmp[k].first;
+				p->data[beg + k] = tmp[k].second;
+			}
+		}
+	}
+
+	return p;
+}
+
+
+/**
+  Bandwidth of a matrix.
+*/
+uint bandwidthCSR(const MatrixCSR *m)
+{
+	uint bandwidth = 0;
+
+	#pragma omp parallel for schedule(dynamic, 64) reduction(max:bandwidth)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			uint c = m->col_ind[i];
+			uint d = (c > (uint) r) ? c - (uint) r : (uint) r - c;
+			bandwidth = std::max(bandwidth, d);
+		}
+	}
+
+	return bandwidth;
+}
+
+
+/**
+  px = P.x
+*/
+void permuteVector(uint n, const uint *perm, const float *x, float *px)
+{
+	#pragma omp parallel for
+	for(long i = 0; i < (long) n; i++)
+		px[i] = x[perm[i]];
+}
+
+
+/**
+  x = Pt.px
+*/
+void unpermuteVector(uint n, const uint *perm, const float *px, float *x)
+{
+	#pragma omp parallel for
+	for(long i = 0; i < (long) n; i++)
+		x[perm[i]] = px[i];
+}
+
+
+/**
+  Reorder a square matrix.
+*/
+ReorderedCSR* reorderCSR(const MatrixCSR *m, ReorderMethod method)
+{
+	ReorderedCSR *r = (ReorderedCSR*) malloc(sizeof(ReorderedCSR));
+	if( ! r )
+		throw std::runtime_error("Failed to allocate reordered matrix.");
+
+	std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+	r->method = method;
+	r->perm = computeOrdering(m, method);
+	r->m = permuteCSR(m, r->perm);
+	r->reorderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+
+	return r;
+}
+
+
+/**
+  Destroy a ReorderedCSR structure.
+*/
+void deleteReorderedCSR(ReorderedCSR **r)
+{
+	if( ! *r )
+		return;
+
+	deleteMatrixCSR(&(*r)->m);
+	free((*r)->perm);
+	free(*r);
+	*r = NULL;
+}
+
+
+/**
+  Display the bandwidth before and after reordering.
+*/
+void printReorderReport(const MatrixCSR *m, const ReorderedCSR *r)
+{
+	printf("%s reordering: bandwidth %u -> %u, computed in %f ms.\n", reorderMethodName(r->method),
+		bandwidthCSR(m), bandwidthCSR(r->m), r->reorderTime);
+}
+
+
+/**
+  Display the speedup of a MxV method brought by a reordering.
+*/
+void printReorderSpeedup(const ReorderedCSR *r, const char *name, double time, double reorderedTime)
+{
+	printf("%s reordering: %s in %f ms -> %f ms, speedup %f.\n", reorderMethodName(r->method), name,
+		time, reorderedTime, (reorderedTime > 0.0) ? time / reorderedTime : 0.0);
+}
@@ -0,0 +1,138 @@
+#ifndef __REORDERING_H__
+#define __REORDERING_H__
+
+#include"common.h"
+#include"benchmark.h"
+#include"matrix_types.h"
+
+
+/**
+  Symmetric reorderings of square matrices: rows and columns are permuted
+  the same way, so that values get closer to the diagonal and the x values
+  read by consecutive rows stay in cache.
+*/
+typedef enum reorderMethod
+{
+	REORDER_RCM,     // reverse Cuthill-McKee, reduces the bandwidth
+	REORDER_DEGREE,  // rows by decreasing number of values, groups hubs of power law graphs
+	REORDER_CLUSTER, // clusters of REORDER_CLUSTER_SIZE connected rows, grown by breadth first search
+	REORDER_METHODS_NBR
+} ReorderMethod;
+
+/**
+  Rows of a cluster of the REORDER_CLUSTER method, their x values stay in L1.
+*/
+#define REORDER_CLUSTER_SIZE 1024
+
+/**
+  Name of a method, for display.
+*/
+const char* reorderMethodName(ReorderMethod method);
+
+
+/**
+  Compute a symmetric ordering of a square matrix, of the graph of A + At
+  if A isn't symmetric. perm[i] is the old index of new row i.
+  Memory must be deallocated by user by calling free().
+*/
+uint* computeOrdering(const MatrixCSR *m, ReorderMethod method);
+
+/**
+  Compute P.M.Pt: row i of the result is row perm[i] of m, and columns are
+  renumbered the same way. Column indices are sorted in each row.
+  Memory must be deallocated by user by calling deleteMatrixCSR().
+*/
+MatrixCSR* permuteCSR(const MatrixCSR *m, const uint *perm);
+
+/**
+  Bandwidth of a matrix, max |r - c| of its non zero values.
+*/
+uint bandwidthCSR(const MatrixCSR *m);
+
+/**
+  px = P.x, ie px[i] = x[perm[i]], and x = Pt.px, the inverse.
+*/
+void permuteVector(uint n, const uint *perm, const float *x, float *px);
+void unpermuteVector(uint n, const uint *perm, const float *px, float *x);
+
+
+/**
+  Matrix reordered once, and the permutation to apply to x and y.
+*/
+typedef struct reorderedCSR
+{
+	MatrixCSR *m; // P.M.Pt
+	uint *perm; // permutation
+	ReorderMethod method;
+	double reorderTime; // time to compute and apply the permutation, in ms
+} ReorderedCSR;
+
+/**
+  Reorder a square matrix.
+  Memory must be deallocated by user by calling deleteReorderedCSR().
+*/
+ReorderedCSR* reorderCSR(const MatrixCSR *m, ReorderMethod method);
+
+/**
+  Destroy a ReorderedCSR structure.
+*/
+void deleteReorderedCSR(ReorderedCSR **r);
+
+/**
+  Display the bandwidth before and after reordering, and the time it took.
+*/
+void printReorderReport(const MatrixCSR *m, const ReorderedCSR *r);
+
+/**
+  Display the time of a MxV method on the original and on the reordered
+  matrix, and the speedup brought by the reordering.
+*/
+void printReorderSpeedup(const ReorderedCSR *r, const char *name, double time, double reorderedTime);
+
+
+/**
+  Compute MxV with any MxV method on the reordered matrix, x and y being in
+  the order of the original matrix: x is permuted, P.M.Pt is multiplied by
+  P.x, and the result is permuted back. The output of the method is
+  silenced, its run time is displayed under its name followed by the
+  reordering, and returned in *spmvTime if not NULL: the time of the MxV on
+  P.M.Pt, as timeSpmv() measures it, permutations excluded.
+  A reference result can be passed to check that the computation is ok.
+*/
+template<typename F>
+Matrix* spmvReordered(const char *name, F spmvFunction, const ReorderedCSR *r, const Matrix *v,
+	const Matrix *reference = NULL, double *spmvTime = NULL)
+{
+	const uint n = r->m->h;
+	DenseMatrix<float> pv(1, n); // aligned, freed on return even if spmvFunction throws
+	permuteVector(n, r->perm, v->data, pv.data());
+
+	Matrix pvView = pv.cView();
+	Matrix *result = NULL;
+	double t = timeSpmv(spmvFunction, r->m, &pvView, &result);
+	DenseMatrix<float> pmv = DenseMatrix<float>::adopt(&result); // no copy, freed on return
+
+	DenseMatrix<float> mv(1, n);
+	unpermuteVector(n, r->perm, pmv.data(), mv.data());
+
+	char title[128];
+	snprintf(title, sizeof(title), "%s after %s reordering", name, reorderMethodName(r->method));
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		Matrix mvView = mv.cView();
+		if(! checkResult(title, reference, &mvView))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", title, r->m->w, r->m->h, t);
+
+	if( spmvTime )
+		*spmvTime = t;
+	return mv.release(); // destroyed by deleteMatrix() like other results
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<stdexcept>
+
+#include"roofline.h"
+
+
+// each array is 128 MB, larger than last level caches
+#define STREAM_SIZE (1 << 25)
+#define STREAM_RUNS 5
+
+
+/**
+  Measure the host memory bandwidth with a STREAM triad.
+*/
+double cpuStreamBandwidth()
+{
+	float *a = NULL;
+	float *b = NULL;
+	float *c = NULL;
+	if( posix_memalign((void**) &a, 64, STREAM_SIZE * sizeof(float)) ||
+		posix_memalign((void**) &b, 64, STREAM_SIZE * sizeof(float)) ||
+		posix_memalign((void**) &c, 64, STREAM_SIZE * sizeof(float)) )
+		throw std::runtime_error("Failed to allocate bandwidth benchmark arrays.");
+
+	// first touch with the same schedule as the triad
+	#pragma omp parallel for schedule(static)
+	for(long i = 0; i < STREAM_SIZE; i++)
+	{
+		a[i] = 0.0f;
+		b[i] = 1.0f;
+		c[i] = 2.0f;
+	}
+
+	double best = 0.0;
+	for(int run = 0; run < STREAM_RUNS; run++)
+	{
+		std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+
+		#pragma omp parallel for schedule(static)
+		for(long i = 0; i < STREAM_SIZE; i++)
+			a[i] = b[i] + 3.0f * c[i];
+
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+		if( run == 0 || t < best )
+			best = t;
+	}
+
+	free(a);
+	free(b);
+	free(c);
+
+	// 2 arrays read, 1 written
+	return 3.0 * STREAM_SIZE * sizeof(float) / best / 1e9;
+}
+
+
+/**
+  Return the bandwidths of the host and of the device, measured on first call.
+*/
+const BandwidthPeaks& getBandwidthPeaks()
+{
+	static BandwidthPeaks peaks = {0.0, 0.0};
+	if( peaks.cpuGBs == 0.0 )
+	{
+		printf("Measuring memory bandwidth...\n");
+		peaks.cpuGBs = cpuStreamBandwidth();
+		peaks.gpuGBs = gpuStreamBandwidth();
+		printf("Memory bandwidth: %f GB/s on CPU, %f GB/s on GPU (STREAM triad).\n", peaks.cpuGBs, peaks.gpuGBs);
+	}
+	return peaks;
+}
+
+
+/**
+  Share of a peak bandwidth reached by a MxV, in %.
+*/
+double peakPercent(double bytes, double ms, double peakGBs)
+{
+	if( ms <= 0.0 || peakGBs <= 0.0 )
+		return 0.0;
+	return 100.0 * (bytes / (ms * 1e6)) / peakGBs;
+}
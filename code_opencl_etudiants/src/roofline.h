@@ -0,0 +1,43 @@
+#ifndef __ROOFLINE_H__
+#define __ROOFLINE_H__
+
+#include"common.h"
+
+
+/**
+  Sustainable memory bandwidth of the host and of the OpenCL device, in
+  GB/s. MxV reads each matrix value once, so its time is bounded below by
+  bytes moved / bandwidth.
+*/
+typedef struct bandwidthPeaks
+{
+	double cpuGBs;
+	double gpuGBs;
+} BandwidthPeaks;
+
+
+/**
+  Measure the host memory bandwidth with a STREAM triad a = b + s.c on
+  arrays larger than caches, multithreaded with OpenMP. Best of a few runs.
+*/
+double cpuStreamBandwidth();
+
+/**
+  Measure the device global memory bandwidth with the same triad, computed
+  by an OpenCL kernel. Best of a few runs, memory transfers are not counted.
+*/
+double gpuStreamBandwidth();
+
+/**
+  Return the bandwidths of the host and of the device, measured on first
+  call.
+*/
+const BandwidthPeaks& getBandwidthPeaks();
+
+/**
+  Share of a peak bandwidth reached by a MxV moving 'bytes' bytes in 'ms' ms,
+  in %.
+*/
+double peakPercent(double bytes, double ms, double peakGBs);
+
+#endif
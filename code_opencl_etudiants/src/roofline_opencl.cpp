@@ -0,0 +1,102 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<stdexcept>
+
+#include"roofline.h"
+
+
+// each array is 128 MB at most, larger than device caches
+#define STREAM_SIZE (1 << 25)
+#define STREAM_RUNS 5
+
+
+//---------------------------------------------------------
+
+std::string kernelStream_source =
+	"__kernel void kernelStreamInit(uint n, __global float4 *a, __global float4 *b, __global float4 *c)\n"
+	"{\n"
+	"	uint i = get_global_id(0);\n"
+	"	if( i < n )\n"
+	"	{\n"
+	"		a[i] = (float4) (0.0f);\n"
+	"		b[i] = (float4) (1.0f);\n"
+	"		c[i] = (float4) (2.0f);\n"
+	"	}\n"
+	"}\n"
+	"\n"
+	"// STREAM triad, 4 values per work item for wide coalesced accesses\n"
+	"__kernel void kernelStreamTriad(uint n, __global float4 *a, const __global float4 *b, const __global float4 *c)\n"
+	"{\n"
+	"	uint i = get_global_id(0);\n"
+	"	if( i < n )\n"
+	"		a[i] = b[i] + 3.0f * c[i];\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Measure the device global memory bandwidth with a STREAM triad.
+*/
+double gpuStreamBandwidth()
+{
+	double best = 0.0;
+	size_t n = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelStream_source);
+		cl::Kernel kernelInit(program, "kernelStreamInit");
+		cl::Kernel kernelTriad(program, "kernelStreamTriad");
+
+		// arrays are not pooled, they are too large to be kept
+		cl_ulong maxAlloc = env.device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+		n = std::min((size_t) STREAM_SIZE, (size_t) (maxAlloc / sizeof(float))) / 4 * 4;
+		size_t sizeInBytes = n * sizeof(float);
+		cl::Buffer gpuA(env.context, CL_MEM_READ_WRITE, sizeInBytes);
+		cl::Buffer gpuB(env.context, CL_MEM_READ_WRITE, sizeInBytes);
+		cl::Buffer gpuC(env.context, CL_MEM_READ_WRITE, sizeInBytes);
+
+		// set workgroup and grid size
+		uint n4 = (uint) (n / 4);
+		size_t work_group_size = 256;
+		size_t global_work_size = ((n4 + work_group_size - 1) / work_group_size) * work_group_size;
+
+		kernelInit.setArg(0, n4);
+		kernelInit.setArg(1, gpuA);
+		kernelInit.setArg(2, gpuB);
+		kernelInit.setArg(3, gpuC);
+		kernelTriad.setArg(0, n4);
+		kernelTriad.setArg(1, gpuA);
+		kernelTriad.setArg(2, gpuB);
+		kernelTriad.setArg(3, gpuC);
+
+		queue.enqueueNDRangeKernel(kernelInit, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+		queue.finish();
+
+		for(int run = 0; run < STREAM_RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+			queue.enqueueNDRangeKernel(kernelTriad, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+			queue.finish();
+			double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+
+			if( run == 0 || t < best )
+				best = t;
+		}
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	// 2 arrays read, 1 written
+	return 3.0 * n * sizeof(float) / best / 1e9;
+}
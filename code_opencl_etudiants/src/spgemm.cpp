@@ -0,0 +1,198 @@
+#include<algorithm>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"spgemm.h"
+
+#define EMPTY_KEY 0xffffffffu
+
+
+/**
+  Multiplicative hash of a column index, mask is table size - 1.
+*/
+static inline uint hashSlot(uint col, uint mask)
+{
+	return (col * 2654435761u) & mask;
+}
+
+
+/**
+  Size of the hash table needed for a row with at most n non zero values.
+*/
+static inline uint hashTableSize(uint n)
+{
+	uint size = 1;
+	while( size < 2 * n )
+		size <<= 1;
+	return n ? size : 0;
+}
+
+
+/**
+  Upper bound of the number of non zero values of row r of A x B.
+*/
+static inline uint rowUpperBound(const MatrixCSR *a, const MatrixCSR *b, uint r)
+{
+	size_t ub = 0;
+	for(uint i = a->row_ptr[r]; i < a->row_ptr[r+1]; i++)
+	{
+		uint k = a->col_ind[i];
+		ub += b->row_ptr[k+1] - b->row_ptr[k];
+	}
+	return (uint) std::min(ub, (size_t) b->w);
+}
+
+
+/**
+  Size of the hash table of each row of A x B.
+*/
+size_t spgemmHashTableSizes(const MatrixCSR *a, const MatrixCSR *b, uint *hash_ptr)
+{
+	size_t total = 0;
+	for(uint r = 0; r < a->h; r++)
+	{
+		hash_ptr[r] = (uint) total;
+		total += hashTableSize(rowUpperBound(a, b, r));
+		if( total > 0xffffffffu )
+			throw std::runtime_error("Failed to multiply matrices, hash tables too large.");
+	}
+	hash_ptr[a->h] = (uint) total;
+
+	return total;
+}
+
+
+/**
+  Compute A x B on CPU.
+*/
+MatrixCSR* cpuSpgemm(const MatrixCSR *a, const MatrixCSR *b, const MatrixCSR *reference)
+{
+	const char *name = "SpGEMM hash method on cpu";
+
+	if(a->w != b->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+
+	std::vector<uint> row_ptr(a->h + 1, 0);
+
+	top(0);
+
+	// symbolic phase, count non zero values of each row
+	#pragma omp parallel
+	{
+		std::vector<uint> keys;
+
+		#pragma omp for schedule(dynamic, 16)
+		for(long r = 0; r < (long) a->h; r++)
+		{
+			uint size = hashTableSize(rowUpperBound(a, b, r));
+			uint mask = size - 1;
+			if( keys.size() < size )
+				keys.resize(size);
+			std::fill(keys.begin(), keys.begin() + size, EMPTY_KEY);
+
+			uint nz = 0;
+			for(uint i = a->row_ptr[r]; i < a->row_ptr[r+1]; i++)
+			{
+				uint k = a->col_ind[i];
+				for(uint j = b->row_ptr[k]; j < b->row_ptr[k+1]; j++)
+				{
+					uint c = b->col_ind[j];
+					uint h = hashSlot(c, mask);
+					while( keys[h] != c && keys[h] != EMPTY_KEY )
+						h = (h + 1) & mask;
+					if( keys[h] == EMPTY_KEY )
+					{
+						keys[h] = c;
+						nz++;
+					}
+				}
+			}
+			row_ptr[r+1] = nz;
+		}
+	}
+
+	// 32 bit row pointers, the sum is checked before it can wrap
+	size_t total = 0;
+	for(uint r = 0; r < a->h; r++)
+	{
+		total += row_ptr[r+1];
+		if( total > 0xffffffffu )
+			throw std::runtime_error("Failed to multiply matrices, too many non zero values.");
+		row_ptr[r+1] = (uint) total;
+	}
+
+	MatrixCSR *axb = createMatrixCSR(b->w, a->h, row_ptr[a->h]);
+	std::copy(row_ptr.begin(), row_ptr.end(), axb->row_ptr);
+
+	// numeric phase, accumulate each row then write it sorted
+	#pragma omp parallel
+	{
+		std::vector<uint> keys;
+		std::vector<float> vals;
+		std::vector< std::pair<uint, float> > row;
+
+		#pragma omp for schedule(dynamic, 16)
+		for(long r = 0; r < (long) a->h; r++)
+		{
+			uint size = hashTableSize(rowUpperBound(a, b, r));
+			uint mask = size - 1;
+			if( keys.size() < size )
+			{
+				keys.resize(size);
+				vals.resize(size);
+			}
+			std::fill(keys.begin(), keys.begin() + size, EMPTY_KEY);
+
+			for(uint i = a->row_ptr[r]; i < a->row_ptr[r+1]; i++)
+			{
+				uint k = a->col_ind[i];
+				float aik = a->data[i];
+				for(uint j = b->row_ptr[k]; j < b->row_ptr[k+1]; j++)
+				{
+					uint c = b->col_ind[j];
+					uint h = hashSlot(c, mask);
+					while( keys[h] != c && keys[h] != EMPTY_KEY )
+						h = (h + 1) & mask;
+					if( keys[h] == EMPTY_KEY )
+					{
+						keys[h] = c;
+						vals[h] = 0.0f;
+					}
+					vals[h] += aik * b->data[j];
+				}
+			}
+
+			row.clear();
+			for(uint h = 0; h < size; h++)
+			{
+				if( keys[h] != EMPTY_KEY )
+					row.push_back(std::make_pair(keys[h], vals[h]));
+			}
+			std::sort(row.begin(), row.end());
+
+			uint p = axb->row_ptr[r];
+			for(size_t i = 0; i < row.size(); i++, p++)
+			{
+				axb->col_ind[p] = row[i].first;
+				axb->data[p] = row[i].second;
+			}
+		}
+	}
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResultCSR(name, reference, axb))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: A(%dx%d)xB(%dx%d) with %d non zero values computed in %f ms.\n", name, a->w, a->h, b->w, b->h, axb->nzNbr, cpuRunTime);
+
+	return axb;
+}
@@ -0,0 +1,32 @@
+#ifndef __SPGEMM_H__
+#define __SPGEMM_H__
+
+#include"common.h"
+
+
+/**
+  Compute A x B on CPU, A and B sparse. Two phases: symbolic phase counts
+  non zero values of each row of the result, numeric phase computes them.
+  Rows are accumulated in hash tables, one per thread.
+  Result has sorted column indices and must be deallocated by user by
+  calling deleteMatrixCSR().
+  A reference result can be passed to check that the computation is ok.
+*/
+MatrixCSR* cpuSpgemm(const MatrixCSR *a, const MatrixCSR *b, const MatrixCSR *reference = NULL);
+
+/**
+  Same as cpuSpgemm(), on GPU. One row of the result per work item, hash
+  tables are stored in global memory.
+*/
+MatrixCSR* gpuSpgemm(const MatrixCSR *a, const MatrixCSR *b, const MatrixCSR *reference = NULL);
+
+
+/**
+  Size of the hash table of each row of A x B, as offsets in a global table:
+  row r uses entries [hash_ptr[r], hash_ptr[r+1]). Sizes are powers of 2,
+  at least twice the upper bound of non zero values in the row.
+  Returns the total size.
+*/
+size_t spgemmHashTableSizes(const MatrixCSR *a, const MatrixCSR *b, uint *hash_ptr);
+
+#endif
@@ -0,0 +1,279 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+#include<vector>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"spgemm.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpgemm_source =
+	"#define EMPTY_KEY 0xffffffffu\n"
+	"\n"
+	"uint hashSlot(uint col, uint mask)\n"
+	"{\n"
+	"	return (col * 2654435761u) & mask;\n"
+	"}\n"
+	"\n"
+	"// count non zero values of each row of A x B\n"
+	"__kernel void kernelSpgemmSymbolic(uint rowsNbr, const __global uint *a_col_ind, const __global uint *a_row_ptr,\n"
+	"	const __global uint *b_col_ind, const __global uint *b_row_ptr,\n"
+	"	const __global uint *hash_ptr, __global uint *keys, __global uint *rowNz)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r >= rowsNbr )\n"
+	"		return;\n"
+	"\n"
+	"	uint beg = hash_ptr[r];\n"
+	"	uint size = hash_ptr[r+1] - beg;\n"
+	"	uint mask = size - 1;\n"
+	"	__global uint *rowKeys = keys + beg;\n"
+	"	for(uint h = 0; h < size; h++)\n"
+	"		rowKeys[h] = EMPTY_KEY;\n"
+	"\n"
+	"	uint nz = 0;\n"
+	"	for(uint i = a_row_ptr[r]; i < a_row_ptr[r+1]; i++)\n"
+	"	{\n"
+	"		uint k = a_col_ind[i];\n"
+	"		for(uint j = b_row_ptr[k]; j < b_row_ptr[k+1]; j++)\n"
+	"		{\n"
+	"			uint c = b_col_ind[j];\n"
+	"			uint h = hashSlot(c, mask);\n"
+	"			while( rowKeys[h] != c && rowKeys[h] != EMPTY_KEY )\n"
+	"				h = (h + 1) & mask;\n"
+	"			if( rowKeys[h] == EMPTY_KEY )\n"
+	"			{\n"
+	"				rowKeys[h] = c;\n"
+	"				nz++;\n"
+	"			}\n"
+	"		}\n"
+	"	}\n"
+	"	rowNz[r] = nz;\n"
+	"}\n"
+	"\n"
+	"// compute each row of A x B, then compact and sort it into C\n"
+	"__kernel void kernelSpgemmNumeric(uint rowsNbr,\n"
+	"	const __global float *a_values, const __global uint *a_col_ind, const __global uint *a_row_ptr,\n"
+	"	const __global float *b_values, const __global uint *b_col_ind, const __global uint *b_row_ptr,\n"
+	"	const __global uint *hash_ptr, __global uint *keys, __global float *vals,\n"
+	"	const __global uint *c_row_ptr, __global float *c_values, __global uint *c_col_ind)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r >= rowsNbr )\n"
+	"		return;\n"
+	"\n"
+	"	uint beg = hash_ptr[r];\n"
+	"	uint size = hash_ptr[r+1] - beg;\n"
+	"	uint mask = size - 1;\n"
+	"	__global uint *rowKeys = keys + beg;\n"
+	"	__global float *rowVals = vals + beg;\n"
+	"	for(uint h = 0; h < size; h++)\n"
+	"		rowKeys[h] = EMPTY_KEY;\n"
+	"\n"
+	"	for(uint i = a_row_ptr[r]; i < a_row_ptr[r+1]; i++)\n"
+	"	{\n"
+	"		uint k = a_col_ind[i];\n"
+	"		float aik = a_values[i];\n"
+	"		for(uint j = b_row_ptr[k]; j < b_row_ptr[k+1]; j++)\n"
+	"		{\n"
+	"			uint c = b_col_ind[j];\n"
+	"			uint h = hashSlot(c, mask);\n"
+	"			while( rowKeys[h] != c && rowKeys[h] != EMPTY_KEY )\n"
+	"				h = (h + 1) & mask;\n"
+	"			if( rowKeys[h] == EMPTY_KEY )\n"
+	"			{\n"
+	"				rowKeys[h] = c;\n"
+	"				rowVals[h] = 0.0f;\n"
+	"			}\n"
+	"			rowVals[h] += aik * b_values[j];\n"
+	"		}\n"
+	"	}\n"
+	"\n"
+	"	// compact the hash table at its start, slots are read before written\n"
+	"	uint nz = 0;\n"
+	"	for(uint h = 0; h < size; h++)\n"
+	"	{\n"
+	"		uint c = rowKeys[h];\n"
+	"		if( c != EMPTY_KEY )\n"
+	"		{\n"
+	"			float val = rowVals[h];\n"
+	"			rowKeys[nz] = c;\n"
+	"			rowVals[nz] = val;\n"
+	"			nz++;\n"
+	"		}\n"
+	"	}\n"
+	"\n"
+	"	// sort by rank, columns are distinct: the position of a column in the\n"
+	"	// row is the number of smaller columns, each value is written once\n"
+	"	uint row_beg = c_row_ptr[r];\n"
+	"	for(uint i = 0; i < nz; i++)\n"
+	"	{\n"
+	"		uint c = rowKeys[i];\n"
+	"		uint rank = 0;\n"
+	"		for(uint j = 0; j < nz; j++)\n"
+	"			rank += (rowKeys[j] < c) ? 1 : 0;\n"
+	"\n"
+	"		c_col_ind[row_beg + rank] = c;\n"
+	"		c_values[row_beg + rank] = rowVals[i];\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute A x B on GPU.
+  A reference result can be passed to check that the computation is ok.
+*/
+MatrixCSR* gpuSpgemm(const MatrixCSR *a, const MatrixCSR *b, const MatrixCSR *reference)
+{
+	const char *name = "SpGEMM hash method on GPU";
+
+	if(a->w != b->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+
+	MatrixCSR *axb = NULL;
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpgemm_source);
+		cl::Kernel symbolic(program, "kernelSpgemmSymbolic");
+		cl::Kernel numeric(program, "kernelSpgemmNumeric");
+
+		top(0); // start time measurement
+
+		// hash table sizes only depend on the structure of A and B
+		std::vector<uint> hash_ptr(a->h + 1);
+		size_t hashSize = spgemmHashTableSizes(a, b, &hash_ptr[0]);
+
+		// allocate global memory on GPU
+		size_t a_nzSizeInBytes = (size_t) a->nzNbr * sizeof(float);
+		size_t a_row_ptrSizeInBytes = (size_t) (a->h + 1) * sizeof(uint);
+		size_t b_nzSizeInBytes = (size_t) b->nzNbr * sizeof(float);
+		size_t b_row_ptrSizeInBytes = (size_t) (b->h + 1) * sizeof(uint);
+		size_t hashSizeInBytes = (hashSize ? hashSize : 1) * sizeof(uint);
+		cl::Buffer gpuA_values = acquireBuffer(CL_MEM_READ_ONLY, a_nzSizeInBytes);
+		cl::Buffer gpuA_col_ind = acquireBuffer(CL_MEM_READ_ONLY, a_nzSizeInBytes);
+		cl::Buffer gpuA_row_ptr = acquireBuffer(CL_MEM_READ_ONLY, a_row_ptrSizeInBytes);
+		cl::Buffer gpuB_values = acquireBuffer(CL_MEM_READ_ONLY, b_nzSizeInBytes);
+		cl::Buffer gpuB_col_ind = acquireBuffer(CL_MEM_READ_ONLY, b_nzSizeInBytes);
+		cl::Buffer gpuB_row_ptr = acquireBuffer(CL_MEM_READ_ONLY, b_row_ptrSizeInBytes);
+		cl::Buffer gpuHash_ptr = acquireBuffer(CL_MEM_READ_ONLY, a_row_ptrSizeInBytes);
+		cl::Buffer gpuKeys = acquireBuffer(CL_MEM_READ_WRITE, hashSizeInBytes);
+		cl::Buffer gpuVals = acquireBuffer(CL_MEM_READ_WRITE, hashSizeInBytes);
+		cl::Buffer gpuC_row_ptr = acquireBuffer(CL_MEM_READ_WRITE, a_row_ptrSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		queue.enqueueWriteBuffer(gpuA_values, CL_TRUE, 0, a_nzSizeInBytes, a->data);
+		queue.enqueueWriteBuffer(gpuA_col_ind, CL_TRUE, 0, a_nzSizeInBytes, a->col_ind);
+		queue.enqueueWriteBuffer(gpuA_row_ptr, CL_TRUE, 0, a_row_ptrSizeInBytes, a->row_ptr);
+		queue.enqueueWriteBuffer(gpuB_values, CL_TRUE, 0, b_nzSizeInBytes, b->data);
+		queue.enqueueWriteBuffer(gpuB_col_ind, CL_TRUE, 0, b_nzSizeInBytes, b->col_ind);
+		queue.enqueueWriteBuffer(gpuB_row_ptr, CL_TRUE, 0, b_row_ptrSizeInBytes, b->row_ptr);
+		queue.enqueueWriteBuffer(gpuHash_ptr, CL_TRUE, 0, a_row_ptrSizeInBytes, &hash_ptr[0]);
+
+		// set workgroup and grid size
+		size_t work_group_size = 64;
+		size_t global_work_size = ((a->h + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// symbolic phase, the count of row r is written at rowNz[r] and read
+		// back at row_ptr[r+1]
+		symbolic.setArg(0, a->h);
+		symbolic.setArg(1, gpuA_col_ind);
+		symbolic.setArg(2, gpuA_row_ptr);
+		symbolic.setArg(3, gpuB_col_ind);
+		symbolic.setArg(4, gpuB_row_ptr);
+		symbolic.setArg(5, gpuHash_ptr);
+		symbolic.setArg(6, gpuKeys);
+		symbolic.setArg(7, gpuC_row_ptr);
+
+		top(1);
+		queue.enqueueNDRangeKernel(symbolic, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// prefix sum of row counts on CPU gives the size of C
+		std::vector<uint> row_ptr(a->h + 1, 0);
+		queue.enqueueReadBuffer(gpuC_row_ptr, CL_TRUE, 0, a->h * sizeof(uint), &row_ptr[1]);
+		for(uint r = 0; r < a->h; r++)
+			row_ptr[r+1] += row_ptr[r];
+		queue.enqueueWriteBuffer(gpuC_row_ptr, CL_TRUE, 0, a_row_ptrSizeInBytes, &row_ptr[0]);
+
+		axb = createMatrixCSR(b->w, a->h, row_ptr[a->h]);
+		std::copy(row_ptr.begin(), row_ptr.end(), axb->row_ptr);
+
+		size_t c_nzSizeInBytes = (size_t) (axb->nzNbr ? axb->nzNbr : 1) * sizeof(float);
+		cl::Buffer gpuC_values = acquireBuffer(CL_MEM_WRITE_ONLY, c_nzSizeInBytes);
+		cl::Buffer gpuC_col_ind = acquireBuffer(CL_MEM_WRITE_ONLY, c_nzSizeInBytes);
+
+		// numeric phase
+		numeric.setArg(0, a->h);
+		numeric.setArg(1, gpuA_values);
+		numeric.setArg(2, gpuA_col_ind);
+		numeric.setArg(3, gpuA_row_ptr);
+		numeric.setArg(4, gpuB_values);
+		numeric.setArg(5, gpuB_col_ind);
+		numeric.setArg(6, gpuB_row_ptr);
+		numeric.setArg(7, gpuHash_ptr);
+		numeric.setArg(8, gpuKeys);
+		numeric.setArg(9, gpuVals);
+		numeric.setArg(10, gpuC_row_ptr);
+		numeric.setArg(11, gpuC_values);
+		numeric.setArg(12, gpuC_col_ind);
+		queue.enqueueNDRangeKernel(numeric, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		if( axb->nzNbr )
+		{
+			queue.enqueueReadBuffer(gpuC_values, CL_TRUE, 0, (size_t) axb->nzNbr * sizeof(float), axb->data);
+			queue.enqueueReadBuffer(gpuC_col_ind, CL_TRUE, 0, (size_t) axb->nzNbr * sizeof(uint), axb->col_ind);
+		}
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuA_values);
+		releaseBuffer(gpuA_col_ind);
+		releaseBuffer(gpuA_row_ptr);
+		releaseBuffer(gpuB_values);
+		releaseBuffer(gpuB_col_ind);
+		releaseBuffer(gpuB_row_ptr);
+		releaseBuffer(gpuHash_ptr);
+		releaseBuffer(gpuKeys);
+		releaseBuffer(gpuVals);
+		releaseBuffer(gpuC_row_ptr);
+		releaseBuffer(gpuC_values);
+		releaseBuffer(gpuC_col_ind);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResultCSR(name, reference, axb))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: A(%dx%d)xB(%dx%d) with %d non zero values computed in %f ms (%f ms of pure computation).\n", name, a->w, a->h, b->w, b->h, axb->nzNbr, gpuRunTime, gpuComputeTime);
+
+	return axb;
+}
@@ -0,0 +1,132 @@
+#include<algorithm>
+#include<cstdlib>
+#include<stdexcept>
+#include<vector>
+
+#include<stdint.h>
+#include<omp.h>
+
+#include"spmv_binned.h"
+
+
+// longest row of each bin
+static const uint binMaxLen[ROW_BINS_NBR] = {8, 64, 1024, 0xffffffffu};
+
+
+/**
+  Sort the rows of a matrix by increasing number of values.
+*/
+void sortRowsByLength(const MatrixCSR *m, uint *rows)
+{
+	uint n = m->h;
+	std::vector<uint> keys(n);
+	std::vector<uint> tmpKeys(n);
+	std::vector<uint> tmpRows(n);
+
+	uint maxLen = 0;
+	#pragma omp parallel for reduction(max:maxLen)
+	for(long r = 0; r < (long) n; r++)
+	{
+		keys[r] = m->row_ptr[r+1] - m->row_ptr[r];
+		rows[r] = (uint) r;
+		maxLen = std::max(maxLen, keys[r]);
+	}
+
+	int threadsNbr = omp_get_max_threads();
+	std::vector<uint> hist((size_t) threadsNbr * 256);
+
+	uint *srcKeys = &keys[0], *dstKeys = &tmpKeys[0];
+	uint *srcRows = rows, *dstRows = &tmpRows[0];
+
+	// only the digits used by the longest row
+	for(uint shift = 0; shift < 32 && (maxLen >> shift) != 0; shift += 8)
+	{
+		#pragma omp parallel num_threads(threadsNbr)
+		{
+			int t = omp_get_thread_num();
+			int tNbr = omp_get_num_threads();
+			uint *h = &hist[(size_t) t * 256];
+			std::fill(h, h + 256, 0);
+
+			// same static split of the keys in both loops, so each thread
+			// scatters its own keys in order and the sort is stable
+			uint beg = (uint) ((uint64_t) n * t / tNbr);
+			uint end = (uint) ((uint64_t) n * (t + 1) / tNbr);
+			for(uint i = beg; i < end; i++)
+				h[(srcKeys[i] >> shift) & 0xff]++;
+
+			#pragma omp barrier
+			#pragma omp single
+			{
+				// offsets ordered by digit, then by thread
+				uint sum = 0;
+				for(uint d = 0; d < 256; d++)
+				{
+					for(int u = 0; u < tNbr; u++)
+					{
+						uint count = hist[(size_t) u * 256 + d];
+						hist[(size_t) u * 256 + d] = sum;
+						sum += count;
+					}
+				}
+			}
+
+			for(uint i = beg; i < end; i++)
+			{
+				uint p = h[(srcKeys[i] >> shift) & 0xff]++;
+				dstKeys[p] = srcKeys[i];
+				dstRows[p] = srcRows[i];
+			}
+		}
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcRows, dstRows);
+	}
+
+	if( srcRows != rows )
+		std::copy(srcRows, srcRows + n, rows);
+}
+
+
+/**
+  Sort and bin the rows of a matrix.
+*/
+MatrixCSRBinned* csrToBinned(const MatrixCSR *m)
+{
+	MatrixCSRBinned *b = (MatrixCSRBinned*) malloc(sizeof(MatrixCSRBinned));
+	if( ! b )
+		throw std::runtime_error("Failed to allocate binned matrix.");
+
+	b->m = m;
+	b->rows = (uint*) malloc((size_t) m->h * sizeof(uint));
+	if( m->h && ! b->rows )
+		throw std::runtime_error("Failed to allocate binned matrix.");
+
+	sortRowsByLength(m, b->rows);
+
+	// rows are sorted, bins are contiguous
+	b->bin_ptr[0] = 0;
+	uint k = 0;
+	for(int bin = 0; bin < ROW_BINS_NBR; bin++)
+	{
+		while( k < m->h && m->row_ptr[b->rows[k]+1] - m->row_ptr[b->rows[k]] <= binMaxLen[bin] )
+			k++;
+		b->bin_ptr[bin + 1] = k;
+	}
+
+	return b;
+}
+
+
+/**
+  Destroy a MatrixCSRBinned structure.
+*/
+void deleteMatrixCSRBinned(MatrixCSRBinned **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->rows);
+	free(*m);
+	*m = NULL;
+}
@@ -0,0 +1,55 @@
+#ifndef __SPMV_BINNED_H__
+#define __SPMV_BINNED_H__
+
+#include"common.h"
+
+
+/**
+  Number of bins of rows, by number of values: up to 8 values, one work item
+  per row; up to 64, 8 work items per row; up to 1024, one warp per row;
+  more, one work group per row.
+*/
+#define ROW_BINS_NBR 4
+
+
+/**
+  Rows of a CSR matrix sorted by number of values and split in bins, each
+  bin being computed by the kernel suited to its row length. The matrix is
+  not copied, it must outlive this structure.
+*/
+typedef struct matrixCSRBinned
+{
+	const MatrixCSR *m; // matrix
+	uint *rows; // rows sorted by increasing number of values
+	uint bin_ptr[ROW_BINS_NBR + 1]; // first sorted row of each bin
+} MatrixCSRBinned;
+
+
+/**
+  Sort the rows of a matrix by increasing number of values, rows of same
+  length staying in their order. Parallel LSD radix sort on 8 bit digits.
+  rows must have m->h values.
+*/
+void sortRowsByLength(const MatrixCSR *m, uint *rows);
+
+/**
+  Sort and bin the rows of a matrix.
+  Memory must be deallocated by user by calling deleteMatrixCSRBinned().
+*/
+MatrixCSRBinned* csrToBinned(const MatrixCSR *m);
+
+/**
+  Destroy a MatrixCSRBinned structure.
+*/
+void deleteMatrixCSRBinned(MatrixCSRBinned **m);
+
+
+/**
+  Compute MxV on GPU, one kernel launch per bin with as many work items per
+  row as the bin needs. Work items of a group get rows of close lengths, and
+  results are written at the original row index, so y needs no permutation.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRBinned(const MatrixCSRBinned *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
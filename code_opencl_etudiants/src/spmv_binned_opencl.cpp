@@ -0,0 +1,188 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_binned.h"
+#include"benchmark.h"
+
+
+// work items per row of each bin
+static const uint binLanes[ROW_BINS_NBR] = {1, 8, 32, 256};
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSRBinned_source =
+	"// LANES work items per row, LANES divides the work group size\n"
+	"// rows[rowsBeg..rowsEnd[ are the rows of the bin\n"
+	"__kernel void kernelSpmvCSRBinned(uint rowsBeg, uint rowsEnd, const __global uint *rows,\n"
+	"	const __global float *values, const __global uint *col_ind, const __global uint *row_ptr,\n"
+	"	const __global float *v, __global float *y, __local float *dots)\n"
+	"{\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint k = rowsBeg + get_global_id(0) / LANES;\n"
+	"	uint lane = get_global_id(0) % LANES;\n"
+	"\n"
+	"	uint r = 0;\n"
+	"	float dot = 0.0f;\n"
+	"	if( k < rowsEnd )\n"
+	"	{\n"
+	"		r = rows[k];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"		for(uint i = row_ptr[r] + lane; i < row_end; i += LANES)\n"
+	"			dot += values[i] * v[col_ind[i]];\n"
+	"	}\n"
+	"\n"
+	"#if LANES > 1\n"
+	"	dots[localId] = dot;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	for(uint s = LANES / 2; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( lane < s )\n"
+	"			dots[localId] += dots[localId + s];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"	dot = dots[localId];\n"
+	"#endif\n"
+	"\n"
+	"	// written at the original row index\n"
+	"	if( lane == 0 && k < rowsEnd )\n"
+	"		y[r] = dot;\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, rows binned by length.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRBinned(const MatrixCSRBinned *b, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR binned method on GPU";
+	const MatrixCSR *m = b->m;
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		// one program per number of work items per row
+		cl::Kernel kernels[ROW_BINS_NBR];
+		for(int bin = 0; bin < ROW_BINS_NBR; bin++)
+		{
+			std::ostringstream options;
+			options << "-D LANES=" << binLanes[bin];
+			cl::Program program = buildProgram(kernelSpmvCSRBinned_source, options.str());
+			kernels[bin] = cl::Kernel(program, "kernelSpmvCSRBinned");
+		}
+
+		// allocate global memory on GPU
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t rowsSizeInBytes = (size_t) (m->h ? m->h : 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuRows = acquireBuffer(CL_MEM_READ_ONLY, rowsSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(float), m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(uint), m->col_ind);
+		}
+		if( m->h )
+			queue.enqueueWriteBuffer(gpuRows, CL_TRUE, 0, (size_t) m->h * sizeof(uint), b->rows);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set the arguments to our compute kernels
+		size_t work_group_size = 256;
+		for(int bin = 0; bin < ROW_BINS_NBR; bin++)
+		{
+			kernels[bin].setArg(0, b->bin_ptr[bin]);
+			kernels[bin].setArg(1, b->bin_ptr[bin + 1]);
+			kernels[bin].setArg(2, gpuRows);
+			kernels[bin].setArg(3, gpuValues);
+			kernels[bin].setArg(4, gpuCol_ind);
+			kernels[bin].setArg(5, gpuRow_ptr);
+			kernels[bin].setArg(6, gpuV);
+			kernels[bin].setArg(7, gpuMV);
+			kernels[bin].setArg(8, sizeof(float) * work_group_size, NULL);
+		}
+
+		// run kernels, bins are independent so they are queued back to back
+		top(1);
+		for(int bin = 0; bin < ROW_BINS_NBR; bin++)
+		{
+			size_t rowsNbr = b->bin_ptr[bin + 1] - b->bin_ptr[bin];
+			if( rowsNbr == 0 )
+				continue;
+
+			size_t global_work_size = ((rowsNbr * binLanes[bin] + work_group_size - 1) / work_group_size) * work_group_size;
+			queue.enqueueNDRangeKernel(kernels[bin], cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+		}
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuRows);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
@@ -0,0 +1,348 @@
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include<immintrin.h>
+#endif
+
+#include"tools.h"
+#include"spmv_bsr.h"
+
+
+const uint bsrSizes[BSR_SIZES_NBR] = {2, 3, 4, 6, 8};
+
+
+/**
+  Sorted block columns of the non zero blocks of a row of blocks.
+*/
+static void blockColumns(const MatrixCSR *m, uint bs, uint br, std::vector<uint> &cols)
+{
+	cols.clear();
+	uint r1 = std::min((br + 1) * bs, m->h);
+	for(uint r = br * bs; r < r1; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			cols.push_back(m->col_ind[i] / bs);
+	}
+	std::sort(cols.begin(), cols.end());
+	cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+}
+
+
+/**
+  Number of non zero blocks of a CSR matrix cut in bs x bs blocks.
+*/
+uint countBlocksCSR(const MatrixCSR *m, uint bs)
+{
+	uint blockRows = (m->h + bs - 1) / bs;
+	unsigned long blocksNbr = 0;
+
+	#pragma omp parallel reduction(+:blocksNbr)
+	{
+		std::vector<uint> cols;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long br = 0; br < (long) blockRows; br++)
+		{
+			blockColumns(m, bs, (uint) br, cols);
+			blocksNbr += cols.size();
+		}
+	}
+
+	return (uint) blocksNbr;
+}
+
+
+/**
+  Choose the block size of a CSR matrix.
+*/
+uint detectBlockSize(const MatrixCSR *m, float *fillRatio)
+{
+	// bytes read by MxV for the matrix, values and indices
+	double bestBytes = (double) m->nzNbr * (sizeof(float) + sizeof(uint)) + (double) (m->h + 1) * sizeof(uint);
+	uint bestSize = 1;
+	float bestFill = 1.0f;
+
+	for(int k = 0; k < BSR_SIZES_NBR; k++)
+	{
+		uint bs = bsrSizes[k];
+		uint blocksNbr = countBlocksCSR(m, bs);
+		double bytes = (double) blocksNbr * (bs * bs * sizeof(float) + sizeof(uint)) + (double) ((m->h + bs - 1) / bs + 1) * sizeof(uint);
+		if( bytes < bestBytes )
+		{
+			bestBytes = bytes;
+			bestSize = bs;
+			bestFill = blocksNbr ? (float) ((double) m->nzNbr / ((double) blocksNbr * bs * bs)) : 1.0f;
+		}
+	}
+
+	if( fillRatio )
+		*fillRatio = bestFill;
+	return bestSize;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixBSR.
+*/
+MatrixBSR* csrToBSR(const MatrixCSR *m, uint bs)
+{
+	if( bs == 0 )
+		throw std::runtime_error("Failed to convert matrix to BSR, null block size.");
+
+	MatrixBSR *b = (MatrixBSR*) malloc(sizeof(MatrixBSR));
+	if( ! b )
+		throw std::runtime_error("Failed to allocate BSR matrix.");
+
+	b->w = m->w;
+	b->h = m->h;
+	b->bs = bs;
+	b->blockRows = (m->h + bs - 1) / bs;
+	b->blockCols = (m->w + bs - 1) / bs;
+	b->row_ptr = (uint*) malloc((size_t) (b->blockRows + 1) * sizeof(uint));
+	if( ! b->row_ptr )
+		throw std::runtime_error("Failed to allocate BSR matrix.");
+
+	// count blocks of each row of blocks
+	b->row_ptr[0] = 0;
+	#pragma omp parallel
+	{
+		std::vector<uint> cols;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long br = 0; br < (long) b->blockRows; br++)
+		{
+			blockColumns(m, bs, (uint) br, cols);
+			b->row_ptr[br + 1] = (uint) cols.size();
+		}
+	}
+	for(uint br = 0; br < b->blockRows; br++)
+		b->row_ptr[br + 1] += b->row_ptr[br];
+
+	b->blocksNbr = b->row_ptr[b->blockRows];
+	size_t blockSize = (size_t) bs * bs;
+	b->data = (float*) malloc(b->blocksNbr * blockSize * sizeof(float));
+	b->col_ind = (uint*) malloc((size_t) b->blocksNbr * sizeof(uint));
+	if( b->blocksNbr && (! b->data || ! b->col_ind) )
+		throw std::runtime_error("Failed to allocate BSR matrix.");
+
+	// fill blocks, zeros included
+	#pragma omp parallel
+	{
+		std::vector<uint> cols;
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long br = 0; br < (long) b->blockRows; br++)
+		{
+			blockColumns(m, bs, (uint) br, cols);
+			uint beg = b->row_ptr[br];
+			std::copy(cols.begin(), cols.end(), b->col_ind + beg);
+			memset(b->data + beg * blockSize, 0, cols.size() * blockSize * sizeof(float));
+
+			uint r1 = std::min((uint) (br + 1) * bs, m->h);
+			for(uint r = (uint) br * bs; r < r1; r++)
+			{
+				for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+				{
+					uint c = m->col_ind[i];
+					uint k = (uint) (std::lower_bound(cols.begin(), cols.end(), c / bs) - cols.begin());
+					// column major in the block
+					b->data[(beg + k) * blockSize + (c % bs) * bs + (r % bs)] += m->data[i];
+				}
+			}
+		}
+	}
+
+	return b;
+}
+
+
+/**
+  Destroy a MatrixBSR structure.
+*/
+void deleteMatrixBSR(MatrixBSR **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->col_ind);
+	free((*m)->row_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  y = M.x for one row of blocks of BS x BS blocks, x padded to whole blocks.
+  The compiler keeps the BS sums in registers and vectorizes the inner loop.
+*/
+template<uint BS>
+static inline void spmvBlockRow(const MatrixBSR *m, uint br, const float *x, float *y)
+{
+	float acc[BS];
+	for(uint i = 0; i < BS; i++)
+		acc[i] = 0.0f;
+
+	for(uint k = m->row_ptr[br]; k < m->row_ptr[br+1]; k++)
+	{
+		const float *blk = m->data + (size_t) k * BS * BS;
+		const float *xb = x + (size_t) m->col_ind[k] * BS;
+		for(uint j = 0; j < BS; j++)
+		{
+			float xj = xb[j];
+			#pragma omp simd
+			for(uint i = 0; i < BS; i++)
+				acc[i] += blk[j * BS + i] * xj;
+		}
+	}
+
+	for(uint i = 0; i < BS; i++)
+		y[i] = acc[i];
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+/**
+  8 x 8 blocks: a column of a block is an AVX register.
+*/
+template<>
+inline void spmvBlockRow<8>(const MatrixBSR *m, uint br, const float *x, float *y)
+{
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+
+	for(uint k = m->row_ptr[br]; k < m->row_ptr[br+1]; k++)
+	{
+		const float *blk = m->data + (size_t) k * 64;
+		const float *xb = x + (size_t) m->col_ind[k] * 8;
+
+		// 2 accumulators to hide the latency of the multiply-adds
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 0), _mm256_broadcast_ss(xb + 0), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 8), _mm256_broadcast_ss(xb + 1), acc1);
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 16), _mm256_broadcast_ss(xb + 2), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 24), _mm256_broadcast_ss(xb + 3), acc1);
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 32), _mm256_broadcast_ss(xb + 4), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 40), _mm256_broadcast_ss(xb + 5), acc1);
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 48), _mm256_broadcast_ss(xb + 6), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(blk + 56), _mm256_broadcast_ss(xb + 7), acc1);
+	}
+
+	_mm256_storeu_ps(y, _mm256_add_ps(acc0, acc1));
+}
+
+/**
+  4 x 4 blocks: a column of a block is a SSE register.
+*/
+template<>
+inline void spmvBlockRow<4>(const MatrixBSR *m, uint br, const float *x, float *y)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+
+	for(uint k = m->row_ptr[br]; k < m->row_ptr[br+1]; k++)
+	{
+		const float *blk = m->data + (size_t) k * 16;
+		const float *xb = x + (size_t) m->col_ind[k] * 4;
+
+		acc0 = _mm_fmadd_ps(_mm_loadu_ps(blk + 0), _mm_broadcast_ss(xb + 0), acc0);
+		acc1 = _mm_fmadd_ps(_mm_loadu_ps(blk + 4), _mm_broadcast_ss(xb + 1), acc1);
+		acc0 = _mm_fmadd_ps(_mm_loadu_ps(blk + 8), _mm_broadcast_ss(xb + 2), acc0);
+		acc1 = _mm_fmadd_ps(_mm_loadu_ps(blk + 12), _mm_broadcast_ss(xb + 3), acc1);
+	}
+
+	_mm_storeu_ps(y, _mm_add_ps(acc0, acc1));
+}
+#endif
+
+
+/**
+  y = M.x for all rows of blocks, y and x padded to whole blocks.
+*/
+template<uint BS>
+static void spmvBSR(const MatrixBSR *m, const float *x, float *y)
+{
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long br = 0; br < (long) m->blockRows; br++)
+		spmvBlockRow<BS>(m, (uint) br, x, y + (size_t) br * BS);
+}
+
+
+/**
+  Same, block size known at run time only.
+*/
+static void spmvBSRGeneric(const MatrixBSR *m, const float *x, float *y)
+{
+	uint bs = m->bs;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long br = 0; br < (long) m->blockRows; br++)
+	{
+		float *yb = y + (size_t) br * bs;
+		for(uint i = 0; i < bs; i++)
+			yb[i] = 0.0f;
+
+		for(uint k = m->row_ptr[br]; k < m->row_ptr[br+1]; k++)
+		{
+			const float *blk = m->data + (size_t) k * bs * bs;
+			const float *xb = x + (size_t) m->col_ind[k] * bs;
+			for(uint j = 0; j < bs; j++)
+			{
+				for(uint i = 0; i < bs; i++)
+					yb[i] += blk[j * bs + i] * xb[j];
+			}
+		}
+	}
+}
+
+
+/**
+  Compute MxV on CPU, BSR method.
+*/
+Matrix* cpuSpmvBSR(const MatrixBSR *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "BSR method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+
+	// x and y padded to whole blocks, so kernels have no tail to handle
+	std::vector<float> x((size_t) m->blockCols * m->bs, 0.0f);
+	std::vector<float> y((size_t) m->blockRows * m->bs + 1);
+	std::copy(v->data, v->data + m->w, x.begin());
+
+	top(0);
+
+	switch( m->bs )
+	{
+		case 2: spmvBSR<2>(m, &x[0], &y[0]); break;
+		case 3: spmvBSR<3>(m, &x[0], &y[0]); break;
+		case 4: spmvBSR<4>(m, &x[0], &y[0]); break;
+		case 6: spmvBSR<6>(m, &x[0], &y[0]); break;
+		case 8: spmvBSR<8>(m, &x[0], &y[0]); break;
+		default: spmvBSRGeneric(m, &x[0], &y[0]); break;
+	}
+
+	double cpuRunTime = top(0);
+
+	std::copy(y.begin(), y.begin() + m->h, mv->data);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %dx%d blocks computed in %f ms.\n", name, m->w, m->h, m->bs, m->bs, cpuRunTime);
+
+	return mv;
+}
@@ -0,0 +1,76 @@
+#ifndef __SPMV_BSR_H__
+#define __SPMV_BSR_H__
+
+#include"common.h"
+
+
+/**
+  Block CSR matrix structure: the matrix is cut in square blocks of bs x bs
+  values, and the blocks holding at least one non zero value are stored
+  like the values of a CSR matrix of blocks. Values of a block are stored
+  column by column, zeros included; one column index is stored per block.
+*/
+typedef struct matrixBSR
+{
+	uint w; // width
+	uint h; // height
+	uint bs; // block size
+	uint blockRows; // number of rows of blocks
+	uint blockCols; // number of columns of blocks
+	uint blocksNbr; // number of non zero blocks
+	float *data; // array of blocks, bs * bs values each
+	uint *col_ind; // array of column index of blocks, in blocks
+	uint *row_ptr; // array of pointers to rows of blocks
+} MatrixBSR;
+
+
+/**
+  Block sizes with specialized kernels.
+*/
+#define BSR_SIZES_NBR 5
+extern const uint bsrSizes[BSR_SIZES_NBR];
+
+/**
+  Number of non zero blocks of a CSR matrix cut in bs x bs blocks.
+*/
+uint countBlocksCSR(const MatrixCSR *m, uint bs);
+
+/**
+  Choose the block size of a CSR matrix: the size of bsrSizes giving the
+  smallest BSR matrix, from the fill ratio (non zero values / stored values)
+  of each size. Returns 1 if no BSR matrix is smaller than the CSR one.
+  If fillRatio isn't NULL, it is set to the fill ratio of the chosen size.
+*/
+uint detectBlockSize(const MatrixCSR *m, float *fillRatio = NULL);
+
+/**
+  Convert a MatrixCSR to a MatrixBSR with blocks of bs x bs values.
+  Memory must be deallocated by user by calling deleteMatrixBSR().
+*/
+MatrixBSR* csrToBSR(const MatrixCSR *m, uint bs);
+
+/**
+  Destroy a MatrixBSR structure.
+*/
+void deleteMatrixBSR(MatrixBSR **m);
+
+
+/**
+  Compute MxV on CPU, one row of blocks per thread iteration. Kernels are
+  specialized for each size of bsrSizes: the bs partial sums of a row of
+  blocks stay in registers, each column of a block updates them with one
+  SIMD multiply-add. Multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvBSR(const MatrixBSR *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, bs work items per row of blocks, one per row of the
+  blocks, the block size being a build option of the kernel. Work items of
+  a row of blocks read columns of blocks with coalesced accesses and share
+  the x values.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvBSR(const MatrixBSR *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
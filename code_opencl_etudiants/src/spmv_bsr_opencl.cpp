@@ -0,0 +1,161 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+#include<vector>
+
+#include"tools.h"
+#include"spmv_bsr.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvBSR_source =
+	"// BS work items per row of blocks, work item i computes row i of the blocks\n"
+	"// blocks are stored column by column, so the BS work items read BS\n"
+	"// consecutive values and the same x value for each column of a block\n"
+	"__kernel void kernelSpmvBSR(uint blockRows, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global uint *row_ptr, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	uint br = get_global_id(0) / BS;\n"
+	"	uint i = get_global_id(0) % BS;\n"
+	"\n"
+	"	if( br < blockRows )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_end = row_ptr[br+1];\n"
+	"\n"
+	"		for(uint k = row_ptr[br]; k < row_end; k++)\n"
+	"		{\n"
+	"			const __global float *blk = values + k * (BS * BS) + i;\n"
+	"			const __global float *xb = x + col_ind[k] * BS;\n"
+	"\n"
+	"			// BS is a build option, the loop is fully unrolled\n"
+	"			for(uint j = 0; j < BS; j++)\n"
+	"				dot += blk[j * BS] * xb[j];\n"
+	"		}\n"
+	"\n"
+	"		// y is padded to whole blocks\n"
+	"		y[get_global_id(0)] = dot;\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, BSR method.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvBSR(const MatrixBSR *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "BSR method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// x padded to whole blocks, so the kernel has no tail to handle
+	std::vector<float> x((size_t) m->blockCols * m->bs + 1, 0.0f);
+	std::copy(v->data, v->data + m->w, x.begin());
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		// one program per block size
+		std::ostringstream options;
+		options << "-D BS=" << m->bs;
+		cl::Program program = buildProgram(kernelSpmvBSR_source, options.str());
+		cl::Kernel kernel(program, "kernelSpmvBSR");
+
+		// allocate global memory on GPU
+		size_t blocksNbr = m->blocksNbr ? m->blocksNbr : 1;
+		size_t valuesSizeInBytes = blocksNbr * m->bs * m->bs * sizeof(float);
+		size_t col_indSizeInBytes = blocksNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->blockRows + 1) * sizeof(uint);
+		size_t xSizeInBytes = x.size() * sizeof(float);
+		size_t mvSizeInBytes = ((size_t) m->blockRows * m->bs + 1) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuX = acquireBuffer(CL_MEM_READ_ONLY, xSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->blocksNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->blocksNbr * m->bs * m->bs * sizeof(float), m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, (size_t) m->blocksNbr * sizeof(uint), m->col_ind);
+		}
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuX, CL_TRUE, 0, xSizeInBytes, &x[0]);
+
+		// set workgroup and grid size, a multiple of BS
+		size_t work_group_size = (256 / m->bs) * m->bs;
+		size_t global_work_size = (((size_t) m->blockRows * m->bs + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->blockRows);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuX);
+		kernel.setArg(5, gpuMV);
+
+		// run kernel
+		top(1);
+		if( m->blockRows )
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory, padding rows are dropped
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, (size_t) m->h * sizeof(float), mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuX);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %dx%d blocks computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, m->bs, m->bs, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
@@ -0,0 +1,251 @@
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+#include<vector>
+
+#include<unistd.h>
+
+#include"tools.h"
+#include"spmv_colblock.h"
+
+
+/**
+  Strip width whose x segment fills half of the L2 cache of the host.
+*/
+uint cpuStripWidth()
+{
+	long l2Size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	l2Size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	if( l2Size <= 0 )
+		l2Size = 256 * 1024;
+
+	// the other half holds the values and indices streamed through
+	return (uint) (l2Size / 2 / sizeof(float));
+}
+
+
+/**
+  Count the values and the non empty rows of each strip in rows [r0, r1[.
+  lastRow holds, for each strip, the last row counted plus one.
+*/
+static void countTiles(const MatrixCSR *m, uint stripWidth, uint r0, uint r1,
+	std::vector<uint> &nz, std::vector<uint> &rows, std::vector<uint> &lastRow)
+{
+	std::fill(nz.begin(), nz.end(), 0);
+	std::fill(rows.begin(), rows.end(), 0);
+	std::fill(lastRow.begin(), lastRow.end(), 0);
+	for(uint r = r0; r < r1; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			uint s = m->col_ind[i] / stripWidth;
+			nz[s]++;
+			if( lastRow[s] != r + 1 )
+			{
+				rows[s]++;
+				lastRow[s] = r + 1;
+			}
+		}
+	}
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSRColBlocked.
+*/
+MatrixCSRColBlocked* csrToColBlocked(const MatrixCSR *m, uint stripWidth, uint blockRows)
+{
+	if( stripWidth == 0 || blockRows == 0 )
+		throw std::runtime_error("Failed to split matrix in strips, null strip width or block height.");
+
+	MatrixCSRColBlocked *b = (MatrixCSRColBlocked*) malloc(sizeof(MatrixCSRColBlocked));
+	if( ! b )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	b->w = m->w;
+	b->h = m->h;
+	b->nzNbr = m->nzNbr;
+	b->stripWidth = stripWidth;
+	b->stripsNbr = std::max((m->w + stripWidth - 1) / stripWidth, 1u);
+	b->blockRows = blockRows;
+	b->blocksNbr = (uint) (((size_t) m->h + blockRows - 1) / blockRows);
+
+	// count tiles, rows and values of each block
+	std::vector<uint> blockTiles(b->blocksNbr + 1, 0);
+	std::vector<uint> blockRowsNbr(b->blocksNbr + 1, 0);
+	#pragma omp parallel
+	{
+		std::vector<uint> nz(b->stripsNbr), rows(b->stripsNbr), lastRow(b->stripsNbr);
+
+		#pragma omp for schedule(dynamic)
+		for(long k = 0; k < (long) b->blocksNbr; k++)
+		{
+			uint r0 = (uint) k * blockRows;
+			countTiles(m, stripWidth, r0, std::min(r0 + blockRows, m->h), nz, rows, lastRow);
+			for(uint s = 0; s < b->stripsNbr; s++)
+			{
+				blockTiles[k + 1] += (nz[s] > 0);
+				blockRowsNbr[k + 1] += rows[s];
+			}
+		}
+	}
+	for(uint k = 0; k < b->blocksNbr; k++)
+	{
+		blockTiles[k + 1] += blockTiles[k];
+		blockRowsNbr[k + 1] += blockRowsNbr[k];
+	}
+	b->tilesNbr = blockTiles[b->blocksNbr];
+	b->rowsNbr = blockRowsNbr[b->blocksNbr];
+
+	b->tile_ptr = (uint*) malloc(((size_t) b->blocksNbr + 1) * sizeof(uint));
+	b->tile_strip = (uint*) malloc(std::max(b->tilesNbr, 1u) * sizeof(uint));
+	b->tile_row_ptr = (uint*) malloc(((size_t) b->tilesNbr + 1) * sizeof(uint));
+	b->row_ind = (uint*) malloc(std::max(b->rowsNbr, 1u) * sizeof(uint));
+	b->row_ptr = (uint*) malloc(((size_t) b->rowsNbr + 1) * sizeof(uint));
+	b->data = (float*) malloc((size_t) m->nzNbr * sizeof(float));
+	b->col_ind = (uint*) malloc((size_t) m->nzNbr * sizeof(uint));
+	if( ! b->tile_ptr || ! b->tile_strip || ! b->tile_row_ptr || ! b->row_ind || ! b->row_ptr
+		|| (m->nzNbr && (! b->data || ! b->col_ind)) )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	std::copy(blockTiles.begin(), blockTiles.end(), b->tile_ptr);
+	b->tile_row_ptr[b->tilesNbr] = b->rowsNbr;
+	b->row_ptr[b->rowsNbr] = m->nzNbr;
+
+	// fill, tiles of a block in strip order, rows of a tile in row order,
+	// columns need not be sorted
+	#pragma omp parallel
+	{
+		std::vector<uint> nz(b->stripsNbr), rows(b->stripsNbr), lastRow(b->stripsNbr);
+		std::vector<uint> rowPos(b->stripsNbr), valuePos(b->stripsNbr);
+
+		#pragma omp for schedule(dynamic)
+		for(long k = 0; k < (long) b->blocksNbr; k++)
+		{
+			uint r0 = (uint) k * blockRows;
+			uint r1 = std::min(r0 + blockRows, m->h);
+			countTiles(m, stripWidth, r0, r1, nz, rows, lastRow);
+
+			uint t = blockTiles[k];
+			uint rowSum = blockRowsNbr[k];
+			uint valueSum = m->row_ptr[r0];
+			for(uint s = 0; s < b->stripsNbr; s++)
+			{
+				if( ! nz[s] )
+					continue;
+				b->tile_strip[t] = s;
+				b->tile_row_ptr[t] = rowSum;
+				rowPos[s] = rowSum;
+				valuePos[s] = valueSum;
+				rowSum += rows[s];
+				valueSum += nz[s];
+				t++;
+			}
+
+			std::fill(lastRow.begin(), lastRow.end(), 0);
+			for(uint r = r0; r < r1; r++)
+			{
+				for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+				{
+					uint s = m->col_ind[i] / stripWidth;
+					if( lastRow[s] != r + 1 )
+					{
+						uint e = rowPos[s]++;
+						b->row_ind[e] = r - r0;
+						b->row_ptr[e] = valuePos[s];
+						lastRow[s] = r + 1;
+					}
+					uint p = valuePos[s]++;
+					b->data[p] = m->data[i];
+					b->col_ind[p] = m->col_ind[i] - s * stripWidth;
+				}
+			}
+		}
+	}
+
+	return b;
+}
+
+
+/**
+  Destroy a MatrixCSRColBlocked structure.
+*/
+void deleteMatrixCSRColBlocked(MatrixCSRColBlocked **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->tile_ptr);
+	free((*m)->tile_strip);
+	free((*m)->tile_row_ptr);
+	free((*m)->row_ind);
+	free((*m)->row_ptr);
+	free((*m)->data);
+	free((*m)->col_ind);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Compute MxV on CPU, strip by strip on blocks of rows.
+*/
+Matrix* cpuSpmvCSRColBlocked(const MatrixCSRColBlocked *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR column blocked method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+	float *y = mv->data;
+
+	top(0);
+
+	#pragma omp parallel for schedule(dynamic)
+	for(long k = 0; k < (long) m->blocksNbr; k++)
+	{
+		uint r0 = (uint) k * m->blockRows;
+		uint r1 = std::min(r0 + m->blockRows, m->h);
+		float *yb = y + r0;
+		for(uint r = r0; r < r1; r++)
+			y[r] = 0.0f;
+
+		for(uint t = m->tile_ptr[k]; t < m->tile_ptr[k+1]; t++)
+		{
+			// x segment of the strip, reused by all the rows of the tile
+			const float *x = v->data + (size_t) m->tile_strip[t] * m->stripWidth;
+
+			for(uint e = m->tile_row_ptr[t]; e < m->tile_row_ptr[t+1]; e++)
+			{
+				float dot = 0.0f;
+				uint row_end = m->row_ptr[e+1];
+
+				#pragma omp simd reduction(+:dot)
+				for(uint i = m->row_ptr[e]; i < row_end; i++)
+					dot += m->data[i] * x[m->col_ind[i]];
+
+				yb[m->row_ind[e]] += dot;
+			}
+		}
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
@@ -0,0 +1,93 @@
+#ifndef __SPMV_COLBLOCK_H__
+#define __SPMV_COLBLOCK_H__
+
+#include"common.h"
+
+
+/**
+  Rows of a block on CPU and on GPU: the x segment of a strip is loaded once
+  for all the rows of a block. On GPU, the partial sums of the rows of a
+  block are kept in local memory.
+*/
+#define COLBLOCK_CPU_ROWS 2048
+#define COLBLOCK_GPU_ROWS 1024
+
+/**
+  Work groups sharing the local memory of a compute unit on GPU.
+*/
+#define COLBLOCK_GPU_GROUPS 4
+
+
+/**
+  CSR matrix split in vertical strips of stripWidth columns and in blocks of
+  blockRows rows. Values of a strip only read a segment of x small enough to
+  stay in cache (CPU) or in local memory (GPU).
+  Only non empty tiles (block, strip) are stored, block by block, each one
+  with the list of its non empty rows, so narrow strips and long blocks cost
+  no pointer for the empty rows.
+*/
+typedef struct matrixCSRColBlocked
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non-zero values
+	uint stripWidth; // number of columns of a strip
+	uint stripsNbr; // number of strips
+	uint blockRows; // number of rows of a block
+	uint blocksNbr; // number of blocks
+	uint tilesNbr; // number of non empty tiles
+	uint rowsNbr; // number of non empty rows of all the tiles
+	uint *tile_ptr; // array of pointers to the tiles of each block, blocksNbr+1
+	uint *tile_strip; // array of strip of each tile
+	uint *tile_row_ptr; // array of pointers to the rows of each tile, tilesNbr+1
+	uint *row_ind; // array of row index in the block
+	uint *row_ptr; // array of pointers to the values of each row, rowsNbr+1
+	float *data; // array of non zero values, tile by tile
+	uint *col_ind; // array of column index in the strip
+} MatrixCSRColBlocked;
+
+
+/**
+  Strip width whose x segment fills half of the L2 cache of the host.
+*/
+uint cpuStripWidth();
+
+/**
+  Strip width whose x segment, with the partial sums of COLBLOCK_GPU_ROWS
+  rows, fills the share of local memory of one of COLBLOCK_GPU_GROUPS work
+  groups.
+*/
+uint gpuStripWidth();
+
+/**
+  Convert a MatrixCSR to a MatrixCSRColBlocked with strips of stripWidth
+  columns and blocks of blockRows rows.
+  Memory must be deallocated by user by calling deleteMatrixCSRColBlocked().
+*/
+MatrixCSRColBlocked* csrToColBlocked(const MatrixCSR *m, uint stripWidth, uint blockRows);
+
+/**
+  Destroy a MatrixCSRColBlocked structure.
+*/
+void deleteMatrixCSRColBlocked(MatrixCSRColBlocked **m);
+
+
+/**
+  Compute MxV on CPU, tile by tile on blocks of rows: each thread computes
+  a block of rows, reading one x segment at a time for the whole block.
+  Multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCSRColBlocked(const MatrixCSRColBlocked *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, one block per work group. Work groups load the x
+  segment of each tile in local memory, then its rows read it from there, a
+  row per work item; partial sums stay in local memory until the last tile.
+  Strips must not be wider than gpuStripWidth() and blocks not higher than
+  COLBLOCK_GPU_ROWS.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRColBlocked(const MatrixCSRColBlocked *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
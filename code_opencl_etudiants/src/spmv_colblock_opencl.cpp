@@ -0,0 +1,223 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_colblock.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSRColBlocked_source =
+	"// one block of rows per work group, x segment of each tile staged in local\n"
+	"// memory, partial sums of the rows of the block in local memory\n"
+	"__kernel void kernelSpmvCSRColBlocked(uint rowsNbr, uint width, uint stripWidth, uint blockRows,\n"
+	"	const __global uint *tile_ptr, const __global uint *tile_strip, const __global uint *tile_row_ptr,\n"
+	"	const __global uint *row_ind, const __global uint *row_ptr,\n"
+	"	const __global float *values, const __global uint *col_ind,\n"
+	"	const __global float *v, __global float *y, __local float *xs, __local float *ys)\n"
+	"{\n"
+	"	uint block = get_group_id(0);\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint localSize = get_local_size(0);\n"
+	"	uint r0 = block * blockRows;\n"
+	"	uint blockSize = min(blockRows, rowsNbr - r0);\n"
+	"\n"
+	"	for(uint i = localId; i < blockSize; i += localSize)\n"
+	"		ys[i] = 0.0f;\n"
+	"\n"
+	"	uint tile_end = tile_ptr[block+1];\n"
+	"	for(uint t = tile_ptr[block]; t < tile_end; t++)\n"
+	"	{\n"
+	"		uint colBeg = tile_strip[t] * stripWidth;\n"
+	"		uint segSize = min(stripWidth, width - colBeg);\n"
+	"		for(uint c = localId; c < segSize; c += localSize)\n"
+	"			xs[c] = v[colBeg + c];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"		// rows of a tile are distinct, no two work items add to the same sum\n"
+	"		uint row_end = tile_row_ptr[t+1];\n"
+	"		for(uint e = tile_row_ptr[t] + localId; e < row_end; e += localSize)\n"
+	"		{\n"
+	"			float dot = 0.0f;\n"
+	"			uint value_end = row_ptr[e+1];\n"
+	"			for(uint i = row_ptr[e]; i < value_end; i++)\n"
+	"				dot += values[i] * xs[col_ind[i]];\n"
+	"			ys[row_ind[e]] += dot;\n"
+	"		}\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	for(uint i = localId; i < blockSize; i += localSize)\n"
+	"		y[r0 + i] = ys[i];\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Strip width whose x segment, with the partial sums of a block, fills the
+  share of local memory of a work group.
+*/
+uint gpuStripWidth()
+{
+	cl_ulong localMemSize = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		localMemSize = env.device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	// keep 1 KB for the kernel arguments and the compiler, and share the
+	// rest so that several work groups run together on a compute unit
+	cl_ulong groupMemSize = (localMemSize - std::min(localMemSize, (cl_ulong) 1024)) / COLBLOCK_GPU_GROUPS;
+	cl_ulong sumsSize = COLBLOCK_GPU_ROWS * sizeof(float);
+	if( groupMemSize <= sumsSize )
+		throw std::runtime_error("Failed to split matrix in strips, not enough local memory.");
+
+	return (uint) ((groupMemSize - sumsSize) / sizeof(float));
+}
+
+
+/**
+  Compute MxV on GPU, column blocked CSR.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRColBlocked(const MatrixCSRColBlocked *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR column blocked method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+	if(m->stripWidth > gpuStripWidth() || m->blockRows > COLBLOCK_GPU_ROWS)
+		throw std::runtime_error("Failed to multiply matrices, tiles are too large for local memory.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvCSRColBlocked_source);
+		cl::Kernel kernel(program, "kernelSpmvCSRColBlocked");
+
+		// allocate global memory on GPU
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		size_t tile_ptrSizeInBytes = ((size_t) m->blocksNbr + 1) * sizeof(uint);
+		size_t tile_stripSizeInBytes = (size_t) std::max(m->tilesNbr, 1u) * sizeof(uint);
+		size_t tile_row_ptrSizeInBytes = ((size_t) m->tilesNbr + 1) * sizeof(uint);
+		size_t row_indSizeInBytes = (size_t) std::max(m->rowsNbr, 1u) * sizeof(uint);
+		size_t row_ptrSizeInBytes = ((size_t) m->rowsNbr + 1) * sizeof(uint);
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) std::max(m->h, 1u) * sizeof(float);
+		cl::Buffer gpuTile_ptr = acquireBuffer(CL_MEM_READ_ONLY, tile_ptrSizeInBytes);
+		cl::Buffer gpuTile_strip = acquireBuffer(CL_MEM_READ_ONLY, tile_stripSizeInBytes);
+		cl::Buffer gpuTile_row_ptr = acquireBuffer(CL_MEM_READ_ONLY, tile_row_ptrSizeInBytes);
+		cl::Buffer gpuRow_ind = acquireBuffer(CL_MEM_READ_ONLY, row_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		queue.enqueueWriteBuffer(gpuTile_ptr, CL_TRUE, 0, tile_ptrSizeInBytes, m->tile_ptr);
+		queue.enqueueWriteBuffer(gpuTile_row_ptr, CL_TRUE, 0, tile_row_ptrSizeInBytes, m->tile_row_ptr);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		if( m->tilesNbr )
+		{
+			queue.enqueueWriteBuffer(gpuTile_strip, CL_TRUE, 0, (size_t) m->tilesNbr * sizeof(uint), m->tile_strip);
+			queue.enqueueWriteBuffer(gpuRow_ind, CL_TRUE, 0, (size_t) m->rowsNbr * sizeof(uint), m->row_ind);
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(float), m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(uint), m->col_ind);
+		}
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size, one work group per block
+		size_t work_group_size = std::min((size_t) 256, env.device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+		size_t global_work_size = (size_t) std::max(m->blocksNbr, 1u) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, m->w);
+		kernel.setArg(2, m->stripWidth);
+		kernel.setArg(3, m->blockRows);
+		kernel.setArg(4, gpuTile_ptr);
+		kernel.setArg(5, gpuTile_strip);
+		kernel.setArg(6, gpuTile_row_ptr);
+		kernel.setArg(7, gpuRow_ind);
+		kernel.setArg(8, gpuRow_ptr);
+		kernel.setArg(9, gpuValues);
+		kernel.setArg(10, gpuCol_ind);
+		kernel.setArg(11, gpuV);
+		kernel.setArg(12, gpuMV);
+		kernel.setArg(13, sizeof(float) * std::min(m->stripWidth, std::max(m->w, 1u)), NULL);
+		kernel.setArg(14, sizeof(float) * std::min(m->blockRows, std::max(m->h, 1u)), NULL);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuTile_ptr);
+		releaseBuffer(gpuTile_strip);
+		releaseBuffer(gpuTile_row_ptr);
+		releaseBuffer(gpuRow_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
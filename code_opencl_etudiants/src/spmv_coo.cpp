@@ -0,0 +1,187 @@
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+#include<vector>
+
+#include<omp.h>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"matrix_market.h"
+#include"spmv_coo.h"
+
+
+/**
+  Create a COO matrix structure.
+*/
+MatrixCOO* createMatrixCOO(uint w, uint h, uint nzNbr)
+{
+	MatrixCOO *m = (MatrixCOO*) malloc(sizeof(MatrixCOO));
+	if( ! m )
+		throw std::runtime_error("Failed to allocate COO matrix.");
+
+	m->w = w;
+	m->h = h;
+	m->nzNbr = nzNbr;
+	m->data = (float*) malloc((size_t) nzNbr * sizeof(float));
+	m->row_ind = (uint*) malloc((size_t) nzNbr * sizeof(uint));
+	m->col_ind = (uint*) malloc((size_t) nzNbr * sizeof(uint));
+	if( nzNbr && (! m->data || ! m->row_ind || ! m->col_ind) )
+		throw std::runtime_error("Failed to allocate COO matrix.");
+
+	return m;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCOO.
+*/
+MatrixCOO* csrToCOO(const MatrixCSR *m)
+{
+	MatrixCOO *c = createMatrixCOO(m->w, m->h, m->nzNbr);
+
+	std::copy(m->data, m->data + m->nzNbr, c->data);
+	std::copy(m->col_ind, m->col_ind + m->nzNbr, c->col_ind);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			c->row_ind[i] = (uint) r;
+	}
+
+	return c;
+}
+
+
+/**
+  Read a Matrix Market file in a MatrixCOO.
+*/
+MatrixCOO* readMatrixMarketCOO(const char *fileName, bool expandSymmetric)
+{
+	// the CSR reader already sorts triples by row and column in parallel
+	MatrixCSR *m = readMatrixMarket(fileName, expandSymmetric);
+	MatrixCOO *c = csrToCOO(m);
+	deleteMatrixCSR(&m);
+
+	return c;
+}
+
+
+/**
+  Destroy a MatrixCOO structure.
+*/
+void deleteMatrixCOO(MatrixCOO **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->row_ind);
+	free((*m)->col_ind);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Partial sum of a row at the border of a part of the triples.
+*/
+typedef struct rowCarry
+{
+	uint row;
+	float sum;
+} RowCarry;
+
+
+/**
+  Compute MxV on CPU, COO method.
+*/
+Matrix* cpuSpmvCOO(const MatrixCOO *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "COO method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+	const float *x = v->data;
+	float *y = mv->data;
+
+	// first and last rows of each part, a part per thread; parts without
+	// values add nothing to row 0
+	int partsNbr = omp_get_max_threads();
+	RowCarry none = {0, 0.0f};
+	std::vector<RowCarry> carries(2 * partsNbr, none);
+
+	top(0);
+
+	#pragma omp parallel
+	{
+		// rows without values stay at 0
+		#pragma omp for schedule(static)
+		for(long r = 0; r < (long) m->h; r++)
+			y[r] = 0.0f;
+
+		// parts are dealt rather than indexed by thread, all of them are
+		// summed even if there are fewer threads than parts
+		#pragma omp for schedule(static, 1)
+		for(int p = 0; p < partsNbr; p++)
+		{
+			uint beg = (uint) ((size_t) m->nzNbr * p / partsNbr);
+			uint end = (uint) ((size_t) m->nzNbr * (p + 1) / partsNbr);
+			if( beg == end )
+				continue;
+
+			RowCarry *first = &carries[2 * p];
+			RowCarry *last = &carries[2 * p + 1];
+
+			// segmented sum: a row ends when the next triple has another row,
+			// inner rows of the part are written directly
+			uint row = m->row_ind[beg];
+			float sum = 0.0f;
+			bool isFirst = true;
+			for(uint i = beg; i < end; i++)
+			{
+				if( m->row_ind[i] != row )
+				{
+					if( isFirst )
+					{
+						first->row = row;
+						first->sum = sum;
+						isFirst = false;
+					}
+					else
+						y[row] = sum;
+					row = m->row_ind[i];
+					sum = 0.0f;
+				}
+				sum += m->data[i] * x[m->col_ind[i]];
+			}
+
+			last->row = row;
+			last->sum = sum;
+		}
+	}
+
+	// rows shared by parts, in order
+	for(int i = 0; i < 2 * partsNbr; i++)
+		y[carries[i].row] += carries[i].sum;
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
@@ -0,0 +1,65 @@
+#ifndef __SPMV_COO_H__
+#define __SPMV_COO_H__
+
+#include"common.h"
+
+
+/**
+  COO matrix structure: (row, column, value) triples of non zero values,
+  sorted by row then by column.
+*/
+typedef struct matrixCOO
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non zero values
+	float *data; // array of non zero values
+	uint *row_ind; // array of row index of non zero values
+	uint *col_ind; // array of column index of non zero values
+} MatrixCOO;
+
+
+/**
+  Create a COO matrix structure. Allocate memory for nzNbr triples.
+  Memory must be deallocated by user by calling deleteMatrixCOO().
+*/
+MatrixCOO* createMatrixCOO(uint w, uint h, uint nzNbr);
+
+/**
+  Convert a MatrixCSR to a MatrixCOO, triples in the order of the CSR
+  matrix, rows being expanded in parallel.
+  Memory must be deallocated by user by calling deleteMatrixCOO().
+*/
+MatrixCOO* csrToCOO(const MatrixCSR *m);
+
+/**
+  Read a Matrix Market file in a MatrixCOO, with the same formats and
+  options as readMatrixMarket(). Triples are sorted by row and column.
+  Memory must be deallocated by user by calling deleteMatrixCOO().
+*/
+MatrixCOO* readMatrixMarketCOO(const char *fileName, bool expandSymmetric = true);
+
+/**
+  Destroy a MatrixCOO structure.
+*/
+void deleteMatrixCOO(MatrixCOO **m);
+
+
+/**
+  Compute MxV on CPU, COO method. Triples are split in equal parts, one per
+  thread, whatever the rows: each thread does a segmented sum of its part,
+  rows shared with the neighbour parts are added after the parallel loop.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCOO(const MatrixCOO *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, COO method. Each work group processes an interval of
+  triples, one per work item at a time, products being summed by a
+  segmented scan in local memory. Only the first and last rows of an
+  interval are shared, they are added with atomics.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCOO(const MatrixCOO *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,221 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_coo.h"
+#include"benchmark.h"
+
+
+// work groups per compute unit of the COO kernel
+#define COO_GROUPS_PER_CU 8
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCOO_source =
+	KERNEL_ATOMICS_SOURCE
+	"#define NO_ROW 0xffffffffu\n"
+	"\n"
+	"// end of a row in the interval, its first and last rows are shared with\n"
+	"// the neighbour intervals\n"
+	"void writeRow(uint row, float sum, uint firstRow, uint lastRow, __global float *y)\n"
+	"{\n"
+	"	if( row == firstRow || row == lastRow )\n"
+	"		atomicAddFloat(&y[row], sum);\n"
+	"	else\n"
+	"		y[row] = sum;\n"
+	"}\n"
+	"\n"
+	"// work group g sums triples [g*interval ; (g+1)*interval[, interval being a\n"
+	"// multiple of the work group size; rows and sums have one more value for\n"
+	"// the row open at the end of the previous pass\n"
+	"__kernel void kernelSpmvCOO(uint nzNbr, uint interval, const __global float *values, const __global uint *row_ind,\n"
+	"	const __global uint *col_ind, const __global float *x, __global float *y, __local uint *rows, __local float *sums)\n"
+	"{\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint localSize = get_local_size(0);\n"
+	"	uint beg = get_group_id(0) * interval;\n"
+	"	uint end = min(beg + interval, nzNbr);\n"
+	"	if( beg >= end )\n"
+	"		return;\n"
+	"\n"
+	"	uint firstRow = row_ind[beg];\n"
+	"	uint lastRow = row_ind[end - 1];\n"
+	"	if( localId == 0 )\n"
+	"		rows[localSize] = NO_ROW;\n"
+	"\n"
+	"	for(uint base = beg; base < end; base += localSize)\n"
+	"	{\n"
+	"		uint i = base + localId;\n"
+	"		uint row = NO_ROW;\n"
+	"		float sum = 0.0f;\n"
+	"		if( i < end )\n"
+	"		{\n"
+	"			row = row_ind[i];\n"
+	"			sum = values[i] * x[col_ind[i]];\n"
+	"		}\n"
+	"\n"
+	"		// the row open at the end of the previous pass goes on, or ends\n"
+	"		if( localId == 0 && rows[localSize] != NO_ROW )\n"
+	"		{\n"
+	"			if( rows[localSize] == row )\n"
+	"				sum += sums[localSize];\n"
+	"			else\n"
+	"				writeRow(rows[localSize], sums[localSize], firstRow, lastRow, y);\n"
+	"		}\n"
+	"		rows[localId] = row;\n"
+	"		sums[localId] = sum;\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"		// segmented inclusive scan, rows are sorted\n"
+	"		for(uint s = 1; s < localSize; s <<= 1)\n"
+	"		{\n"
+	"			float add = (localId >= s && rows[localId - s] == row) ? sums[localId - s] : 0.0f;\n"
+	"			barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"			sums[localId] += add;\n"
+	"			barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"		}\n"
+	"\n"
+	"		// the last work item keeps its row open for the next pass\n"
+	"		if( localId == localSize - 1 )\n"
+	"			sums[localSize] = sums[localId];\n"
+	"		else if( row != NO_ROW && rows[localId + 1] != row )\n"
+	"			writeRow(row, sums[localId], firstRow, lastRow, y);\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"		if( localId == 0 )\n"
+	"			rows[localSize] = rows[localSize - 1];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	// the row open at the end of the interval is its last row\n"
+	"	if( localId == 0 && rows[localSize] != NO_ROW )\n"
+	"		atomicAddFloat(&y[rows[localSize]], sums[localSize]);\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, COO method.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCOO(const MatrixCOO *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "COO method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvCOO_source);
+		cl::Kernel kernelZero(program, "kernelZero");
+		cl::Kernel kernel(program, "kernelSpmvCOO");
+
+		// equal intervals of triples, a few work groups per compute unit
+		size_t work_group_size = 256;
+		size_t groupsNbr = env.device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * COO_GROUPS_PER_CU;
+		groupsNbr = std::max((size_t) 1, std::min(groupsNbr, ((size_t) m->nzNbr + work_group_size - 1) / work_group_size));
+		uint interval = (uint) ((((size_t) m->nzNbr + groupsNbr - 1) / groupsNbr + work_group_size - 1) / work_group_size * work_group_size);
+
+		// allocate global memory on GPU
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(float);
+		size_t indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) (m->h ? m->h : 1) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuRow_ind = acquireBuffer(CL_MEM_READ_ONLY, indSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, indSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_READ_WRITE, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, valuesSizeInBytes, m->data);
+			queue.enqueueWriteBuffer(gpuRow_ind, CL_TRUE, 0, indSizeInBytes, m->row_ind);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, indSizeInBytes, m->col_ind);
+		}
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set grid sizes
+		size_t global_zero_size = (((size_t) m->h + work_group_size - 1) / work_group_size) * work_group_size;
+		size_t global_work_size = groupsNbr * work_group_size;
+
+		// set the arguments to our compute kernels
+		kernelZero.setArg(0, m->h);
+		kernelZero.setArg(1, gpuMV);
+		kernel.setArg(0, m->nzNbr);
+		kernel.setArg(1, interval);
+		kernel.setArg(2, gpuValues);
+		kernel.setArg(3, gpuRow_ind);
+		kernel.setArg(4, gpuCol_ind);
+		kernel.setArg(5, gpuV);
+		kernel.setArg(6, gpuMV);
+		kernel.setArg(7, sizeof(uint) * (work_group_size + 1), NULL);
+		kernel.setArg(8, sizeof(float) * (work_group_size + 1), NULL);
+
+		// run kernels, shared rows are accumulated so y must be cleared first
+		top(1);
+		if( m->h )
+			queue.enqueueNDRangeKernel(kernelZero, cl::NullRange, cl::NDRange(global_zero_size), cl::NDRange(work_group_size));
+		if( m->nzNbr )
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		if( m->h )
+			queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, (size_t) m->h * sizeof(float), mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuRow_ind);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
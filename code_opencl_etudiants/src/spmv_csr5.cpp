@@ -0,0 +1,393 @@
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include<immintrin.h>
+#endif
+
+#include"tools.h"
+#include"spmv_csr5.h"
+
+
+/**
+  Row holding value p of a CSR matrix, never an empty row.
+*/
+static inline uint rowOf(const MatrixCSR *m, uint p)
+{
+	return (uint) (std::upper_bound(m->row_ptr, m->row_ptr + m->h + 1, p) - m->row_ptr) - 1;
+}
+
+
+/**
+  Number of values per lane for a CSR matrix.
+*/
+uint csr5Sigma(const MatrixCSR *m)
+{
+	uint r = m->h ? m->nzNbr / m->h : 0;
+	return std::min(std::max(r, 4u), 32u);
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSR5.
+*/
+MatrixCSR5* csrToCSR5(const MatrixCSR *m, uint omega, uint sigma)
+{
+	if( sigma == 0 )
+		sigma = csr5Sigma(m);
+	if( omega == 0 || omega > CSR5_MAX_OMEGA || sigma > 32 )
+		throw std::runtime_error("Failed to convert matrix to CSR5, wrong tile size.");
+
+	MatrixCSR5 *c = (MatrixCSR5*) malloc(sizeof(MatrixCSR5));
+	if( ! c )
+		throw std::runtime_error("Failed to allocate CSR5 matrix.");
+
+	uint tileSize = omega * sigma;
+	uint tilesNbr = m->nzNbr / tileSize;
+	size_t valuesNbr = (size_t) tilesNbr * tileSize;
+	size_t lanesNbr = (size_t) tilesNbr * omega;
+
+	c->m = m;
+	c->omega = omega;
+	c->sigma = sigma;
+	c->tilesNbr = tilesNbr;
+	c->data = (float*) malloc(valuesNbr * sizeof(float));
+	c->col_ind = (uint*) malloc(valuesNbr * sizeof(uint));
+	c->tile_ptr = (uint*) malloc((size_t) (tilesNbr + 1) * sizeof(uint));
+	c->bit_flag = (uint*) malloc(lanesNbr * sizeof(uint));
+	c->y_offset = (uint16_t*) malloc(lanesNbr * sizeof(uint16_t));
+	c->seg_offset = (uint8_t*) malloc(lanesNbr * sizeof(uint8_t));
+	c->empty_ptr = (uint*) malloc((size_t) (tilesNbr + 1) * sizeof(uint));
+	if( (tilesNbr && (! c->data || ! c->col_ind || ! c->bit_flag || ! c->y_offset || ! c->seg_offset))
+		|| ! c->tile_ptr || ! c->empty_ptr )
+		throw std::runtime_error("Failed to allocate CSR5 matrix.");
+
+	// first row of each tile and of the tail, row start flags
+	c->empty_ptr[0] = 0;
+	c->tile_ptr[tilesNbr] = std::min(rowOf(m, (uint) valuesNbr), m->h);
+
+	#pragma omp parallel for schedule(static)
+	for(long t = 0; t < (long) tilesNbr; t++)
+	{
+		uint tileBeg = (uint) t * tileSize;
+		uint tileRow = rowOf(m, tileBeg);
+		uint lastRow = rowOf(m, tileBeg + tileSize - 1);
+		uint *flags = c->bit_flag + t * omega;
+		bool hasEmpty = false;
+		uint starts = 0;
+
+		memset(flags, 0, omega * sizeof(uint));
+		for(uint r = tileRow; r <= lastRow; r++)
+		{
+			uint p = m->row_ptr[r];
+			if( p == m->row_ptr[r+1] )
+			{
+				hasEmpty = true;
+				continue;
+			}
+			if( p >= tileBeg )
+			{
+				uint q = p - tileBeg;
+				flags[q / sigma] |= 1u << (q % sigma);
+				starts++;
+			}
+		}
+
+		c->tile_ptr[t] = tileRow | (hasEmpty ? CSR5_EMPTY_ROWS : 0);
+		c->empty_ptr[t + 1] = hasEmpty ? starts + 1 : 0;
+
+		// lane descriptors, row indices are shifted by one if the tile
+		// starts in the middle of a row
+		uint y = (m->row_ptr[tileRow] == tileBeg) ? 0 : 1;
+		for(uint j = 0; j < omega; j++)
+		{
+			c->y_offset[t * omega + j] = (uint16_t) y;
+			y += __builtin_popcount(flags[j]);
+		}
+
+		uint run = 0;
+		for(uint j = omega; j-- > 0; )
+		{
+			c->seg_offset[t * omega + j] = (uint8_t) run;
+			run = flags[j] ? 0 : run + 1;
+		}
+
+		// transpose values, lanes read consecutive values
+		for(uint j = 0; j < omega; j++)
+		{
+			for(uint i = 0; i < sigma; i++)
+			{
+				c->data[tileBeg + i * omega + j] = m->data[tileBeg + j * sigma + i];
+				c->col_ind[tileBeg + i * omega + j] = m->col_ind[tileBeg + j * sigma + i];
+			}
+		}
+	}
+
+	// rows of tiles with empty rows
+	for(uint t = 0; t < tilesNbr; t++)
+		c->empty_ptr[t + 1] += c->empty_ptr[t];
+
+	uint emptyNbr = c->empty_ptr[tilesNbr];
+	c->empty_offset = (uint*) malloc((size_t) (emptyNbr ? emptyNbr : 1) * sizeof(uint));
+	if( ! c->empty_offset )
+		throw std::runtime_error("Failed to allocate CSR5 matrix.");
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long t = 0; t < (long) tilesNbr; t++)
+	{
+		if( ! (c->tile_ptr[t] & CSR5_EMPTY_ROWS) )
+			continue;
+
+		uint tileBeg = (uint) t * tileSize;
+		uint tileRow = c->tile_ptr[t] & ~CSR5_EMPTY_ROWS;
+		uint lastRow = rowOf(m, tileBeg + tileSize - 1);
+		uint *rows = c->empty_offset + c->empty_ptr[t];
+
+		// same numbering as y_offset
+		uint k = (m->row_ptr[tileRow] == tileBeg) ? 0 : 1;
+		rows[0] = 0;
+		for(uint r = tileRow; r <= lastRow; r++)
+		{
+			uint p = m->row_ptr[r];
+			if( p != m->row_ptr[r+1] && p >= tileBeg )
+				rows[k++] = r - tileRow;
+		}
+	}
+
+	return c;
+}
+
+
+/**
+  Destroy a MatrixCSR5 structure.
+*/
+void deleteMatrixCSR5(MatrixCSR5 **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->col_ind);
+	free((*m)->tile_ptr);
+	free((*m)->bit_flag);
+	free((*m)->y_offset);
+	free((*m)->seg_offset);
+	free((*m)->empty_ptr);
+	free((*m)->empty_offset);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Row of the k-th row start of a tile.
+*/
+static inline uint tileRowIndex(const MatrixCSR5 *m, uint t, uint k)
+{
+	uint tileRow = m->tile_ptr[t] & ~CSR5_EMPTY_ROWS;
+	if( m->tile_ptr[t] & CSR5_EMPTY_ROWS )
+		return tileRow + m->empty_offset[m->empty_ptr[t] + k];
+	return tileRow + k;
+}
+
+
+/**
+  Value of lane j reaching row start k: the first one is the end of a row
+  started in a previous lane, the other ones are rows inside the lane.
+*/
+static inline void rowStart(const MatrixCSR5 *m, uint t, uint j, float acc, uint &starts, float *first, float *y)
+{
+	if( starts == 0 )
+		first[j] = acc;
+	else
+		y[tileRowIndex(m, t, m->y_offset[t * m->omega + j] + starts - 1)] = acc;
+	starts++;
+}
+
+
+/**
+  y += tile t x, y being 0 for rows of the tile.
+*/
+static void spmvTile(const MatrixCSR5 *m, uint t, const float *x, float *y)
+{
+	uint omega = m->omega;
+	uint sigma = m->sigma;
+	size_t tileBeg = (size_t) t * omega * sigma;
+	const uint *flags = m->bit_flag + t * omega;
+
+	float first[CSR5_MAX_OMEGA]; // sum before the first row start of each lane
+	float last[CSR5_MAX_OMEGA]; // sum after the last row start of each lane
+	uint starts[CSR5_MAX_OMEGA]; // number of row starts of each lane
+
+	for(uint j = 0; j < omega; j++)
+		starts[j] = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+	if( omega == 8 )
+	{
+		// one lane per float of a register, row starts handled out of the register
+		__m256i flagsV = _mm256_loadu_si256((const __m256i*) flags);
+		__m256 accV = _mm256_setzero_ps();
+
+		for(uint i = 0; i < sigma; i++)
+		{
+			// bit i of each lane's flags moved to its sign bit
+			int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_sll_epi32(flagsV, _mm_cvtsi32_si128(31 - i))));
+			if( mask )
+			{
+				_mm256_storeu_ps(last, accV);
+				for(uint j = 0; j < 8; j++)
+				{
+					if( mask & (1 << j) )
+					{
+						rowStart(m, t, j, last[j], starts[j], first, y);
+						last[j] = 0.0f;
+					}
+				}
+				accV = _mm256_loadu_ps(last);
+			}
+
+			// column indices are below 2^31, read as signed
+			__m256i cols = _mm256_loadu_si256((const __m256i*) (m->col_ind + tileBeg + i * 8));
+			__m256 xv = _mm256_i32gather_ps(x, cols, 4);
+			accV = _mm256_fmadd_ps(_mm256_loadu_ps(m->data + tileBeg + i * 8), xv, accV);
+		}
+
+		_mm256_storeu_ps(last, accV);
+	}
+	else
+#endif
+	{
+		for(uint j = 0; j < omega; j++)
+		{
+			float acc = 0.0f;
+			for(uint i = 0; i < sigma; i++)
+			{
+				if( (flags[j] >> i) & 1 )
+				{
+					rowStart(m, t, j, acc, starts[j], first, y);
+					acc = 0.0f;
+				}
+				size_t p = tileBeg + i * omega + j;
+				acc += m->data[p] * x[m->col_ind[p]];
+			}
+			last[j] = acc;
+		}
+	}
+
+	for(uint j = 0; j < omega; j++)
+	{
+		if( starts[j] == 0 )
+			first[j] = last[j];
+	}
+
+	// segmented sum: the row open at the end of a lane goes on in the
+	// following lanes without row start, and ends in the next lane
+	for(uint j = 0; j < omega; j++)
+	{
+		if( starts[j] == 0 )
+			continue;
+
+		uint s = m->seg_offset[t * omega + j];
+		float sum = last[j];
+		for(uint l = j + 1; l <= j + s; l++)
+			sum += first[l];
+
+		uint row = tileRowIndex(m, t, m->y_offset[t * omega + j] + starts[j] - 1);
+		if( j + s + 1 < omega )
+			y[row] = sum + first[j + s + 1];
+		else
+		{
+			// the row may go on in the next tiles
+			#pragma omp atomic
+			y[row] += sum;
+		}
+	}
+
+	// the tile starts in the middle of a row started in a previous tile
+	if( ! (flags[0] & 1) )
+	{
+		float sum = 0.0f;
+		for(uint l = 0; l < omega; l++)
+		{
+			sum += first[l];
+			if( starts[l] )
+				break;
+		}
+
+		uint row = m->tile_ptr[t] & ~CSR5_EMPTY_ROWS;
+		#pragma omp atomic
+		y[row] += sum;
+	}
+}
+
+
+/**
+  Compute MxV on CPU, CSR5 method.
+*/
+Matrix* cpuSpmvCSR5(const MatrixCSR5 *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR5 method on CPU";
+	const MatrixCSR *a = m->m;
+
+	if(a->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, a->h);
+	const float *x = v->data;
+	float *y = mv->data;
+
+	top(0);
+
+	#pragma omp parallel
+	{
+		// rows crossing tiles are accumulated, y starts at 0
+		#pragma omp for schedule(static)
+		for(long r = 0; r < (long) a->h; r++)
+			y[r] = 0.0f;
+
+		#pragma omp for schedule(static)
+		for(long t = 0; t < (long) m->tilesNbr; t++)
+			spmvTile(m, (uint) t, x, y);
+
+		// tail in CSR, its first row may have started in the last tile
+		uint tailBeg = m->tilesNbr * m->omega * m->sigma;
+		uint tailRow = m->tile_ptr[m->tilesNbr];
+
+		#pragma omp for schedule(dynamic, 64)
+		for(long r = tailRow; r < (long) a->h; r++)
+		{
+			float dot = 0.0f;
+			for(uint i = std::max(a->row_ptr[r], tailBeg); i < a->row_ptr[r+1]; i++)
+				dot += a->data[i] * x[a->col_ind[i]];
+
+			if( r == tailRow )
+			{
+				#pragma omp atomic
+				y[r] += dot;
+			}
+			else
+				y[r] = dot;
+		}
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %dx%d tiles computed in %f ms.\n", name, a->w, a->h, m->omega, m->sigma, cpuRunTime);
+
+	return mv;
+}
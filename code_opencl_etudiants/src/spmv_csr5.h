@@ -0,0 +1,88 @@
+#ifndef __SPMV_CSR5_H__
+#define __SPMV_CSR5_H__
+
+#include<stdint.h>
+
+#include"common.h"
+
+
+/**
+  CSR5 matrix structure. Non zero values are cut in tiles of omega x sigma
+  values, whatever the rows: tile t holds values [t*omega*sigma ; (t+1)*omega*sigma[,
+  lane j of the tile the sigma consecutive values from j*sigma. Values are
+  transposed in each tile, value i of lane j at i*omega + j, so that the
+  omega lanes read consecutive values.
+  Each lane has a descriptor: bit i of bit_flag is set if value i starts a
+  row, y_offset is the index of its first row start in the rows of the tile,
+  seg_offset the number of following lanes without any row start. Rows of a
+  tile are consecutive from tile_ptr, unless the tile has empty rows: rows
+  are then given by empty_offset.
+  Values after the last full tile, the tail, are read from the CSR matrix.
+*/
+typedef struct matrixCSR5
+{
+	const MatrixCSR *m; // CSR matrix, for row pointers and the tail
+	uint omega; // number of lanes of a tile
+	uint sigma; // number of values of a lane
+	uint tilesNbr; // number of full tiles
+	float *data; // array of values of full tiles, transposed in each tile
+	uint *col_ind; // array of column index of values of full tiles, transposed
+	uint *tile_ptr; // array of first row of each tile, CSR5_EMPTY_ROWS set if the tile has empty rows
+	uint *bit_flag; // array of row start flags of each lane
+	uint16_t *y_offset; // array of index of the first row start of each lane
+	uint8_t *seg_offset; // array of number of following lanes without row start
+	uint *empty_ptr; // array of pointers to the rows of each tile with empty rows
+	uint *empty_offset; // array of rows of tiles with empty rows, relative to tile_ptr
+} MatrixCSR5;
+
+/**
+  Flag of tile_ptr for tiles with empty rows.
+*/
+#define CSR5_EMPTY_ROWS 0x80000000u
+
+/**
+  Number of lanes of tiles: one AVX2 register of floats on CPU, one warp on
+  GPU. omega is at most CSR5_MAX_OMEGA, sigma at most 32.
+*/
+#define CSR5_CPU_OMEGA 8
+#define CSR5_GPU_OMEGA 32
+#define CSR5_MAX_OMEGA 64
+
+/**
+  Number of values per lane for a CSR matrix: the mean row length, between
+  4 and 32, so that a lane holds about one row start.
+*/
+uint csr5Sigma(const MatrixCSR *m);
+
+/**
+  Convert a MatrixCSR to a MatrixCSR5 with tiles of omega x sigma values,
+  or csr5Sigma() values per lane if sigma is 0. The CSR matrix must be kept
+  while the CSR5 one is used. Conversion is done in parallel in one pass on
+  values and rows.
+  Memory must be deallocated by user by calling deleteMatrixCSR5().
+*/
+MatrixCSR5* csrToCSR5(const MatrixCSR *m, uint omega, uint sigma = 0);
+
+/**
+  Destroy a MatrixCSR5 structure.
+*/
+void deleteMatrixCSR5(MatrixCSR5 **m);
+
+
+/**
+  Compute MxV on CPU, CSR5 method. Tiles are shared between threads, each
+  one being computed by the omega lanes of an AVX2 register when omega is 8.
+  Rows inside a tile are written directly, rows crossing tiles are
+  accumulated with atomics. Multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCSR5(const MatrixCSR5 *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, CSR5 method, one work item per lane. Partial sums of
+  the lanes are combined by a segmented sum in local memory.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSR5(const MatrixCSR5 *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,303 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_csr5.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSR5_source =
+	KERNEL_ATOMICS_SOURCE
+	"#define EMPTY_ROWS 0x80000000u\n"
+	"\n"
+	"// row of the k-th row start of tile t\n"
+	"uint tileRowIndex(uint tile_ptr, uint t, uint k, const __global uint *empty_ptr, const __global uint *empty_offset)\n"
+	"{\n"
+	"	uint tileRow = tile_ptr & ~EMPTY_ROWS;\n"
+	"	return (tile_ptr & EMPTY_ROWS) ? tileRow + empty_offset[empty_ptr[t] + k] : tileRow + k;\n"
+	"}\n"
+	"\n"
+	"// one work item per lane of a tile, OMEGA divides the work group size\n"
+	"__kernel void kernelSpmvCSR5(uint tilesNbr, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global uint *tile_ptr, const __global uint *bit_flag, const __global ushort *y_offset,\n"
+	"	const __global uchar *seg_offset, const __global uint *empty_ptr, const __global uint *empty_offset,\n"
+	"	const __global float *x, __global float *y, __local float *first)\n"
+	"{\n"
+	"	uint t = get_global_id(0) / OMEGA;\n"
+	"	uint j = get_global_id(0) % OMEGA;\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint lane = t * OMEGA + j;\n"
+	"\n"
+	"	float acc = 0.0f;\n"
+	"	uint starts = 0;\n"
+	"	uint tp = 0;\n"
+	"	uint flags = 0;\n"
+	"	first[localId] = 0.0f;\n"
+	"\n"
+	"	if( t < tilesNbr )\n"
+	"	{\n"
+	"		tp = tile_ptr[t];\n"
+	"		flags = bit_flag[lane];\n"
+	"		uint p = t * (OMEGA * SIGMA) + j;\n"
+	"\n"
+	"		// values of the lane are read with a stride of OMEGA, coalesced\n"
+	"		for(uint i = 0; i < SIGMA; i++, p += OMEGA)\n"
+	"		{\n"
+	"			if( (flags >> i) & 1 )\n"
+	"			{\n"
+	"				// the first sum ends a row started before the lane\n"
+	"				if( starts == 0 )\n"
+	"					first[localId] = acc;\n"
+	"				else\n"
+	"					y[tileRowIndex(tp, t, y_offset[lane] + starts - 1, empty_ptr, empty_offset)] = acc;\n"
+	"				acc = 0.0f;\n"
+	"				starts++;\n"
+	"			}\n"
+	"			acc += values[p] * x[col_ind[p]];\n"
+	"		}\n"
+	"\n"
+	"		if( starts == 0 )\n"
+	"			first[localId] = acc;\n"
+	"	}\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	if( t < tilesNbr )\n"
+	"	{\n"
+	"		// segmented sum, the row open at the end of the lane goes on in the\n"
+	"		// following lanes without row start and ends in the next lane\n"
+	"		if( starts > 0 )\n"
+	"		{\n"
+	"			uint s = seg_offset[lane];\n"
+	"			for(uint l = 1; l <= s; l++)\n"
+	"				acc += first[localId + l];\n"
+	"\n"
+	"			uint row = tileRowIndex(tp, t, y_offset[lane] + starts - 1, empty_ptr, empty_offset);\n"
+	"			if( j + s + 1 < OMEGA )\n"
+	"				y[row] = acc + first[localId + s + 1];\n"
+	"			else\n"
+	"				atomicAddFloat(&y[row], acc);\n"
+	"		}\n"
+	"\n"
+	"		// the tile starts in the middle of a row started in a previous tile\n"
+	"		if( j == 0 && ! (flags & 1) )\n"
+	"		{\n"
+	"			float sum = 0.0f;\n"
+	"			for(uint l = 0; l < OMEGA; l++)\n"
+	"			{\n"
+	"				sum += first[localId + l];\n"
+	"				if( bit_flag[lane + l] )\n"
+	"					break;\n"
+	"			}\n"
+	"			atomicAddFloat(&y[tp & ~EMPTY_ROWS], sum);\n"
+	"		}\n"
+	"	}\n"
+	"}\n"
+	"\n"
+	"// values after the last tile, one row per work item, value i at i - tailBeg\n"
+	"__kernel void kernelSpmvCSR5Tail(uint tailBeg, uint tailRow, uint h, const __global float *values,\n"
+	"	const __global uint *col_ind, const __global uint *row_ptr, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	uint r = tailRow + get_global_id(0);\n"
+	"	if( r < h )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"		for(uint i = max(row_ptr[r], tailBeg); i < row_end; i++)\n"
+	"			dot += values[i - tailBeg] * x[col_ind[i - tailBeg]];\n"
+	"\n"
+	"		// the first row may have started in the last tile\n"
+	"		if( r == tailRow )\n"
+	"			atomicAddFloat(&y[r], dot);\n"
+	"		else\n"
+	"			y[r] = dot;\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, CSR5 method.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSR5(const MatrixCSR5 *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR5 method on GPU";
+	const MatrixCSR *a = m->m;
+
+	if(a->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = a->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	size_t work_group_size = 256;
+	if( work_group_size % m->omega )
+		throw std::runtime_error("Failed to multiply matrices, CSR5 tile width must divide the work group size.");
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		// one program per tile size
+		std::ostringstream options;
+		options << "-D OMEGA=" << m->omega << " -D SIGMA=" << m->sigma;
+		cl::Program program = buildProgram(kernelSpmvCSR5_source, options.str());
+		cl::Kernel kernelZero(program, "kernelZero");
+		cl::Kernel kernel(program, "kernelSpmvCSR5");
+		cl::Kernel kernelTail(program, "kernelSpmvCSR5Tail");
+
+		// allocate global memory on GPU, the tail is read from the CSR arrays
+		uint tileSize = m->omega * m->sigma;
+		uint tailBeg = m->tilesNbr * tileSize;
+		uint tailRow = m->tile_ptr[m->tilesNbr];
+		size_t valuesNbr = tailBeg ? tailBeg : 1;
+		size_t lanesNbr = m->tilesNbr ? (size_t) m->tilesNbr * m->omega : 1;
+		size_t tailNbr = (a->nzNbr - tailBeg) ? a->nzNbr - tailBeg : 1;
+		size_t emptyNbr = m->empty_ptr[m->tilesNbr] ? m->empty_ptr[m->tilesNbr] : 1;
+		size_t valuesSizeInBytes = valuesNbr * sizeof(float);
+		size_t col_indSizeInBytes = valuesNbr * sizeof(uint);
+		size_t tile_ptrSizeInBytes = (size_t) (m->tilesNbr + 1) * sizeof(uint);
+		size_t bit_flagSizeInBytes = lanesNbr * sizeof(uint);
+		size_t y_offsetSizeInBytes = lanesNbr * sizeof(uint16_t);
+		size_t seg_offsetSizeInBytes = lanesNbr * sizeof(uint8_t);
+		size_t empty_offsetSizeInBytes = emptyNbr * sizeof(uint);
+		size_t tailValuesSizeInBytes = tailNbr * sizeof(float);
+		size_t tailCol_indSizeInBytes = tailNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (a->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) (a->h ? a->h : 1) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuTile_ptr = acquireBuffer(CL_MEM_READ_ONLY, tile_ptrSizeInBytes);
+		cl::Buffer gpuBit_flag = acquireBuffer(CL_MEM_READ_ONLY, bit_flagSizeInBytes);
+		cl::Buffer gpuY_offset = acquireBuffer(CL_MEM_READ_ONLY, y_offsetSizeInBytes);
+		cl::Buffer gpuSeg_offset = acquireBuffer(CL_MEM_READ_ONLY, seg_offsetSizeInBytes);
+		cl::Buffer gpuEmpty_ptr = acquireBuffer(CL_MEM_READ_ONLY, tile_ptrSizeInBytes);
+		cl::Buffer gpuEmpty_offset = acquireBuffer(CL_MEM_READ_ONLY, empty_offsetSizeInBytes);
+		cl::Buffer gpuTailValues = acquireBuffer(CL_MEM_READ_ONLY, tailValuesSizeInBytes);
+		cl::Buffer gpuTailCol_ind = acquireBuffer(CL_MEM_READ_ONLY, tailCol_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_READ_WRITE, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->tilesNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, valuesSizeInBytes, m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, col_indSizeInBytes, m->col_ind);
+			queue.enqueueWriteBuffer(gpuBit_flag, CL_TRUE, 0, bit_flagSizeInBytes, m->bit_flag);
+			queue.enqueueWriteBuffer(gpuY_offset, CL_TRUE, 0, y_offsetSizeInBytes, m->y_offset);
+			queue.enqueueWriteBuffer(gpuSeg_offset, CL_TRUE, 0, seg_offsetSizeInBytes, m->seg_offset);
+		}
+		if( m->empty_ptr[m->tilesNbr] )
+			queue.enqueueWriteBuffer(gpuEmpty_offset, CL_TRUE, 0, empty_offsetSizeInBytes, m->empty_offset);
+		if( a->nzNbr > tailBeg )
+		{
+			// tail values at the start of their buffers, indexed from tailBeg
+			queue.enqueueWriteBuffer(gpuTailValues, CL_TRUE, 0, tailValuesSizeInBytes, a->data + tailBeg);
+			queue.enqueueWriteBuffer(gpuTailCol_ind, CL_TRUE, 0, tailCol_indSizeInBytes, a->col_ind + tailBeg);
+		}
+		queue.enqueueWriteBuffer(gpuTile_ptr, CL_TRUE, 0, tile_ptrSizeInBytes, m->tile_ptr);
+		queue.enqueueWriteBuffer(gpuEmpty_ptr, CL_TRUE, 0, tile_ptrSizeInBytes, m->empty_ptr);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, a->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set grid sizes
+		size_t global_zero_size = (((size_t) a->h + work_group_size - 1) / work_group_size) * work_group_size;
+		size_t global_work_size = (((size_t) m->tilesNbr * m->omega + work_group_size - 1) / work_group_size) * work_group_size;
+		size_t global_tail_size = (((size_t) (a->h - tailRow) + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernels
+		kernelZero.setArg(0, a->h);
+		kernelZero.setArg(1, gpuMV);
+		kernel.setArg(0, m->tilesNbr);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuTile_ptr);
+		kernel.setArg(4, gpuBit_flag);
+		kernel.setArg(5, gpuY_offset);
+		kernel.setArg(6, gpuSeg_offset);
+		kernel.setArg(7, gpuEmpty_ptr);
+		kernel.setArg(8, gpuEmpty_offset);
+		kernel.setArg(9, gpuV);
+		kernel.setArg(10, gpuMV);
+		kernel.setArg(11, sizeof(float) * work_group_size, NULL);
+		kernelTail.setArg(0, tailBeg);
+		kernelTail.setArg(1, tailRow);
+		kernelTail.setArg(2, a->h);
+		kernelTail.setArg(3, gpuTailValues);
+		kernelTail.setArg(4, gpuTailCol_ind);
+		kernelTail.setArg(5, gpuRow_ptr);
+		kernelTail.setArg(6, gpuV);
+		kernelTail.setArg(7, gpuMV);
+
+		// run kernels, rows crossing tiles are accumulated so y must be cleared first
+		top(1);
+		if( a->h )
+			queue.enqueueNDRangeKernel(kernelZero, cl::NullRange, cl::NDRange(global_zero_size), cl::NDRange(work_group_size));
+		if( m->tilesNbr )
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+		if( tailRow < a->h )
+			queue.enqueueNDRangeKernel(kernelTail, cl::NullRange, cl::NDRange(global_tail_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		if( a->h )
+			queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, (size_t) a->h * sizeof(float), mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuTile_ptr);
+		releaseBuffer(gpuBit_flag);
+		releaseBuffer(gpuY_offset);
+		releaseBuffer(gpuSeg_offset);
+		releaseBuffer(gpuEmpty_ptr);
+		releaseBuffer(gpuEmpty_offset);
+		releaseBuffer(gpuTailValues);
+		releaseBuffer(gpuTailCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %dx%d tiles computed in %f ms (%f ms of pure computation).\n", name, a->w, a->h, m->omega, m->sigma, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
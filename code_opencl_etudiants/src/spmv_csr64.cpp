@@ -0,0 +1,115 @@
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_csr64.h"
+
+
+/**
+  Create a CSR matrix structure with 64 bit row pointers.
+*/
+MatrixCSR64* createMatrixCSR64(uint w, uint h, uint64_t nzNbr)
+{
+	MatrixCSR64 *m = (MatrixCSR64*) malloc(sizeof(MatrixCSR64));
+	if( ! m )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	m->w = w;
+	m->h = h;
+	m->nzNbr = nzNbr;
+	m->data = (float*) malloc(nzNbr * sizeof(float));
+	m->col_ind = (uint*) malloc(nzNbr * sizeof(uint));
+	m->row_ptr = (uint64_t*) malloc((size_t) (h + 1) * sizeof(uint64_t));
+	if( (nzNbr && (! m->data || ! m->col_ind)) || ! m->row_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	return m;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSR64.
+*/
+MatrixCSR64* csrTo64(const MatrixCSR *m)
+{
+	MatrixCSR64 *m64 = createMatrixCSR64(m->w, m->h, m->nzNbr);
+
+	#pragma omp parallel for
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		m64->data[i] = m->data[i];
+		m64->col_ind[i] = m->col_ind[i];
+	}
+
+	for(uint r = 0; r <= m->h; r++)
+		m64->row_ptr[r] = m->row_ptr[r];
+
+	return m64;
+}
+
+
+/**
+  Destroy a MatrixCSR64 structure.
+*/
+void deleteMatrixCSR64(MatrixCSR64 **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->col_ind);
+	free((*m)->row_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Compute MxV on CPU, rows of any row pointer type.
+*/
+template<typename Offset>
+Matrix* cpuSpmvCSRT(const matrixCSRT<Offset> *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = (sizeof(Offset) == 8) ? "CSR 64 bit method on CPU" : "CSR 32 bit method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+	const float *x = v->data;
+
+	top(0);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		float dot = 0.0f;
+		Offset row_end = m->row_ptr[r+1];
+
+		#pragma omp simd reduction(+:dot)
+		for(Offset i = m->row_ptr[r]; i < row_end; i++)
+			dot += m->data[i] * x[m->col_ind[i]];
+
+		mv->data[r] = dot;
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
+
+template Matrix* cpuSpmvCSRT<uint>(const matrixCSRT<uint> *m, const Matrix *v, const Matrix *reference);
+template Matrix* cpuSpmvCSRT<uint64_t>(const matrixCSRT<uint64_t> *m, const Matrix *v, const Matrix *reference);
@@ -0,0 +1,71 @@
+#ifndef __SPMV_CSR64_H__
+#define __SPMV_CSR64_H__
+
+#include<stdint.h>
+
+#include"common.h"
+
+
+/**
+  CSR matrix structure with the type of row pointers as parameter. Column
+  indices stay on 32 bits since widths are uint, only the number of non zero
+  values and the row pointers need 64 bits for more than 2^32 values.
+*/
+template<typename Offset>
+struct matrixCSRT
+{
+	uint w; // width
+	uint h; // height
+	Offset nzNbr; // number of non-zero values
+	float *data; // array of non zero values
+	uint *col_ind; // array of column index
+	Offset *row_ptr; // array of pointers to rows
+};
+
+typedef matrixCSRT<uint64_t> MatrixCSR64;
+
+/**
+  View of a MatrixCSR as a matrixCSRT<uint>, sharing its arrays.
+*/
+inline matrixCSRT<uint> csrView(const MatrixCSR *m)
+{
+	matrixCSRT<uint> view = {m->w, m->h, m->nzNbr, m->data, m->col_ind, m->row_ptr};
+	return view;
+}
+
+
+/**
+  Create a CSR matrix structure with 64 bit row pointers. Allocate memory for
+  nzNbr values and column indices, and h+1 row pointers.
+  Memory must be deallocated by user by calling deleteMatrixCSR64().
+*/
+MatrixCSR64* createMatrixCSR64(uint w, uint h, uint64_t nzNbr);
+
+/**
+  Convert a MatrixCSR to a MatrixCSR64.
+*/
+MatrixCSR64* csrTo64(const MatrixCSR *m);
+
+/**
+  Destroy a MatrixCSR64 structure.
+*/
+void deleteMatrixCSR64(MatrixCSR64 **m);
+
+
+/**
+  Compute MxV on CPU, rows of any row pointer type (instantiated for uint
+  and uint64_t), multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+template<typename Offset>
+Matrix* cpuSpmvCSRT(const matrixCSRT<Offset> *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, 32 bit column indices and 64 bit row pointers, one row
+  per warp. Matrices larger than the maximum size of a device buffer are
+  processed by blocks of rows, each block reusing the same buffers.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSR64(const MatrixCSR64 *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
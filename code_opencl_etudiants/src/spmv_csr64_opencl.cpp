@@ -0,0 +1,167 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_csr64.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSR64_source =
+	"// one row per warp, 64 bit row pointers relative to the first value of\n"
+	"// the block of rows, 32 bit column indices\n"
+	"__kernel void kernelSpmvCSR64(uint rowsNbr, ulong base, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global ulong *row_ptr, const __global float *v, __global float *y, __local float *dots)\n"
+	"{\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint r = get_global_id(0) / 32;\n"
+	"	uint lane = get_global_id(0) % 32;\n"
+	"\n"
+	"	float dot = 0.0f;\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		ulong row_end = row_ptr[r+1] - base;\n"
+	"		for(ulong i = row_ptr[r] - base + lane; i < row_end; i += 32)\n"
+	"			dot += values[i] * v[col_ind[i]];\n"
+	"	}\n"
+	"	dots[localId] = dot;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	for(uint s = 16; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( lane < s )\n"
+	"			dots[localId] += dots[localId + s];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( lane == 0 && r < rowsNbr )\n"
+	"		y[r] = dots[localId];\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, 64 bit row pointers.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSR64(const MatrixCSR64 *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR 64 bit method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvCSR64_source);
+		cl::Kernel kernel(program, "kernelSpmvCSR64");
+
+		// blocks of rows: values and row pointers of a block must fit in a buffer
+		uint64_t maxAlloc = env.device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+		uint64_t maxNz = std::min(m->nzNbr, maxAlloc / sizeof(float));
+		uint maxRows = (uint) std::min((uint64_t) m->h, maxAlloc / sizeof(uint64_t) - 1);
+
+		// allocate global memory on GPU, sized for the largest block
+		size_t valuesSizeInBytes = (size_t) std::max(maxNz, (uint64_t) 1) * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) std::max(maxNz, (uint64_t) 1) * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (maxRows + 1) * sizeof(uint64_t);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) maxRows * sizeof(float);
+		cl::Buffer gpuValues(env.context, CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind(env.context, CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr(env.context, CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV(env.context, CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV(env.context, CL_MEM_WRITE_ONLY, std::max(mvSizeInBytes, sizeof(float)));
+
+		top(0); // start time measurement
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup size, one warp of 32 work items per row
+		uint nbWarpsPerBlock = 8;
+		size_t work_group_size = 32 * nbWarpsPerBlock;
+
+		for(uint rowBeg = 0; rowBeg < m->h; )
+		{
+			// largest block starting at rowBeg that fits in the buffers
+			uint64_t base = m->row_ptr[rowBeg];
+			uint rowEnd = std::upper_bound(m->row_ptr + rowBeg, m->row_ptr + m->h + 1, base + maxNz) - m->row_ptr - 1;
+			rowEnd = std::min(rowEnd, rowBeg + maxRows);
+			if( rowEnd == rowBeg )
+				throw std::runtime_error("Failed to multiply matrices, a row does not fit in device memory.");
+
+			uint rowsNbr = rowEnd - rowBeg;
+			uint64_t nzNbr = m->row_ptr[rowEnd] - base;
+
+			// transfer the block from CPU memory to GPU memory
+			if( nzNbr )
+			{
+				queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, nzNbr * sizeof(float), m->data + base);
+				queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, nzNbr * sizeof(uint), m->col_ind + base);
+			}
+			queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, (size_t) (rowsNbr + 1) * sizeof(uint64_t), m->row_ptr + rowBeg);
+
+			// set the arguments to our compute kernel
+			kernel.setArg(0, rowsNbr);
+			kernel.setArg(1, (cl_ulong) base);
+			kernel.setArg(2, gpuValues);
+			kernel.setArg(3, gpuCol_ind);
+			kernel.setArg(4, gpuRow_ptr);
+			kernel.setArg(5, gpuV);
+			kernel.setArg(6, gpuMV);
+			kernel.setArg(7, sizeof(float) * work_group_size, NULL);
+
+			// run kernel
+			size_t global_work_size = (((size_t) rowsNbr + nbWarpsPerBlock - 1) / nbWarpsPerBlock) * work_group_size;
+			top(1);
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+			queue.finish();
+			gpuComputeTime += top(1); // pure computation duration
+
+			// transfer the block of the result from GPU memory to CPU memory
+			queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, (size_t) rowsNbr * sizeof(float), mv->data + rowBeg);
+
+			rowBeg = rowEnd;
+		}
+
+		gpuRunTime = top(0); // computation and memory transfert duration
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
@@ -0,0 +1,197 @@
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_delta.h"
+
+
+/**
+  'true' if the column at index i of row beg..end must be escaped with
+  deltas coded on codeSize bytes.
+*/
+static inline bool isEscaped(const MatrixCSR *m, uint beg, uint i, uint codeSize)
+{
+	uint escape = (codeSize == 1) ? 0xff : 0xffff;
+	return i == beg || m->col_ind[i] < m->col_ind[i-1] || m->col_ind[i] - m->col_ind[i-1] >= escape;
+}
+
+
+/**
+  Number of escaped columns in each row, esc_ptr gets the row pointers and
+  the total is returned.
+*/
+static uint countEscaped(const MatrixCSR *m, uint codeSize, uint *esc_ptr)
+{
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint n = 0;
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			n += isEscaped(m, m->row_ptr[r], i, codeSize);
+		esc_ptr[r+1] = n;
+	}
+
+	esc_ptr[0] = 0;
+	for(uint r = 0; r < m->h; r++)
+		esc_ptr[r+1] += esc_ptr[r];
+
+	return esc_ptr[m->h];
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSRDelta.
+*/
+MatrixCSRDelta* csrToDelta(const MatrixCSR *m, uint codeSize)
+{
+	MatrixCSRDelta *d = (MatrixCSRDelta*) malloc(sizeof(MatrixCSRDelta));
+	if( ! d )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	d->esc_ptr = (uint*) malloc((size_t) (m->h + 1) * sizeof(uint));
+	if( ! d->esc_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	// choose the delta size giving the smallest matrix
+	if( codeSize == 0 )
+	{
+		size_t bytes8 = (size_t) m->nzNbr + (size_t) countEscaped(m, 1, d->esc_ptr) * sizeof(uint);
+		size_t bytes16 = (size_t) m->nzNbr * 2 + (size_t) countEscaped(m, 2, d->esc_ptr) * sizeof(uint);
+		codeSize = (bytes8 <= bytes16) ? 1 : 2;
+	}
+
+	d->w = m->w;
+	d->h = m->h;
+	d->nzNbr = m->nzNbr;
+	d->codeSize = codeSize;
+	d->escNbr = countEscaped(m, codeSize, d->esc_ptr);
+	d->data = (float*) malloc((size_t) m->nzNbr * sizeof(float));
+	d->deltas = malloc((size_t) m->nzNbr * codeSize);
+	d->esc = (uint*) malloc((size_t) d->escNbr * sizeof(uint));
+	d->row_ptr = (uint*) malloc((size_t) (m->h + 1) * sizeof(uint));
+	if( (m->nzNbr && (! d->data || ! d->deltas || ! d->esc)) || ! d->row_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	memcpy(d->data, m->data, (size_t) m->nzNbr * sizeof(float));
+	memcpy(d->row_ptr, m->row_ptr, (size_t) (m->h + 1) * sizeof(uint));
+
+	uint escape = (codeSize == 1) ? 0xff : 0xffff;
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint e = d->esc_ptr[r];
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			uint code = escape;
+			if( isEscaped(m, m->row_ptr[r], i, codeSize) )
+				d->esc[e++] = m->col_ind[i];
+			else
+				code = m->col_ind[i] - m->col_ind[i-1];
+
+			if( codeSize == 1 )
+				((uint8_t*) d->deltas)[i] = (uint8_t) code;
+			else
+				((uint16_t*) d->deltas)[i] = (uint16_t) code;
+		}
+	}
+
+	return d;
+}
+
+
+/**
+  Destroy a MatrixCSRDelta structure.
+*/
+void deleteMatrixCSRDelta(MatrixCSRDelta **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->deltas);
+	free((*m)->esc);
+	free((*m)->esc_ptr);
+	free((*m)->row_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Display the bytes read per non zero value by MxV.
+*/
+void printDeltaBytes(const MatrixCSR *m, const MatrixCSRDelta *d)
+{
+	double nz = m->nzNbr ? m->nzNbr : 1;
+	double values = (double) m->nzNbr * sizeof(float);
+	double csrIndices = (double) m->nzNbr * sizeof(uint) + (double) (m->h + 1) * sizeof(uint);
+	double deltaIndices = (double) d->nzNbr * d->codeSize + (double) d->escNbr * sizeof(uint)
+		+ 2.0 * (d->h + 1) * sizeof(uint);
+
+	printf("Indices of M(%dx%d): %f bytes per non zero value with CSR, %f with %d bit deltas (%d escaped columns).\n",
+		m->w, m->h, csrIndices / nz, deltaIndices / nz, d->codeSize * 8, d->escNbr);
+	printf("Matrix of M(%dx%d): %f bytes per non zero value with CSR, %f with %d bit deltas.\n",
+		m->w, m->h, (values + csrIndices) / nz, (values + deltaIndices) / nz, d->codeSize * 8);
+}
+
+
+/**
+  y = Mx for deltas of type Code.
+*/
+template<typename Code>
+static void spmvDelta(const MatrixCSRDelta *m, const Code *deltas, Code escape, const float *x, float *y)
+{
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		const uint *esc = m->esc + m->esc_ptr[r];
+		uint col = 0;
+		float dot = 0.0f;
+
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			Code delta = deltas[i];
+			col = (delta == escape) ? *esc++ : col + delta;
+			dot += m->data[i] * x[col];
+		}
+
+		y[r] = dot;
+	}
+}
+
+
+/**
+  Compute MxV on CPU, delta encoded columns.
+*/
+Matrix* cpuSpmvCSRDelta(const MatrixCSRDelta *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR delta method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+
+	top(0);
+	if( m->codeSize == 1 )
+		spmvDelta(m, (const uint8_t*) m->deltas, (uint8_t) 0xff, v->data, mv->data);
+	else
+		spmvDelta(m, (const uint16_t*) m->deltas, (uint16_t) 0xffff, v->data, mv->data);
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
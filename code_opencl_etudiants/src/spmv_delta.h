@@ -0,0 +1,65 @@
+#ifndef __SPMV_DELTA_H__
+#define __SPMV_DELTA_H__
+
+#include<stdint.h>
+
+#include"common.h"
+
+
+/**
+  CSR matrix structure with delta encoded column indices. The column of a
+  value is coded as its distance to the previous column of the row, on 8 or
+  16 bits. The largest code is an escape: the column is then read in full
+  from an array of escaped columns. The first column of each row, its base,
+  is always escaped.
+*/
+typedef struct matrixCSRDelta
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non zero values
+	float *data; // array of non zero values
+	uint codeSize; // size of a delta in bytes, 1 or 2
+	void *deltas; // array of column deltas of non zero values, uint8_t or uint16_t
+	uint escNbr; // number of escaped columns
+	uint *esc; // array of escaped columns
+	uint *esc_ptr; // array of row pointers in the escaped columns
+	uint *row_ptr; // array of row pointers
+} MatrixCSRDelta;
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSRDelta with deltas of codeSize bytes, or
+  with the size giving the smallest matrix if codeSize is 0. Columns need
+  not be sorted, decreasing columns are escaped.
+  Memory must be deallocated by user by calling deleteMatrixCSRDelta().
+*/
+MatrixCSRDelta* csrToDelta(const MatrixCSR *m, uint codeSize = 0);
+
+/**
+  Destroy a MatrixCSRDelta structure.
+*/
+void deleteMatrixCSRDelta(MatrixCSRDelta **m);
+
+/**
+  Display the bytes read per non zero value by MxV, for the indices and in
+  total, with the CSR matrix and with the delta encoded one.
+*/
+void printDeltaBytes(const MatrixCSR *m, const MatrixCSRDelta *d);
+
+
+/**
+  Compute MxV on CPU, delta encoded columns, one row per thread iteration,
+  multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCSRDelta(const MatrixCSRDelta *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, delta encoded columns, one row per work item since
+  columns are decoded sequentially.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRDelta(const MatrixCSRDelta *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,158 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_delta.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSRDelta_source =
+	"// CODE is uchar or ushort, ESCAPE its largest value\n"
+	"// one row per work item, columns decoded sequentially\n"
+	"__kernel void kernelSpmvCSRDelta(uint rowsNbr, const __global float *values, const __global CODE *deltas,\n"
+	"	const __global uint *esc, const __global uint *esc_ptr, const __global uint *row_ptr,\n"
+	"	const __global float *v, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		uint e = esc_ptr[r];\n"
+	"		uint col = 0;\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_ptr[r]; i < row_end; i++)\n"
+	"		{\n"
+	"			CODE delta = deltas[i];\n"
+	"			col = (delta == ESCAPE) ? esc[e++] : col + delta;\n"
+	"			dot += values[i] * v[col];\n"
+	"		}\n"
+	"\n"
+	"		y[r] = dot;\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, delta encoded columns.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRDelta(const MatrixCSRDelta *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR delta method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvCSRDelta_source,
+			(m->codeSize == 1) ? "-D CODE=uchar -D ESCAPE=0xff" : "-D CODE=ushort -D ESCAPE=0xffff");
+		cl::Kernel kernel(program, "kernelSpmvCSRDelta");
+
+		// allocate global memory on GPU
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		uint escNbr = m->escNbr ? m->escNbr : 1;
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(float);
+		size_t deltasSizeInBytes = (size_t) nzNbr * m->codeSize;
+		size_t escSizeInBytes = (size_t) escNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuDeltas = acquireBuffer(CL_MEM_READ_ONLY, deltasSizeInBytes);
+		cl::Buffer gpuEsc = acquireBuffer(CL_MEM_READ_ONLY, escSizeInBytes);
+		cl::Buffer gpuEsc_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(float), m->data);
+			queue.enqueueWriteBuffer(gpuDeltas, CL_TRUE, 0, (size_t) m->nzNbr * m->codeSize, m->deltas);
+		}
+		if( m->escNbr )
+			queue.enqueueWriteBuffer(gpuEsc, CL_TRUE, 0, escSizeInBytes, m->esc);
+		queue.enqueueWriteBuffer(gpuEsc_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->esc_ptr);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = ((m->h + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuDeltas);
+		kernel.setArg(3, gpuEsc);
+		kernel.setArg(4, gpuEsc_ptr);
+		kernel.setArg(5, gpuRow_ptr);
+		kernel.setArg(6, gpuV);
+		kernel.setArg(7, gpuMV);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuDeltas);
+		releaseBuffer(gpuEsc);
+		releaseBuffer(gpuEsc_ptr);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
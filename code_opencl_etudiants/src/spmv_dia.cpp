@@ -0,0 +1,187 @@
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#include"tools.h"
+#include"spmv_dia.h"
+
+
+// rows per block of the CPU kernel, the y block stays in L1
+#define DIA_ROWS 1024
+
+
+/**
+  Flag the diagonals of a CSR matrix, diagonal of offset o at o + h - 1.
+*/
+static std::vector<unsigned char> diagonalFlags(const MatrixCSR *m)
+{
+	std::vector<unsigned char> flags((size_t) m->w + m->h, 0);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			size_t d = (size_t) m->col_ind[i] + m->h - 1 - r;
+
+			// read before writing, so that threads sharing a diagonal don't
+			// keep stealing its cache line from each other
+			unsigned char flagged;
+			#pragma omp atomic read
+			flagged = flags[d];
+			if( ! flagged )
+			{
+				#pragma omp atomic write
+				flags[d] = 1;
+			}
+		}
+	}
+
+	return flags;
+}
+
+
+/**
+  Number of distinct diagonals of a CSR matrix.
+*/
+uint countDiagonalsCSR(const MatrixCSR *m)
+{
+	std::vector<unsigned char> flags = diagonalFlags(m);
+	return (uint) std::count(flags.begin(), flags.end(), 1);
+}
+
+
+/**
+  Returns 'true' if a CSR matrix is worth converting to DIA format.
+*/
+bool isDIACandidate(const MatrixCSR *m, uint *diagsNbr)
+{
+	uint n = countDiagonalsCSR(m);
+	if( diagsNbr )
+		*diagsNbr = n;
+
+	return n <= DIA_MAX_DIAGONALS && (double) n * m->h <= DIA_MAX_FILL * m->nzNbr;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixDIA.
+*/
+MatrixDIA* csrToDIA(const MatrixCSR *m)
+{
+	std::vector<unsigned char> flags = diagonalFlags(m);
+
+	// index of each diagonal, offsets sorted
+	std::vector<int> index(flags.size(), -1);
+	std::vector<int> offsets;
+	for(size_t d = 0; d < flags.size(); d++)
+	{
+		if( flags[d] )
+		{
+			index[d] = (int) offsets.size();
+			offsets.push_back((int) ((long) d - (long) m->h + 1));
+		}
+	}
+
+	MatrixDIA *a = (MatrixDIA*) malloc(sizeof(MatrixDIA));
+	if( ! a )
+		throw std::runtime_error("Failed to allocate DIA matrix.");
+
+	a->w = m->w;
+	a->h = m->h;
+	a->diagsNbr = (uint) offsets.size();
+	a->offsets = (int*) malloc(offsets.size() * sizeof(int));
+	a->data = (float*) malloc((size_t) a->diagsNbr * m->h * sizeof(float));
+	if( a->diagsNbr && (! a->offsets || ! a->data) )
+		throw std::runtime_error("Failed to allocate DIA matrix.");
+	std::copy(offsets.begin(), offsets.end(), a->offsets);
+
+	// each row writes its own values, padding stays 0
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		for(uint d = 0; d < a->diagsNbr; d++)
+			a->data[(size_t) d * m->h + r] = 0.0f;
+
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			int d = index[(size_t) m->col_ind[i] + m->h - 1 - r];
+			a->data[(size_t) d * m->h + r] += m->data[i];
+		}
+	}
+
+	return a;
+}
+
+
+/**
+  Destroy a MatrixDIA structure.
+*/
+void deleteMatrixDIA(MatrixDIA **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->offsets);
+	free((*m)->data);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Compute MxV on CPU, DIA method.
+*/
+Matrix* cpuSpmvDIA(const MatrixDIA *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "DIA method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+	const float *x = v->data;
+	float *y = mv->data;
+
+	top(0);
+
+	#pragma omp parallel for schedule(static)
+	for(long b = 0; b < (long) m->h; b += DIA_ROWS)
+	{
+		long bEnd = std::min(b + DIA_ROWS, (long) m->h);
+		for(long r = b; r < bEnd; r++)
+			y[r] = 0.0f;
+
+		for(uint d = 0; d < m->diagsNbr; d++)
+		{
+			// rows of the block where the diagonal is in the matrix
+			long o = m->offsets[d];
+			long r0 = std::max(b, -o);
+			long r1 = std::min(bEnd, (long) m->w - o);
+			const float *values = m->data + (size_t) d * m->h;
+
+			#pragma omp simd
+			for(long r = r0; r < r1; r++)
+				y[r] += values[r] * x[r + o];
+		}
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %d diagonals computed in %f ms.\n", name, m->w, m->h, m->diagsNbr, cpuRunTime);
+
+	return mv;
+}
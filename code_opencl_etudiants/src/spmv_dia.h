@@ -0,0 +1,71 @@
+#ifndef __SPMV_DIA_H__
+#define __SPMV_DIA_H__
+
+#include"common.h"
+
+
+/**
+  DIA matrix structure: values are stored by diagonal, with the offset of
+  each diagonal (column - row). Value of row r on diagonal d is at d*h + r,
+  0 where the diagonal has no value or is out of the matrix. No column
+  index is stored.
+*/
+typedef struct matrixDIA
+{
+	uint w; // width
+	uint h; // height
+	uint diagsNbr; // number of diagonals
+	int *offsets; // array of offsets of diagonals, sorted
+	float *data; // array of values, diagsNbr * h
+} MatrixDIA;
+
+
+/**
+  A CSR matrix is stored in DIA format only if it has at most
+  DIA_MAX_DIAGONALS diagonals, and if the DIA matrix has at most
+  DIA_MAX_FILL times more values than the CSR one: it then reads no more
+  bytes than CSR, values plus column indices.
+*/
+#define DIA_MAX_DIAGONALS 64
+#define DIA_MAX_FILL 2.0f
+
+/**
+  Number of distinct diagonals of a CSR matrix holding non zero values.
+*/
+uint countDiagonalsCSR(const MatrixCSR *m);
+
+/**
+  Returns 'true' if a CSR matrix is worth converting to DIA format. If
+  diagsNbr isn't NULL, it is set to the number of diagonals of the matrix.
+*/
+bool isDIACandidate(const MatrixCSR *m, uint *diagsNbr = NULL);
+
+/**
+  Convert a MatrixCSR to a MatrixDIA.
+  Memory must be deallocated by user by calling deleteMatrixDIA().
+*/
+MatrixDIA* csrToDIA(const MatrixCSR *m);
+
+/**
+  Destroy a MatrixDIA structure.
+*/
+void deleteMatrixDIA(MatrixDIA **m);
+
+
+/**
+  Compute MxV on CPU, DIA method. Rows are processed by blocks that stay in
+  L1, each diagonal of a block is a contiguous multiply-add of values by x,
+  vectorized. Multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvDIA(const MatrixDIA *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, DIA method, one row per work item. Consecutive work
+  items read consecutive values and x values of each diagonal, offsets are
+  staged in local memory.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvDIA(const MatrixDIA *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,143 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_dia.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvDIA_source =
+	"// one row per work item, value of row r on diagonal d at d*h + r\n"
+	"__kernel void kernelSpmvDIA(uint w, uint h, uint diagsNbr, const __global int *offsets,\n"
+	"	const __global float *values, const __global float *x, __global float *y, __local int *localOffsets)\n"
+	"{\n"
+	"	// offsets are read by all work items, stage them in local memory\n"
+	"	for(uint d = get_local_id(0); d < diagsNbr; d += get_local_size(0))\n"
+	"		localOffsets[d] = offsets[d];\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < h )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		for(uint d = 0; d < diagsNbr; d++)\n"
+	"		{\n"
+	"			int c = (int) r + localOffsets[d];\n"
+	"			if( c >= 0 && c < (int) w )\n"
+	"				dot += values[d * h + r] * x[c];\n"
+	"		}\n"
+	"\n"
+	"		y[r] = dot;\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, DIA method.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvDIA(const MatrixDIA *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "DIA method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvDIA_source);
+		cl::Kernel kernel(program, "kernelSpmvDIA");
+
+		// allocate global memory on GPU
+		uint diagsNbr = m->diagsNbr ? m->diagsNbr : 1;
+		size_t offsetsSizeInBytes = (size_t) diagsNbr * sizeof(int);
+		size_t valuesSizeInBytes = (size_t) diagsNbr * (m->h ? m->h : 1) * sizeof(float);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuOffsets = acquireBuffer(CL_MEM_READ_ONLY, offsetsSizeInBytes);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->diagsNbr )
+		{
+			queue.enqueueWriteBuffer(gpuOffsets, CL_TRUE, 0, (size_t) m->diagsNbr * sizeof(int), m->offsets);
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->diagsNbr * m->h * sizeof(float), m->data);
+		}
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = (((size_t) m->h + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->w);
+		kernel.setArg(1, m->h);
+		kernel.setArg(2, m->diagsNbr);
+		kernel.setArg(3, gpuOffsets);
+		kernel.setArg(4, gpuValues);
+		kernel.setArg(5, gpuV);
+		kernel.setArg(6, gpuMV);
+		kernel.setArg(7, sizeof(int) * diagsNbr, NULL);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuOffsets);
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV with %d diagonals computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, m->diagsNbr, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
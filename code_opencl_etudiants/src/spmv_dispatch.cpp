@@ -0,0 +1,462 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+#include"benchmark.h"
+#include"csr_tools.h"
+#include"dense_gemm.h"
+#include"mult_mat_vect_opencl.h"
+#include"spmv_formats.h"
+#include"spmv_dispatch.h"
+
+
+// rows processed together by the SIMD units, a row of the CSR kernel costs
+// as much as the longest row of its warp
+#define WARP_SIZE 32
+
+// work of a COO value of HYB relative to an ELL value: 2 indices to read
+// and an atomic add
+#define HYB_COO_WORK 3
+
+// calibration matrices size
+#define CALIBRATION_SIZES_NBR 3
+#define CALIBRATION_WARMUP_RUNS 1
+#define CALIBRATION_RUNS 3
+
+
+/**
+  Name of a format, for display.
+*/
+const char* spmvFormatName(SpmvFormat format)
+{
+	static const char *names[SPMV_FORMATS_NBR] = {"csr", "csr_vect", "ell", "hyb", "dense"};
+	return (format < SPMV_FORMATS_NBR) ? names[format] : "unknown";
+}
+
+
+/**
+  Compute row length statistics of a CSR matrix.
+*/
+RowStats computeRowStats(const MatrixCSR *m)
+{
+	RowStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.w = m->w;
+	stats.h = m->h;
+	stats.nzNbr = m->nzNbr;
+	stats.density = densityCSR(m);
+	if( ! m->h )
+		return stats;
+
+	double sum2 = 0.0;
+	double csrWork = 0.0;
+	double csrVectWork = 0.0;
+	uint warpMax = 0;
+	for(uint r = 0; r < m->h; r++)
+	{
+		uint len = m->row_ptr[r+1] - m->row_ptr[r];
+		sum2 += (double) len * len;
+		stats.max = std::max(stats.max, len);
+
+		// scalar CSR: work items of a warp wait for the longest row
+		warpMax = std::max(warpMax, len);
+		if( (r + 1) % WARP_SIZE == 0 || r + 1 == m->h )
+		{
+			csrWork += (double) WARP_SIZE * warpMax;
+			warpMax = 0;
+		}
+
+		// vector CSR: a warp per row, lanes beyond the row length are idle
+		csrVectWork += (double) WARP_SIZE * std::max(1u, (len + WARP_SIZE - 1) / WARP_SIZE);
+	}
+	stats.mean = (float) ((double) m->nzNbr / m->h);
+	stats.variance = (float) std::max(0.0, sum2 / m->h - (double) stats.mean * stats.mean);
+
+	// HYB width: largest K such that at least a third of the rows (and at
+	// least 4096 rows) have K values or more, the ELL part is then mostly full
+	std::vector<uint> rowsWithLen(stats.max + 2, 0);
+	for(uint r = 0; r < m->h; r++)
+		rowsWithLen[m->row_ptr[r+1] - m->row_ptr[r]]++;
+
+	uint minRows = std::min(m->h, std::max(4096u, m->h / 3));
+	uint rowsAtLeast = 0;
+	stats.hybRowSz = 0;
+	for(uint k = stats.max; k > 0; k--)
+	{
+		rowsAtLeast += rowsWithLen[k];
+		if( rowsAtLeast >= minRows )
+		{
+			stats.hybRowSz = k;
+			break;
+		}
+	}
+	for(uint k = stats.hybRowSz + 1; k <= stats.max; k++)
+		stats.hybCooNbr += rowsWithLen[k] * (k - stats.hybRowSz);
+
+	stats.work[SPMV_CSR] = csrWork;
+	stats.work[SPMV_CSR_VECT] = csrVectWork;
+	stats.work[SPMV_ELL] = (double) m->h * stats.max;
+	stats.work[SPMV_HYB] = (double) m->h * stats.hybRowSz + (double) HYB_COO_WORK * stats.hybCooNbr;
+	stats.work[SPMV_DENSE] = (double) m->w * m->h;
+
+	return stats;
+}
+
+
+/**
+  Synthetic irregular matrix used to calibrate the sparse kernels: most rows
+  have 8 to 55 values, one row out of 256 has 512 values.
+*/
+static MatrixCSR* createCalibrationMatrix(uint n)
+{
+	uint seed = 12345;
+	std::vector<uint> rowLen(n);
+	uint nzNbr = 0;
+	for(uint r = 0; r < n; r++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		rowLen[r] = (r % 256 == 255) ? 512 : 8 + (seed >> 16) % 48;
+		nzNbr += rowLen[r];
+	}
+
+	MatrixCSR *m = createMatrixCSR(n, n, nzNbr);
+	m->row_ptr[0] = 0;
+	for(uint r = 0; r < n; r++)
+	{
+		m->row_ptr[r+1] = m->row_ptr[r] + rowLen[r];
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			m->col_ind[i] = (seed >> 8) % n;
+			m->data[i] = (float) (seed >> 16) / 65536.0f - 0.5f;
+		}
+	}
+
+	return m;
+}
+
+
+/**
+  Shortest time of a few runs of a MxV function after warm-up runs, in ms:
+  the pure computation time recorded by the GPU methods.
+*/
+template<typename M, typename F>
+static double bestSpmvTime(F spmvFunction, const M *m, const Matrix *v)
+{
+	double best = 0.0;
+	for(int i = 0; i < CALIBRATION_WARMUP_RUNS + CALIBRATION_RUNS; i++)
+	{
+		Matrix *mv = NULL;
+		double t = timeSpmv(spmvFunction, m, v, &mv);
+		deleteMatrix(&mv);
+
+		if( i == CALIBRATION_WARMUP_RUNS || (i > CALIBRATION_WARMUP_RUNS && t < best) )
+			best = t;
+	}
+	return best;
+}
+
+
+/**
+  Time elapsed since beg, in ms.
+*/
+static double elapsedMs(std::chrono::steady_clock::time_point beg)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+}
+
+
+/**
+  Least squares fit of y = slope * x.
+*/
+static double fitThroughOrigin(const std::vector<double> &x, const std::vector<double> &y)
+{
+	double sxx = 0.0, sxy = 0.0;
+	for(size_t i = 0; i < x.size(); i++)
+	{
+		sxx += x[i] * x[i];
+		sxy += x[i] * y[i];
+	}
+	return (sxx > 0.0) ? sxy / sxx : 0.0;
+}
+
+
+/**
+  Least squares fit of y = slope * x + intercept. If measurement noise gives
+  a negative intercept, the line is fitted through the origin instead.
+*/
+static void fitLine(const std::vector<double> &x, const std::vector<double> &y, double *slope, double *intercept)
+{
+	double n = (double) x.size();
+	double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+	for(size_t i = 0; i < x.size(); i++)
+	{
+		sx += x[i];
+		sy += y[i];
+		sxx += x[i] * x[i];
+		sxy += x[i] * y[i];
+	}
+
+	double det = n * sxx - sx * sx;
+	*slope = (det > 0.0) ? (n * sxy - sx * sy) / det : 0.0;
+	*intercept = (n > 0.0) ? (sy - *slope * sx) / n : 0.0;
+	if( *intercept < 0.0 )
+	{
+		*slope = fitThroughOrigin(x, y);
+		*intercept = 0.0;
+	}
+}
+
+
+/**
+  Work, kernel time and conversion time of a format measured on each
+  calibration matrix.
+*/
+typedef struct calibrationSamples
+{
+	std::vector<double> work;
+	std::vector<double> time;
+	std::vector<double> conversionTime;
+} CalibrationSamples;
+
+static void addSample(CalibrationSamples &samples, double work, double time, double conversionTime)
+{
+	samples.work.push_back(work);
+	samples.time.push_back(time);
+	samples.conversionTime.push_back(conversionTime);
+}
+
+
+/**
+  Measure the kernel and conversion times of each format on synthetic
+  matrices of several sizes, and fit the cost model to them.
+*/
+static SpmvModel calibrateSpmvModel()
+{
+	printf("Calibrating MxV cost model...\n");
+	static const uint sparseSizes[CALIBRATION_SIZES_NBR] = {4096, 8192, 16384};
+	static const uint denseSizes[CALIBRATION_SIZES_NBR] = {512, 1024, 2048};
+	CalibrationSamples samples[SPMV_FORMATS_NBR];
+
+	for(int s = 0; s < CALIBRATION_SIZES_NBR; s++)
+	{
+		MatrixCSR *m = createCalibrationMatrix(sparseSizes[s]);
+		RowStats stats = computeRowStats(m);
+		Matrix *v = createMatrix(1, m->w);
+		for(uint i = 0; i < m->w; i++)
+			v->data[i] = 1.0f;
+
+		std::chrono::steady_clock::time_point beg = std::chrono::steady_clock::now();
+		MatrixELL *ell = csrToELL(m);
+		double ellConversionTime = elapsedMs(beg);
+		beg = std::chrono::steady_clock::now();
+		MatrixHYB *hyb = csrToHYB(m, stats.hybRowSz);
+		double hybConversionTime = elapsedMs(beg);
+
+		addSample(samples[SPMV_CSR], stats.work[SPMV_CSR], bestSpmvTime(gpuSpmvCSR, m, v), 0.0);
+		addSample(samples[SPMV_CSR_VECT], stats.work[SPMV_CSR_VECT], bestSpmvTime(gpuSpmvCSRVect, m, v), 0.0);
+		addSample(samples[SPMV_ELL], stats.work[SPMV_ELL], bestSpmvTime(gpuSpmvELL, ell, v), ellConversionTime);
+		addSample(samples[SPMV_HYB], stats.work[SPMV_HYB], bestSpmvTime(gpuSpmvHYB, hyb, v), hybConversionTime);
+		deleteMatrixELL(&ell);
+		deleteMatrixHYB(&hyb);
+		deleteMatrixCSR(&m);
+		deleteMatrix(&v);
+
+		// the dense kernel doesn't depend on the values, a small sparse
+		// matrix gives its conversion time too
+		m = createCalibrationMatrix(denseSizes[s]);
+		v = createMatrix(1, m->w);
+		for(uint i = 0; i < m->w; i++)
+			v->data[i] = 1.0f;
+
+		beg = std::chrono::steady_clock::now();
+		Matrix *d = csrToMatrix(m);
+		double denseConversionTime = elapsedMs(beg);
+
+		addSample(samples[SPMV_DENSE], (double) d->w * d->h, bestSpmvTime(gpuGemv, d, v), denseConversionTime);
+		deleteMatrix(&d);
+		deleteMatrixCSR(&m);
+		deleteMatrix(&v);
+	}
+
+	SpmvModel model;
+	for(int f = 0; f < SPMV_FORMATS_NBR; f++)
+	{
+		fitLine(samples[f].work, samples[f].time, &model.coef[f], &model.base[f]);
+		model.conversionCoef[f] = fitThroughOrigin(samples[f].work, samples[f].conversionTime);
+	}
+
+	return model;
+}
+
+
+/**
+  Read a cost model saved for the given device. Returns 'true' on success.
+*/
+static bool loadSpmvModel(const char *fileName, const std::string &device, SpmvModel &model)
+{
+	FILE *f = fopen(fileName, "r");
+	if( ! f )
+		return false;
+
+	char line[256];
+	bool ok = fgets(line, sizeof(line), f) && device == std::string(line, strcspn(line, "\n"));
+	for(int i = 0; ok && i < SPMV_FORMATS_NBR; i++)
+	{
+		char name[32];
+		ok = fscanf(f, "%31s %lf %lf %lf", name, &model.coef[i], &model.base[i], &model.conversionCoef[i]) == 4
+			&& ! strcmp(name, spmvFormatName((SpmvFormat) i));
+	}
+
+	fclose(f);
+	return ok;
+}
+
+
+/**
+  Save a cost model, first line is the device name, then the coefficients
+  of each format.
+*/
+static void saveSpmvModel(const char *fileName, const std::string &device, const SpmvModel &model)
+{
+	FILE *f = fopen(fileName, "w");
+	if( ! f )
+	{
+		printf("Warning: failed to save MxV cost model in %s.\n", fileName);
+		return;
+	}
+
+	fprintf(f, "%s\n", device.c_str());
+	for(int i = 0; i < SPMV_FORMATS_NBR; i++)
+		fprintf(f, "%s %g %g %g\n", spmvFormatName((SpmvFormat) i), model.coef[i], model.base[i], model.conversionCoef[i]);
+	fclose(f);
+}
+
+
+/**
+  Return the cost model of the GPU device.
+*/
+const SpmvModel& getSpmvModel(const char *fileName)
+{
+	static bool ready = false;
+	static SpmvModel model;
+
+	if( ! ready )
+	{
+		std::string device;
+		try
+		{
+			device = getOpenCLEnv().device.getInfo<CL_DEVICE_NAME>();
+		}
+		catch( cl::Error err )
+		{
+			printOpenCLError(err);
+
+			throw std::runtime_error("Aborting.");
+		}
+
+		if( ! loadSpmvModel(fileName, device, model) )
+		{
+			model = calibrateSpmvModel();
+			saveSpmvModel(fileName, device, model);
+		}
+		ready = true;
+	}
+
+	return model;
+}
+
+
+/**
+  Predicted time of a format for a matrix, conversion included.
+*/
+double predictSpmvTime(const RowStats &stats, const SpmvModel &model, SpmvFormat format)
+{
+	return model.base[format] + (model.coef[format] + model.conversionCoef[format]) * stats.work[format];
+}
+
+
+/**
+  Predict the time of each format for a matrix and return the fastest one.
+*/
+SpmvFormat selectSpmvFormat(const RowStats &stats, const SpmvModel &model)
+{
+	SpmvFormat best = SPMV_CSR;
+	double bestTime = predictSpmvTime(stats, model, SPMV_CSR);
+
+	for(int f = SPMV_CSR_VECT; f < SPMV_FORMATS_NBR; f++)
+	{
+		// the dense matrix is only worth building for dense enough matrices
+		if( f == SPMV_DENSE && stats.density <= DENSE_DENSITY_THRESHOLD )
+			continue;
+
+		double t = predictSpmvTime(stats, model, (SpmvFormat) f);
+		if( t < bestTime )
+		{
+			best = (SpmvFormat) f;
+			bestTime = t;
+		}
+	}
+
+	return best;
+}
+
+
+/**
+  Compute MxV on GPU with the format predicted to be the fastest.
+*/
+Matrix* spmv(const MatrixCSR *m, const Matrix *v, const Matrix *reference)
+{
+	RowStats stats = computeRowStats(m);
+	const SpmvModel &model = getSpmvModel();
+	SpmvFormat format = selectSpmvFormat(stats, model);
+
+	printf("Rows of %dx%d matrix: mean %f, std dev %f, max %d values, density %f -> %s format (predicted %f ms).\n",
+		m->w, m->h, stats.mean, sqrtf(stats.variance), stats.max, stats.density,
+		spmvFormatName(format), predictSpmvTime(stats, model, format));
+
+	Matrix *mv = NULL;
+	switch( format )
+	{
+		case SPMV_CSR_VECT:
+			mv = gpuSpmvCSRVect(m, v, reference);
+			break;
+
+		case SPMV_ELL:
+		{
+			MatrixELL *ell = csrToELL(m);
+			mv = gpuSpmvELL(ell, v, reference);
+			deleteMatrixELL(&ell);
+			break;
+		}
+
+		case SPMV_HYB:
+		{
+			MatrixHYB *hyb = csrToHYB(m, stats.hybRowSz);
+			mv = gpuSpmvHYB(hyb, v, reference);
+			deleteMatrixHYB(&hyb);
+			break;
+		}
+
+		case SPMV_DENSE:
+		{
+			Matrix *d = csrToMatrix(m);
+			mv = gpuGemv(d, v, reference);
+			deleteMatrix(&d);
+			break;
+		}
+
+		default:
+			mv = gpuSpmvCSR(m, v, reference);
+			break;
+	}
+
+	return mv;
+}
@@ -0,0 +1,97 @@
+#ifndef __SPMV_DISPATCH_H__
+#define __SPMV_DISPATCH_H__
+
+#include"common.h"
+
+
+/**
+  Density above which the dense format is considered for MxV. Below, the
+  dense matrix is too large compared to the CSR one to be worth converting.
+*/
+#define DENSE_DENSITY_THRESHOLD 0.3f
+
+
+/**
+  Storage formats and GPU kernels available for MxV.
+*/
+typedef enum spmvFormat
+{
+	SPMV_CSR,       // one row per work item
+	SPMV_CSR_VECT,  // one row per warp
+	SPMV_ELL,       // rows padded to the longest one
+	SPMV_HYB,       // ELL part plus COO part for long rows
+	SPMV_DENSE,     // dense GEMV
+	SPMV_FORMATS_NBR
+} SpmvFormat;
+
+/**
+  Name of a format, for display.
+*/
+const char* spmvFormatName(SpmvFormat format);
+
+
+/**
+  Row length statistics of a CSR matrix, and the work of each kernel
+  (number of values read, counting padding and idle work items) derived
+  from them.
+*/
+typedef struct rowStats
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non zero values
+	float mean; // mean number of values per row
+	float variance; // variance of the number of values per row
+	uint max; // max number of values in a row
+	float density; // rate of non zero values
+	uint hybRowSz; // values per row in the ELL part of HYB
+	uint hybCooNbr; // values in the COO part of HYB
+	double work[SPMV_FORMATS_NBR]; // work of each kernel
+} RowStats;
+
+/**
+  Compute row length statistics of a CSR matrix, in one pass on its rows.
+*/
+RowStats computeRowStats(const MatrixCSR *m);
+
+
+/**
+  Cost model: predicted time of a format is the kernel time,
+  base[format] + coef[format] * work[format], plus the time to convert the
+  CSR matrix to the format, conversionCoef[format] * work[format].
+  Coefficients are measured once per device by calibrateSpmvModel().
+*/
+typedef struct spmvModel
+{
+	double coef[SPMV_FORMATS_NBR]; // kernel ms per unit of work
+	double base[SPMV_FORMATS_NBR]; // kernel ms whatever the work (launch)
+	double conversionCoef[SPMV_FORMATS_NBR]; // conversion ms per unit of work, 0 for CSR
+} SpmvModel;
+
+/**
+  Return the cost model of the GPU device. On first call, the model is read
+  from fileName if it was calibrated on the same device, else it is
+  calibrated by running each kernel on synthetic matrices of several sizes
+  and saved.
+*/
+const SpmvModel& getSpmvModel(const char *fileName = "spmv_model.txt");
+
+/**
+  Predicted time of a format for a matrix, conversion included, in ms.
+*/
+double predictSpmvTime(const RowStats &stats, const SpmvModel &model, SpmvFormat format);
+
+/**
+  Predict the time of each format for a matrix and return the fastest one.
+*/
+SpmvFormat selectSpmvFormat(const RowStats &stats, const SpmvModel &model);
+
+
+/**
+  Compute MxV on GPU, with the format and kernel predicted to be the fastest
+  for the matrix.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* spmv(const MatrixCSR *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,134 @@
+#include<algorithm>
+#include<stdexcept>
+
+#include"spmv_formats.h"
+
+
+/**
+  Create an ELL matrix structure.
+*/
+MatrixELL* createMatrixELL(uint w, uint h, uint nzRowSz)
+{
+	MatrixELL *m = (MatrixELL*) malloc(sizeof(MatrixELL));
+	if( ! m )
+		throw std::runtime_error("Failed to allocate ELL matrix.");
+
+	m->w = w;
+	m->h = h;
+	m->nzRowSz = nzRowSz;
+	m->data = (float*) malloc((size_t) h * nzRowSz * sizeof(float));
+	m->col_ind = (uint*) malloc((size_t) h * nzRowSz * sizeof(uint));
+	if( h && nzRowSz && (! m->data || ! m->col_ind) )
+		throw std::runtime_error("Failed to allocate ELL matrix.");
+
+	return m;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixELL.
+*/
+MatrixELL* csrToELL(const MatrixCSR *m, uint nzRowSz)
+{
+	if( nzRowSz == 0 )
+	{
+		for(uint r = 0; r < m->h; r++)
+			nzRowSz = std::max(nzRowSz, m->row_ptr[r+1] - m->row_ptr[r]);
+	}
+
+	MatrixELL *ell = createMatrixELL(m->w, m->h, nzRowSz);
+
+	#pragma omp parallel for schedule(static)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint beg = m->row_ptr[r];
+		uint len = std::min(m->row_ptr[r+1] - beg, nzRowSz);
+		for(uint k = 0; k < nzRowSz; k++)
+		{
+			size_t e = (size_t) k * m->h + r;
+			ell->data[e] = (k < len) ? m->data[beg + k] : 0.0f;
+			ell->col_ind[e] = (k < len) ? m->col_ind[beg + k] : 0;
+		}
+	}
+
+	return ell;
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixHYB.
+*/
+MatrixHYB* csrToHYB(const MatrixCSR *m, uint nzRowSz)
+{
+	MatrixHYB *hyb = (MatrixHYB*) malloc(sizeof(MatrixHYB));
+	if( ! hyb )
+		throw std::runtime_error("Failed to allocate HYB matrix.");
+
+	// csrToELL() keeps all the values when nzRowSz is 0, build an empty ELL part
+	hyb->ell = nzRowSz ? csrToELL(m, nzRowSz) : createMatrixELL(m->w, m->h, 0);
+
+	// values that do not fit in the ELL part
+	hyb->cooNbr = 0;
+	for(uint r = 0; r < m->h; r++)
+	{
+		uint len = m->row_ptr[r+1] - m->row_ptr[r];
+		if( len > nzRowSz )
+			hyb->cooNbr += len - nzRowSz;
+	}
+
+	hyb->coo_data = (float*) malloc((size_t) hyb->cooNbr * sizeof(float));
+	hyb->coo_row = (uint*) malloc((size_t) hyb->cooNbr * sizeof(uint));
+	hyb->coo_col = (uint*) malloc((size_t) hyb->cooNbr * sizeof(uint));
+	if( hyb->cooNbr && (! hyb->coo_data || ! hyb->coo_row || ! hyb->coo_col) )
+		throw std::runtime_error("Failed to allocate HYB matrix.");
+
+	uint p = 0;
+	for(uint r = 0; r < m->h; r++)
+	{
+		for(uint i = m->row_ptr[r] + nzRowSz; i < m->row_ptr[r+1]; i++, p++)
+		{
+			hyb->coo_data[p] = m->data[i];
+			hyb->coo_row[p] = r;
+			hyb->coo_col[p] = m->col_ind[i];
+		}
+	}
+
+	return hyb;
+}
+
+
+/**
+  Destroy a HYB matrix structure.
+*/
+void deleteMatrixHYB(MatrixHYB **m)
+{
+	if( ! *m )
+		return;
+
+	deleteMatrixELL(&(*m)->ell);
+	free((*m)->coo_data);
+	free((*m)->coo_row);
+	free((*m)->coo_col);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Convert a MatrixCSR to a classical Matrix.
+*/
+Matrix* csrToMatrix(const MatrixCSR *m)
+{
+	Matrix *dense = createMatrix(m->w, m->h);
+
+	#pragma omp parallel for schedule(static)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		float *row = dense->data + (size_t) r * m->w;
+		std::fill(row, row + m->w, 0.0f);
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			row[m->col_ind[i]] = m->data[i];
+	}
+
+	return dense;
+}
@@ -0,0 +1,81 @@
+#ifndef __SPMV_FORMATS_H__
+#define __SPMV_FORMATS_H__
+
+#include"common.h"
+
+
+/**
+  HYB matrix structure: the first nzRowSz values of each row in ELL format,
+  the remaining values of longer rows in COO format.
+*/
+typedef struct matrixHYB
+{
+	MatrixELL *ell; // regular part
+	uint cooNbr; // number of values in the COO part
+	float *coo_data; // array of non zero values of the COO part
+	uint *coo_row; // array of row index of the COO part
+	uint *coo_col; // array of column index of the COO part
+} MatrixHYB;
+
+
+/**
+  Create an ELL matrix structure. Allocate memory for h*nzRowSz values and
+  column indices, like matrixToELL() does.
+  Memory must be deallocated by user by calling deleteMatrixELL().
+*/
+MatrixELL* createMatrixELL(uint w, uint h, uint nzRowSz);
+
+/**
+  Convert a MatrixCSR to a MatrixELL, keeping at most nzRowSz values per row
+  (all of them if nzRowSz is 0). Values are stored column by column, value k
+  of row r at k*h + r, so that consecutive rows are read with coalesced
+  accesses. Padding values are 0 with column index 0.
+*/
+MatrixELL* csrToELL(const MatrixCSR *m, uint nzRowSz = 0);
+
+/**
+  Convert a MatrixCSR to a MatrixHYB, with nzRowSz values per row in the ELL
+  part.
+*/
+MatrixHYB* csrToHYB(const MatrixCSR *m, uint nzRowSz);
+
+/**
+  Destroy a HYB matrix structure.
+*/
+void deleteMatrixHYB(MatrixHYB **m);
+
+/**
+  Convert a MatrixCSR to a classical Matrix.
+*/
+Matrix* csrToMatrix(const MatrixCSR *m);
+
+
+/**
+  Largest ratio of stored values (rows padded to the longest one) to non zero
+  values for which ELL is used.
+*/
+#define ELL_MAX_FILL 3.0f
+
+/**
+  Returns 'true' if a CSR matrix is worth converting to ELL format for the
+  GPU: padding stays below ELL_MAX_FILL and the values fit in one device
+  buffer (CL_DEVICE_MAX_MEM_ALLOC_SIZE). Power law matrices, whose longest
+  rows are thousands of times the mean, are not. If nzRowSz isn't NULL, it
+  is set to the length of the longest row.
+*/
+bool isELLCandidate(const MatrixCSR *m, uint *nzRowSz);
+
+/**
+  Compute MxV on GPU. ELL method, one row per work item.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvELL(const MatrixELL *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU. HYB method, ELL kernel followed by a COO kernel that
+  adds the remaining values with atomics.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvHYB(const MatrixHYB *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,214 @@
+#include"opencl_tools.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_formats.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvELL_source =
+	KERNEL_ATOMICS_SOURCE
+	"// one row per work item, values stored column by column\n"
+	"__kernel void kernelSpmvELL(uint rowsNbr, uint nzRowSz, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global float *v, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		for(uint k = 0; k < nzRowSz; k++)\n"
+	"		{\n"
+	"			size_t e = (size_t) k * rowsNbr + r;\n"
+	"			dot += values[e] * v[col_ind[e]];\n"
+	"		}\n"
+	"		y[r] = dot;\n"
+	"	}\n"
+	"}\n"
+	"\n"
+	"// one COO value per work item, added to the result of the ELL part\n"
+	"__kernel void kernelSpmvCOOAdd(uint cooNbr, const __global float *values, const __global uint *row, const __global uint *col,\n"
+	"	const __global float *v, __global float *y)\n"
+	"{\n"
+	"	uint i = get_global_id(0);\n"
+	"	if( i < cooNbr )\n"
+	"		atomicAddFloat(&y[row[i]], values[i] * v[col[i]]);\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Run ELL kernel, then COO kernel if coo is not NULL.
+*/
+static Matrix* gpuSpmvELLCOO(const char *name, const MatrixELL *m, const MatrixHYB *coo, const Matrix *v, const Matrix *reference)
+{
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvELL_source);
+		cl::Kernel kernelELL(program, "kernelSpmvELL");
+		cl::Kernel kernelCOO(program, "kernelSpmvCOOAdd");
+
+		uint cooNbr = coo ? coo->cooNbr : 0;
+
+		// allocate global memory on GPU, buffers can not be empty
+		size_t ellSize = (size_t) m->h * m->nzRowSz;
+		size_t valuesSizeInBytes = (ellSize ? ellSize : 1) * sizeof(float);
+		size_t cooSizeInBytes = (cooNbr ? cooNbr : 1) * sizeof(float);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCooValues = acquireBuffer(CL_MEM_READ_ONLY, cooSizeInBytes);
+		cl::Buffer gpuCooRow = acquireBuffer(CL_MEM_READ_ONLY, cooSizeInBytes);
+		cl::Buffer gpuCooCol = acquireBuffer(CL_MEM_READ_ONLY, cooSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_READ_WRITE, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( ellSize )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, ellSize * sizeof(float), m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, ellSize * sizeof(uint), m->col_ind);
+		}
+		if( cooNbr )
+		{
+			queue.enqueueWriteBuffer(gpuCooValues, CL_TRUE, 0, cooNbr * sizeof(float), coo->coo_data);
+			queue.enqueueWriteBuffer(gpuCooRow, CL_TRUE, 0, cooNbr * sizeof(uint), coo->coo_row);
+			queue.enqueueWriteBuffer(gpuCooCol, CL_TRUE, 0, cooNbr * sizeof(uint), coo->coo_col);
+		}
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = ((m->h + work_group_size - 1) / work_group_size) * work_group_size;
+		size_t global_coo_size = ((cooNbr + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernels
+		kernelELL.setArg(0, m->h);
+		kernelELL.setArg(1, m->nzRowSz);
+		kernelELL.setArg(2, gpuValues);
+		kernelELL.setArg(3, gpuCol_ind);
+		kernelELL.setArg(4, gpuV);
+		kernelELL.setArg(5, gpuMV);
+		kernelCOO.setArg(0, cooNbr);
+		kernelCOO.setArg(1, gpuCooValues);
+		kernelCOO.setArg(2, gpuCooRow);
+		kernelCOO.setArg(3, gpuCooCol);
+		kernelCOO.setArg(4, gpuV);
+		kernelCOO.setArg(5, gpuMV);
+
+		// run kernels, COO values are added to the ELL result
+		top(1);
+		queue.enqueueNDRangeKernel(kernelELL, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+		if( cooNbr )
+			queue.enqueueNDRangeKernel(kernelCOO, cl::NullRange, cl::NDRange(global_coo_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuCooValues);
+		releaseBuffer(gpuCooRow);
+		releaseBuffer(gpuCooCol);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
+
+
+/**
+  Returns 'true' if a CSR matrix is worth converting to ELL format.
+*/
+bool isELLCandidate(const MatrixCSR *m, uint *nzRowSz)
+{
+	uint maxRow = 0;
+	for(uint r = 0; r < m->h; r++)
+		maxRow = std::max(maxRow, m->row_ptr[r+1] - m->row_ptr[r]);
+	if( nzRowSz )
+		*nzRowSz = maxRow;
+
+	cl_ulong maxAllocSize = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		maxAllocSize = env.device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	double storedNbr = (double) m->h * maxRow;
+	return storedNbr <= ELL_MAX_FILL * m->nzNbr && storedNbr * sizeof(float) <= (double) maxAllocSize;
+}
+
+
+/**
+  Compute MxV on GPU. ELL method.
+*/
+Matrix* gpuSpmvELL(const MatrixELL *m, const Matrix *v, const Matrix *reference)
+{
+	return gpuSpmvELLCOO("ELL method on GPU", m, NULL, v, reference);
+}
+
+
+/**
+  Compute MxV on GPU. HYB method.
+*/
+Matrix* gpuSpmvHYB(const MatrixHYB *m, const Matrix *v, const Matrix *reference)
+{
+	return gpuSpmvELLCOO("HYB method on GPU", m->ell, m, v, reference);
+}
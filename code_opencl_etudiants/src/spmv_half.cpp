@@ -0,0 +1,258 @@
+#include<cmath>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include<immintrin.h>
+#endif
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"spmv_half.h"
+
+
+static inline uint32_t floatBits(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static inline float bitsFloat(uint32_t u)
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+
+/**
+  float to IEEE half, rounding to nearest even, overflow to infinity.
+*/
+uint16_t floatToHalf(float f)
+{
+	uint32_t u = floatBits(f);
+	uint16_t sign = (u >> 16) & 0x8000;
+	uint32_t exp = (u >> 23) & 0xff;
+	uint32_t mant = u & 0x7fffff;
+
+	if( exp == 0xff ) // infinity or NaN, keep NaN quiet
+		return sign | 0x7c00 | (mant ? 0x200 : 0);
+
+	int e = (int) exp - 127 + 15;
+	if( e >= 31 ) // too large
+		return sign | 0x7c00;
+
+	if( e <= 0 ) // half subnormal or zero
+	{
+		if( e < -10 )
+			return sign;
+		mant |= 0x800000; // implicit bit
+		uint32_t shift = 14 - e;
+		uint32_t h = mant >> shift;
+		uint32_t rem = mant & ((1u << shift) - 1);
+		uint32_t half = 1u << (shift - 1);
+		if( rem > half || (rem == half && (h & 1)) )
+			h++;
+		return sign | h;
+	}
+
+	uint32_t h = ((uint32_t) e << 10) | (mant >> 13);
+	uint32_t rem = mant & 0x1fff;
+	if( rem > 0x1000 || (rem == 0x1000 && (h & 1)) )
+		h++; // may carry into the exponent, up to infinity, which is right
+	return sign | h;
+}
+
+
+/**
+  IEEE half to float, exact.
+*/
+float halfToFloat(uint16_t h)
+{
+	uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+
+	if( exp == 0x1f )
+		return bitsFloat(sign | 0x7f800000 | (mant << 13));
+	if( exp == 0 )
+	{
+		// subnormal: mant * 2^-24
+		float f = (float) mant * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	return bitsFloat(sign | ((exp - 15 + 127) << 23) | (mant << 13));
+}
+
+
+/**
+  float to bfloat16, rounding to nearest even.
+*/
+uint16_t floatToBF16(float f)
+{
+	uint32_t u = floatBits(f);
+	if( (u & 0x7fffffff) > 0x7f800000 ) // NaN, keep it quiet
+		return (uint16_t) ((u >> 16) | 0x40);
+	u += 0x7fff + ((u >> 16) & 1);
+	return (uint16_t) (u >> 16);
+}
+
+
+/**
+  bfloat16 to float, exact.
+*/
+float bf16ToFloat(uint16_t h)
+{
+	return bitsFloat((uint32_t) h << 16);
+}
+
+
+/**
+  Convert a MatrixCSR to a MatrixCSRHalf.
+*/
+MatrixCSRHalf* csrToHalf(const MatrixCSR *m, HalfFormat format)
+{
+	MatrixCSRHalf *hm = (MatrixCSRHalf*) malloc(sizeof(MatrixCSRHalf));
+	if( ! hm )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	hm->w = m->w;
+	hm->h = m->h;
+	hm->nzNbr = m->nzNbr;
+	hm->format = format;
+	hm->data = (uint16_t*) malloc((size_t) m->nzNbr * sizeof(uint16_t));
+	hm->col_ind = (uint*) malloc((size_t) m->nzNbr * sizeof(uint));
+	hm->row_ptr = (uint*) malloc((size_t) (m->h + 1) * sizeof(uint));
+	if( (m->nzNbr && (! hm->data || ! hm->col_ind)) || ! hm->row_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	memcpy(hm->col_ind, m->col_ind, (size_t) m->nzNbr * sizeof(uint));
+	memcpy(hm->row_ptr, m->row_ptr, (size_t) (m->h + 1) * sizeof(uint));
+
+	// fp16 range ends at 65504, larger values become infinite
+	long overflowNbr = 0;
+	#pragma omp parallel for reduction(+:overflowNbr)
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		if( format == HALF_FP16 )
+		{
+			hm->data[i] = floatToHalf(m->data[i]);
+			if( (hm->data[i] & 0x7fff) == 0x7c00 && fabsf(m->data[i]) <= 3.4e38f )
+				overflowNbr++;
+		}
+		else
+			hm->data[i] = floatToBF16(m->data[i]);
+	}
+
+	if( overflowNbr )
+		printf("Warning: %ld values are out of fp16 range and were rounded to infinity.\n", overflowNbr);
+
+	return hm;
+}
+
+
+/**
+  Destroy a MatrixCSRHalf structure.
+*/
+void deleteMatrixCSRHalf(MatrixCSRHalf **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->data);
+	free((*m)->col_ind);
+	free((*m)->row_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Relative error tolerated on a MxV result computed with 16 bit values.
+*/
+float halfTolerance(HalfFormat format)
+{
+	// about 20 units of roundoff (2^-11 for fp16, 2^-8 for bf16), leaving
+	// room for cancellation in rows with values of mixed signs
+	return (format == HALF_FP16) ? 1e-2f : 8e-2f;
+}
+
+
+/**
+  Compute MxV on CPU, 16 bit values.
+*/
+Matrix* cpuSpmvCSRHalf(const MatrixCSRHalf *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = (m->format == HALF_FP16) ? "CSR fp16 method on CPU" : "CSR bf16 method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+	const float *x = v->data;
+	bool fp16 = (m->format == HALF_FP16);
+
+	top(0);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint i = m->row_ptr[r];
+		uint row_end = m->row_ptr[r+1];
+		float dot = 0.0f;
+
+#if defined(__AVX2__) && defined(__FMA__)
+		__m256 acc = _mm256_setzero_ps();
+		for(; i + 8 <= row_end; i += 8)
+		{
+			__m128i h = _mm_loadu_si128((const __m128i*) (m->data + i));
+			__m256 a;
+			if( ! fp16 )
+				a = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+			else
+			{
+#if defined(__F16C__)
+				a = _mm256_cvtph_ps(h);
+#else
+				float tmp[8];
+				for(int k = 0; k < 8; k++)
+					tmp[k] = halfToFloat(m->data[i + k]);
+				a = _mm256_loadu_ps(tmp);
+#endif
+			}
+
+			__m256i col = _mm256_loadu_si256((const __m256i*) (m->col_ind + i));
+			acc = _mm256_fmadd_ps(a, _mm256_i32gather_ps(x, col, 4), acc);
+		}
+
+		float tmp[8];
+		_mm256_storeu_ps(tmp, acc);
+		for(int k = 0; k < 8; k++)
+			dot += tmp[k];
+#endif
+
+		for(; i < row_end; i++)
+			dot += (fp16 ? halfToFloat(m->data[i]) : bf16ToFloat(m->data[i])) * x[m->col_ind[i]];
+
+		mv->data[r] = dot;
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is accurate enough
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResultAccuracy(name, reference, mv, halfTolerance(m->format)))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
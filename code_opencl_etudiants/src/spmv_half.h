@@ -0,0 +1,77 @@
+#ifndef __SPMV_HALF_H__
+#define __SPMV_HALF_H__
+
+#include<stdint.h>
+
+#include"common.h"
+
+
+/**
+  16 bit formats available to store the values of a sparse matrix.
+  Products are always accumulated in 32 bit floats.
+*/
+typedef enum halfFormat
+{
+	HALF_FP16, // IEEE 754 half: 5 bit exponent, 10 bit mantissa
+	HALF_BF16  // bfloat16: 8 bit exponent (same range as float), 7 bit mantissa
+} HalfFormat;
+
+
+/**
+  CSR matrix structure with 16 bit values.
+*/
+typedef struct matrixCSRHalf
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non zero values
+	HalfFormat format; // storage format of values
+	uint16_t *data; // array of non zero values
+	uint *col_ind; // array of column index of non zero values
+	uint *row_ptr; // array of row pointers
+} MatrixCSRHalf;
+
+
+/**
+  Conversions between float and 16 bit formats, rounding to nearest even.
+*/
+uint16_t floatToHalf(float f);
+float halfToFloat(uint16_t h);
+uint16_t floatToBF16(float f);
+float bf16ToFloat(uint16_t h);
+
+/**
+  Convert a MatrixCSR to a MatrixCSRHalf, values are rounded to the given
+  format. Memory must be deallocated by user by calling deleteMatrixCSRHalf().
+*/
+MatrixCSRHalf* csrToHalf(const MatrixCSR *m, HalfFormat format);
+
+/**
+  Destroy a MatrixCSRHalf structure.
+*/
+void deleteMatrixCSRHalf(MatrixCSRHalf **m);
+
+
+/**
+  Compute MxV on CPU, 16 bit values. Values are converted with F16C (fp16)
+  or shifts (bf16) and x is gathered 8 values at a time with AVX2 when
+  available, multithreaded with OpenMP.
+  A reference result can be passed to check the accuracy of the result.
+*/
+Matrix* cpuSpmvCSRHalf(const MatrixCSRHalf *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, 16 bit values, one row per warp. fp16 values are read
+  with vload_half(), bf16 values are widened with a shift.
+  A reference result can be passed to check the accuracy of the result.
+*/
+Matrix* gpuSpmvCSRHalf(const MatrixCSRHalf *m, const Matrix *v, const Matrix *reference = NULL);
+
+
+/**
+  Relative error tolerated on a MxV result computed with 16 bit values,
+  measured as ||y - y_ref|| / ||y_ref||.
+*/
+float halfTolerance(HalfFormat format);
+
+#endif
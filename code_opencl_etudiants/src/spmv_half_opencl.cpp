@@ -0,0 +1,161 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"spmv_half.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSRHalf_source =
+	"// 16 bit value to float: vload_half() for fp16, needs no extension;\n"
+	"// bf16 is the upper half of a float\n"
+	"#ifdef VALUES_BF16\n"
+	"#define LOAD_VALUE(i, values) as_float((uint) values[i] << 16)\n"
+	"#else\n"
+	"#define LOAD_VALUE(i, values) vload_half(i, (const __global half *) values)\n"
+	"#endif\n"
+	"\n"
+	"// one row per warp, products accumulated in float\n"
+	"__kernel void kernelSpmvCSRHalf(uint rowsNbr, const __global ushort *values, const __global uint *col_ind,\n"
+	"	const __global uint *row_ptr, const __global float *v, __global float *y, __local float *dots)\n"
+	"{\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint r = get_global_id(0) / 32;\n"
+	"	uint lane = get_global_id(0) % 32;\n"
+	"\n"
+	"	float dot = 0.0f;\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"		for(uint i = row_ptr[r] + lane; i < row_end; i += 32)\n"
+	"			dot += LOAD_VALUE(i, values) * v[col_ind[i]];\n"
+	"	}\n"
+	"	dots[localId] = dot;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	for(uint s = 16; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( lane < s )\n"
+	"			dots[localId] += dots[localId + s];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( lane == 0 && r < rowsNbr )\n"
+	"		y[r] = dots[localId];\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, 16 bit values.
+  A reference result can be passed to check the accuracy of the result.
+*/
+Matrix* gpuSpmvCSRHalf(const MatrixCSRHalf *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = (m->format == HALF_FP16) ? "CSR fp16 method on GPU" : "CSR bf16 method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvCSRHalf_source, (m->format == HALF_BF16) ? "-D VALUES_BF16" : "");
+		cl::Kernel kernel(program, "kernelSpmvCSRHalf");
+
+		// allocate global memory on GPU, values take half the space of floats
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(uint16_t);
+		size_t col_indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(uint16_t), m->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(uint), m->col_ind);
+		}
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size, one warp of 32 work items per row
+		uint nbWarpsPerBlock = 8;
+		size_t work_group_size = 32 * nbWarpsPerBlock;
+		size_t global_work_size = ((m->h + nbWarpsPerBlock - 1) / nbWarpsPerBlock) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuV);
+		kernel.setArg(5, gpuMV);
+		kernel.setArg(6, sizeof(float) * work_group_size, NULL);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is accurate enough
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResultAccuracy(name, reference, mv, halfTolerance(m->format)))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
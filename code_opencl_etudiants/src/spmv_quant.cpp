@@ -0,0 +1,284 @@
+#include<algorithm>
+#include<cmath>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include<immintrin.h>
+#endif
+
+#include"tools.h"
+#include"spmv_quant.h"
+
+
+/**
+  Allocate a MatrixCSRQuant and copy the structure of m.
+*/
+static MatrixCSRQuant* createMatrixCSRQuant(const MatrixCSR *m, uint codeSize)
+{
+	MatrixCSRQuant *q = (MatrixCSRQuant*) malloc(sizeof(MatrixCSRQuant));
+	if( ! q )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	q->w = m->w;
+	q->h = m->h;
+	q->nzNbr = m->nzNbr;
+	q->mode = QUANT_AFFINE;
+	q->codeSize = codeSize;
+	q->offset = 0.0f;
+	q->scale = 1.0f;
+	q->dictSize = 0;
+	q->dict = NULL;
+	q->codes = malloc((size_t) m->nzNbr * codeSize);
+	q->col_ind = (uint*) malloc((size_t) m->nzNbr * sizeof(uint));
+	q->row_ptr = (uint*) malloc((size_t) (m->h + 1) * sizeof(uint));
+	if( (m->nzNbr && (! q->codes || ! q->col_ind)) || ! q->row_ptr )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+
+	memcpy(q->col_ind, m->col_ind, (size_t) m->nzNbr * sizeof(uint));
+	memcpy(q->row_ptr, m->row_ptr, (size_t) (m->h + 1) * sizeof(uint));
+
+	return q;
+}
+
+
+/**
+  Store code c of value i.
+*/
+static inline void setCode(MatrixCSRQuant *q, size_t i, uint c)
+{
+	if( q->codeSize == 1 )
+		((uint8_t*) q->codes)[i] = (uint8_t) c;
+	else
+		((uint16_t*) q->codes)[i] = (uint16_t) c;
+}
+
+
+/**
+  Try affine codes: value = offset + scale * code, with offset the smallest
+  value and scale the smallest gap to it. Every value is checked to be
+  decoded exactly, even when the product is fused with the add.
+*/
+static MatrixCSRQuant* csrToQuantAffine(const MatrixCSR *m, float vmin, float vmax)
+{
+	float step = INFINITY;
+	#pragma omp parallel for reduction(min:step)
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		float d = m->data[i] - vmin;
+		if( d > 0.0f && d < step )
+			step = d;
+	}
+	if( step == INFINITY ) // all values are equal
+		step = 1.0f;
+
+	double codesNbr = nearbyint(((double) vmax - vmin) / step) + 1.0;
+	if( codesNbr > 65536.0 )
+		return NULL;
+
+	MatrixCSRQuant *q = createMatrixCSRQuant(m, (codesNbr <= 256.0) ? 1 : 2);
+	q->offset = vmin;
+	q->scale = step;
+
+	bool exact = true;
+	#pragma omp parallel for reduction(&&:exact)
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		double c = nearbyint(((double) m->data[i] - vmin) / step);
+		double product = (double) step * c;
+		if( c < 0.0 || c >= codesNbr || (double) (float) product != product || product + vmin != (double) m->data[i] )
+			exact = false;
+		else
+			setCode(q, i, (uint) c);
+	}
+
+	if( ! exact )
+		deleteMatrixCSRQuant(&q);
+
+	return q;
+}
+
+
+/**
+  Try dictionary codes: value = dict[code], at most 65536 distinct values
+  and smaller than the float values.
+*/
+static MatrixCSRQuant* csrToQuantDict(const MatrixCSR *m)
+{
+	std::vector<float> dict(m->data, m->data + m->nzNbr);
+	std::sort(dict.begin(), dict.end());
+	dict.erase(std::unique(dict.begin(), dict.end()), dict.end());
+	uint codeSize = (dict.size() <= 256) ? 1 : 2;
+	if( dict.size() > 65536 || dict.size() * sizeof(float) + (size_t) m->nzNbr * codeSize >= (size_t) m->nzNbr * sizeof(float) )
+		return NULL; // too many values, or less compact than floats
+
+	MatrixCSRQuant *q = createMatrixCSRQuant(m, codeSize);
+	q->mode = QUANT_DICT;
+	q->dictSize = dict.size();
+	q->dict = (float*) malloc(dict.size() * sizeof(float));
+	if( ! q->dict )
+		throw std::runtime_error("Failed to allocate CSR matrix.");
+	std::copy(dict.begin(), dict.end(), q->dict);
+
+	#pragma omp parallel for
+	for(long i = 0; i < (long) m->nzNbr; i++)
+		setCode(q, i, std::lower_bound(dict.begin(), dict.end(), m->data[i]) - dict.begin());
+
+	return q;
+}
+
+
+/**
+  Try to quantize the values of a CSR matrix.
+*/
+MatrixCSRQuant* csrToQuant(const MatrixCSR *m)
+{
+	float vmin = INFINITY;
+	float vmax = -INFINITY;
+	bool finite = true;
+	#pragma omp parallel for reduction(min:vmin) reduction(max:vmax) reduction(&&:finite)
+	for(long i = 0; i < (long) m->nzNbr; i++)
+	{
+		float val = m->data[i];
+		finite = finite && std::isfinite(val);
+		vmin = std::min(vmin, val);
+		vmax = std::max(vmax, val);
+	}
+	if( ! finite )
+		return NULL;
+	if( ! m->nzNbr )
+		vmin = vmax = 0.0f;
+
+	MatrixCSRQuant *q = csrToQuantAffine(m, vmin, vmax);
+	if( ! q )
+		q = csrToQuantDict(m);
+
+	if( q )
+	{
+		printf("Values of M(%dx%d) quantized as %d bit %s codes: %lu bytes instead of %lu.\n", m->w, m->h,
+			q->codeSize * 8, (q->mode == QUANT_AFFINE) ? "affine" : "dictionary",
+			(unsigned long) q->nzNbr * q->codeSize + q->dictSize * sizeof(float), (unsigned long) q->nzNbr * sizeof(float));
+	}
+
+	return q;
+}
+
+
+/**
+  Convert a Matrix to a quantized CSR matrix.
+*/
+MatrixCSRQuant* matrixToCSRQuant(const Matrix *m)
+{
+	MatrixCSR *csr = matrixToCSR(m);
+	MatrixCSRQuant *q = csrToQuant(csr);
+	deleteMatrixCSR(&csr);
+
+	return q;
+}
+
+
+/**
+  Destroy a MatrixCSRQuant structure.
+*/
+void deleteMatrixCSRQuant(MatrixCSRQuant **m)
+{
+	if( ! *m )
+		return;
+
+	free((*m)->codes);
+	free((*m)->dict);
+	free((*m)->col_ind);
+	free((*m)->row_ptr);
+	free(*m);
+	*m = NULL;
+}
+
+
+#if defined(__AVX2__) && defined(__FMA__)
+// 8 codes widened to 32 bit integers
+static inline __m256i loadCodes(const uint8_t *c) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) c)); }
+static inline __m256i loadCodes(const uint16_t *c) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) c)); }
+#endif
+
+/**
+  y = Mx for codes of type Code.
+*/
+template<typename Code>
+static void spmvQuant(const MatrixCSRQuant *m, const Code *codes, const float *x, float *y)
+{
+	bool dict = (m->mode == QUANT_DICT);
+	float offset = m->offset;
+	float scale = m->scale;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint i = m->row_ptr[r];
+		uint row_end = m->row_ptr[r+1];
+		float dot = 0.0f;
+
+#if defined(__AVX2__) && defined(__FMA__)
+		__m256 acc = _mm256_setzero_ps();
+		__m256 vOffset = _mm256_set1_ps(offset);
+		__m256 vScale = _mm256_set1_ps(scale);
+		for(; i + 8 <= row_end; i += 8)
+		{
+			__m256i c = loadCodes(codes + i);
+			__m256 a = dict ? _mm256_i32gather_ps(m->dict, c, 4) : _mm256_fmadd_ps(vScale, _mm256_cvtepi32_ps(c), vOffset);
+			__m256i col = _mm256_loadu_si256((const __m256i*) (m->col_ind + i));
+			acc = _mm256_fmadd_ps(a, _mm256_i32gather_ps(x, col, 4), acc);
+		}
+
+		float tmp[8];
+		_mm256_storeu_ps(tmp, acc);
+		for(int k = 0; k < 8; k++)
+			dot += tmp[k];
+#endif
+
+		for(; i < row_end; i++)
+		{
+			float a = dict ? m->dict[codes[i]] : offset + scale * codes[i];
+			dot += a * x[m->col_ind[i]];
+		}
+
+		y[r] = dot;
+	}
+}
+
+
+/**
+  Compute MxV on CPU, quantized values.
+*/
+Matrix* cpuSpmvCSRQuant(const MatrixCSRQuant *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR quantized method on CPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, m->h);
+
+	top(0);
+	if( m->codeSize == 1 )
+		spmvQuant(m, (const uint8_t*) m->codes, v->data, mv->data);
+	else
+		spmvQuant(m, (const uint16_t*) m->codes, v->data, mv->data);
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms.\n", name, m->w, m->h, cpuRunTime);
+
+	return mv;
+}
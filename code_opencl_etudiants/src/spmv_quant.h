@@ -0,0 +1,78 @@
+#ifndef __SPMV_QUANT_H__
+#define __SPMV_QUANT_H__
+
+#include<stdint.h>
+
+#include"common.h"
+
+
+/**
+  How values are decoded from their integer codes.
+*/
+typedef enum quantMode
+{
+	QUANT_AFFINE, // value = offset + scale * code
+	QUANT_DICT    // value = dict[code]
+} QuantMode;
+
+
+/**
+  CSR matrix structure with values stored as 8 or 16 bit integer codes.
+  Decoding is exact: a matrix is only quantized if all its values can be
+  represented.
+*/
+typedef struct matrixCSRQuant
+{
+	uint w; // width
+	uint h; // height
+	uint nzNbr; // number of non zero values
+	QuantMode mode; // decoding of codes
+	uint codeSize; // size of a code in bytes, 1 or 2
+	void *codes; // array of codes of non zero values, uint8_t or uint16_t
+	float offset; // affine decoding
+	float scale; // affine decoding
+	uint dictSize; // number of values in the dictionary
+	float *dict; // dictionary decoding, sorted values
+	uint *col_ind; // array of column index of non zero values
+	uint *row_ptr; // array of row pointers
+} MatrixCSRQuant;
+
+
+/**
+  Try to quantize the values of a CSR matrix: evenly spaced values (e.g.
+  small integers) are stored as affine codes, else up to 65536 distinct
+  values are stored as indices in a dictionary. Codes take 1 byte if 256
+  codes are enough, else 2 bytes.
+  Returns NULL if values cannot be represented exactly.
+  Memory must be deallocated by user by calling deleteMatrixCSRQuant().
+*/
+MatrixCSRQuant* csrToQuant(const MatrixCSR *m);
+
+/**
+  Convert a Matrix to a quantized CSR matrix, like matrixToCSR() followed by
+  csrToQuant(). Returns NULL if values cannot be represented exactly.
+*/
+MatrixCSRQuant* matrixToCSRQuant(const Matrix *m);
+
+/**
+  Destroy a MatrixCSRQuant structure.
+*/
+void deleteMatrixCSRQuant(MatrixCSRQuant **m);
+
+
+/**
+  Compute MxV on CPU, quantized values decoded 8 at a time with AVX2 when
+  available (conversion and FMA for affine codes, gather for dictionary
+  codes), multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvCSRQuant(const MatrixCSRQuant *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU, quantized values decoded in the kernel, one row per
+  warp. Dictionaries of 8 bit codes are staged in local memory.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRQuant(const MatrixCSRQuant *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
@@ -0,0 +1,192 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<sstream>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_quant.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvCSRQuant_source =
+	"// CODE is uchar or ushort; DICT_LOCAL is set for dictionaries of 8 bit\n"
+	"// codes, which fit in local memory\n"
+	"#ifdef DICT\n"
+	"#ifdef DICT_LOCAL\n"
+	"#define DECODE(c) dictLocal[c]\n"
+	"#else\n"
+	"#define DECODE(c) dict[c]\n"
+	"#endif\n"
+	"#else\n"
+	"#define DECODE(c) (offset + scale * (float) (c))\n"
+	"#endif\n"
+	"\n"
+	"// one row per warp, codes decoded before the product\n"
+	"__kernel void kernelSpmvCSRQuant(uint rowsNbr, const __global CODE *codes, float offset, float scale,\n"
+	"	uint dictSize, const __global float *dict, const __global uint *col_ind, const __global uint *row_ptr,\n"
+	"	const __global float *v, __global float *y, __local float *dots, __local float *dictLocal)\n"
+	"{\n"
+	"	uint localId = get_local_id(0);\n"
+	"	uint r = get_global_id(0) / 32;\n"
+	"	uint lane = get_global_id(0) % 32;\n"
+	"\n"
+	"#ifdef DICT_LOCAL\n"
+	"	for(uint i = localId; i < dictSize; i += get_local_size(0))\n"
+	"		dictLocal[i] = dict[i];\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"#endif\n"
+	"\n"
+	"	float dot = 0.0f;\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"		for(uint i = row_ptr[r] + lane; i < row_end; i += 32)\n"
+	"			dot += DECODE(codes[i]) * v[col_ind[i]];\n"
+	"	}\n"
+	"	dots[localId] = dot;\n"
+	"	barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"	for(uint s = 16; s > 0; s >>= 1)\n"
+	"	{\n"
+	"		if( lane < s )\n"
+	"			dots[localId] += dots[localId + s];\n"
+	"		barrier(CLK_LOCAL_MEM_FENCE);\n"
+	"	}\n"
+	"\n"
+	"	if( lane == 0 && r < rowsNbr )\n"
+	"		y[r] = dots[localId];\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU, quantized values.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvCSRQuant(const MatrixCSRQuant *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "CSR quantized method on GPU";
+
+	if(m->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		// one program per code size and decoding
+		bool dict = (m->mode == QUANT_DICT);
+		bool dictLocal = dict && m->dictSize <= 256;
+		std::ostringstream options;
+		options << "-D CODE=" << ((m->codeSize == 1) ? "uchar" : "ushort");
+		if( dict )
+			options << " -D DICT";
+		if( dictLocal )
+			options << " -D DICT_LOCAL";
+		cl::Program program = buildProgram(kernelSpmvCSRQuant_source, options.str());
+		cl::Kernel kernel(program, "kernelSpmvCSRQuant");
+
+		// allocate global memory on GPU
+		uint nzNbr = m->nzNbr ? m->nzNbr : 1;
+		uint dictSize = dict ? m->dictSize : 1;
+		size_t codesSizeInBytes = (size_t) nzNbr * m->codeSize;
+		size_t dictSizeInBytes = (size_t) dictSize * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (m->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) m->h * sizeof(float);
+		cl::Buffer gpuCodes = acquireBuffer(CL_MEM_READ_ONLY, codesSizeInBytes);
+		cl::Buffer gpuDict = acquireBuffer(CL_MEM_READ_ONLY, dictSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_WRITE_ONLY, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( m->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuCodes, CL_TRUE, 0, (size_t) m->nzNbr * m->codeSize, m->codes);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, (size_t) m->nzNbr * sizeof(uint), m->col_ind);
+		}
+		if( dict )
+			queue.enqueueWriteBuffer(gpuDict, CL_TRUE, 0, dictSizeInBytes, m->dict);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, m->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size, one warp of 32 work items per row
+		uint nbWarpsPerBlock = 8;
+		size_t work_group_size = 32 * nbWarpsPerBlock;
+		size_t global_work_size = ((m->h + nbWarpsPerBlock - 1) / nbWarpsPerBlock) * work_group_size;
+
+		// set the arguments to our compute kernel
+		kernel.setArg(0, m->h);
+		kernel.setArg(1, gpuCodes);
+		kernel.setArg(2, m->offset);
+		kernel.setArg(3, m->scale);
+		kernel.setArg(4, dictSize);
+		kernel.setArg(5, gpuDict);
+		kernel.setArg(6, gpuCol_ind);
+		kernel.setArg(7, gpuRow_ptr);
+		kernel.setArg(8, gpuV);
+		kernel.setArg(9, gpuMV);
+		kernel.setArg(10, sizeof(float) * work_group_size, NULL);
+		kernel.setArg(11, sizeof(float) * (dictLocal ? 256 : 1), NULL);
+
+		// run kernel
+		top(1);
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, mvSizeInBytes, mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuCodes);
+		releaseBuffer(gpuDict);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->w, m->h, gpuRunTime, gpuComputeTime);
+
+	return mv;
+}
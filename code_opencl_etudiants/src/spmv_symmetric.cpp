@@ -0,0 +1,239 @@
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+#include<omp.h>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"memory_pool.h"
+#include"spmv_symmetric.h"
+
+
+/**
+  Returns 'true' if a CSR matrix is symmetric.
+*/
+bool isSymmetricCSR(const MatrixCSR *m)
+{
+	if( m->w != m->h )
+		return false;
+
+	MatrixCSR *t = transposeCSR(m);
+	bool symmetric = true;
+
+	#pragma omp parallel for schedule(dynamic, 64) reduction(&&:symmetric)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		if( m->row_ptr[r+1] != t->row_ptr[r+1] )
+		{
+			symmetric = false;
+			continue;
+		}
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			if( m->col_ind[i] != t->col_ind[i] || m->data[i] != t->data[i] )
+				symmetric = false;
+		}
+	}
+
+	deleteMatrixCSR(&t);
+	return symmetric;
+}
+
+
+/**
+  Convert a symmetric MatrixCSR to a MatrixCSRSym.
+*/
+MatrixCSRSym* csrToSymmetric(const MatrixCSR *m)
+{
+	if( m->w != m->h )
+		throw std::runtime_error("Failed to convert matrix to symmetric storage, matrix isn't square.");
+
+	// values of the upper triangle of each row
+	std::vector<uint> rowLen(m->h + 1, 0);
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint len = 0;
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			len += (m->col_ind[i] >= (uint) r) ? 1 : 0;
+		rowLen[r + 1] = len;
+	}
+	for(uint r = 0; r < m->h; r++)
+		rowLen[r + 1] += rowLen[r];
+
+	MatrixCSR *u = createMatrixCSR(m->w, m->h, rowLen[m->h]);
+	std::copy(rowLen.begin(), rowLen.end(), u->row_ptr);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(long r = 0; r < (long) m->h; r++)
+	{
+		uint k = u->row_ptr[r];
+		for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+		{
+			if( m->col_ind[i] >= (uint) r )
+			{
+				u->col_ind[k] = m->col_ind[i];
+				u->data[k] = m->data[i];
+				k++;
+			}
+		}
+	}
+
+	MatrixCSRSym *s = (MatrixCSRSym*) malloc(sizeof(MatrixCSRSym));
+	if( ! s )
+		throw std::runtime_error("Failed to allocate symmetric matrix.");
+
+	s->upper = u;
+	s->blocksNbr = (uint) omp_get_max_threads();
+	s->block_ptr = (uint*) malloc((s->blocksNbr + 1) * sizeof(uint));
+	s->reach = (uint*) malloc(s->blocksNbr * sizeof(uint));
+	if( ! s->block_ptr || ! s->reach )
+		throw std::runtime_error("Failed to allocate symmetric matrix.");
+
+	// blocks with the same number of stored values
+	s->block_ptr[0] = 0;
+	for(uint b = 1; b < s->blocksNbr; b++)
+	{
+		uint target = (uint) ((double) u->nzNbr * b / s->blocksNbr);
+		uint r = (uint) (std::lower_bound(u->row_ptr, u->row_ptr + u->h + 1, target) - u->row_ptr);
+		s->block_ptr[b] = std::max(s->block_ptr[b-1], std::min(r, u->h));
+	}
+	s->block_ptr[s->blocksNbr] = u->h;
+
+	// rows below each block reached by its mirrored values
+	#pragma omp parallel for schedule(static, 1)
+	for(long b = 0; b < (long) s->blocksNbr; b++)
+	{
+		uint reach = s->block_ptr[b+1];
+		for(uint i = u->row_ptr[s->block_ptr[b]]; i < u->row_ptr[s->block_ptr[b+1]]; i++)
+			reach = std::max(reach, u->col_ind[i] + 1);
+		s->reach[b] = reach;
+	}
+
+	return s;
+}
+
+
+/**
+  Destroy a MatrixCSRSym structure.
+*/
+void deleteMatrixCSRSym(MatrixCSRSym **m)
+{
+	if( ! *m )
+		return;
+
+	deleteMatrixCSR(&(*m)->upper);
+	free((*m)->block_ptr);
+	free((*m)->reach);
+	free(*m);
+	*m = NULL;
+}
+
+
+/**
+  Compute MxV on CPU for a symmetric matrix.
+*/
+Matrix* cpuSpmvSymmetric(const MatrixCSRSym *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "Symmetric method on CPU";
+	const MatrixCSR *u = m->upper;
+
+	if(u->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	Matrix *mv = createMatrix(v->w, u->h);
+	const float *x = v->data;
+	float *y = mv->data;
+
+	// buffer of each block for the rows it reaches below it
+	std::vector<float*> buffers(m->blocksNbr, (float*) NULL);
+
+	top(0);
+
+	#pragma omp parallel
+	{
+		#pragma omp for schedule(static, 1)
+		for(long b = 0; b < (long) m->blocksNbr; b++)
+		{
+			uint r0 = m->block_ptr[b];
+			uint r1 = m->block_ptr[b+1];
+			size_t bufferSize = m->reach[b] - r1;
+			float *buffer = NULL;
+			if( bufferSize )
+			{
+				buffer = (float*) poolAlloc(bufferSize * sizeof(float));
+				memset(buffer, 0, bufferSize * sizeof(float));
+			}
+			buffers[b] = buffer;
+
+			for(uint r = r0; r < r1; r++)
+				y[r] = 0.0f;
+
+			for(uint r = r0; r < r1; r++)
+			{
+				float xr = x[r];
+				float dot = 0.0f;
+				for(uint i = u->row_ptr[r]; i < u->row_ptr[r+1]; i++)
+				{
+					uint c = u->col_ind[i];
+					float a = u->data[i];
+					dot += a * x[c];
+
+					// mirrored value (c, r)
+					if( c > r )
+					{
+						if( c < r1 )
+							y[c] += a * xr;
+						else
+							buffer[c - r1] += a * xr;
+					}
+				}
+				y[r] += dot;
+			}
+		}
+		// implicit barrier, all buffers are ready
+
+		// each block adds the buffers of the blocks above it
+		#pragma omp for schedule(static, 1)
+		for(long b = 0; b < (long) m->blocksNbr; b++)
+		{
+			uint r0 = m->block_ptr[b];
+			for(uint a = 0; a < (uint) b; a++)
+			{
+				uint a1 = m->block_ptr[a+1];
+				uint r1 = std::min(m->block_ptr[b+1], m->reach[a]);
+				const float *buffer = buffers[a];
+
+				#pragma omp simd
+				for(uint r = r0; r < r1; r++)
+					y[r] += buffer[r - a1];
+			}
+		}
+	}
+
+	for(uint b = 0; b < m->blocksNbr; b++)
+	{
+		if( buffers[b] )
+			poolFree(buffers[b]);
+	}
+
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms, %d values stored.\n", name, u->w, u->h, cpuRunTime, u->nzNbr);
+
+	return mv;
+}
@@ -0,0 +1,59 @@
+#ifndef __SPMV_SYMMETRIC_H__
+#define __SPMV_SYMMETRIC_H__
+
+#include"common.h"
+
+
+/**
+  Symmetric matrix stored by its upper triangle, diagonal included, in CSR
+  format: value (r, c) with c > r also stands for value (c, r).
+  Rows are split in blocks with the same number of stored values, one per
+  thread on CPU. Values of the lower triangle of a block go to rows below
+  the block, up to reach.
+*/
+typedef struct matrixCSRSym
+{
+	MatrixCSR *upper; // upper triangle, diagonal included
+	uint blocksNbr; // number of row blocks
+	uint *block_ptr; // first row of each block, blocksNbr+1 values
+	uint *reach; // 1 + last row reached by each block, at least its end
+} MatrixCSRSym;
+
+
+/**
+  Returns 'true' if a CSR matrix with sorted column indices is symmetric,
+  structure and values.
+*/
+bool isSymmetricCSR(const MatrixCSR *m);
+
+/**
+  Convert a symmetric MatrixCSR to a MatrixCSRSym, keeping its upper
+  triangle. Symmetry isn't checked, see isSymmetricCSR().
+  Memory must be deallocated by user by calling deleteMatrixCSRSym().
+*/
+MatrixCSRSym* csrToSymmetric(const MatrixCSR *m);
+
+/**
+  Destroy a MatrixCSRSym structure.
+*/
+void deleteMatrixCSRSym(MatrixCSRSym **m);
+
+
+/**
+  Compute MxV on CPU for a symmetric matrix. Each thread computes a block
+  of rows: values of the upper triangle are used once per row, and once as
+  their mirrored value, added to y in the block or to a buffer of the
+  thread for rows below it. Buffers are added to y after all blocks are
+  done, each thread adding them on its own rows. Multithreaded with OpenMP.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvSymmetric(const MatrixCSRSym *m, const Matrix *v, const Matrix *reference = NULL);
+
+/**
+  Compute MxV on GPU for a symmetric matrix, one row per work item: the dot
+  product of the row, and mirrored values added to y with atomics.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvSymmetric(const MatrixCSRSym *m, const Matrix *v, const Matrix *reference = NULL);
+
+#endif
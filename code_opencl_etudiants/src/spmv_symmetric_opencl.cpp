@@ -0,0 +1,158 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"spmv_symmetric.h"
+#include"benchmark.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvSymmetric_source =
+	KERNEL_ATOMICS_SOURCE
+	"// one row of the upper triangle per work item\n"
+	"__kernel void kernelSpmvSymmetric(uint rowsNbr, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global uint *row_ptr, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float xr = x[r];\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_ptr[r]; i < row_end; i++)\n"
+	"		{\n"
+	"			uint c = col_ind[i];\n"
+	"			float a = values[i];\n"
+	"			dot += a * x[c];\n"
+	"\n"
+	"			// mirrored value (c, r)\n"
+	"			if( c != r )\n"
+	"				atomicAddFloat(&y[c], a * xr);\n"
+	"		}\n"
+	"\n"
+	"		// other rows add their mirrored values to y[r] too\n"
+	"		atomicAddFloat(&y[r], dot);\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute MxV on GPU for a symmetric matrix.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvSymmetric(const MatrixCSRSym *m, const Matrix *v, const Matrix *reference)
+{
+	const char *name = "Symmetric method on GPU";
+	const MatrixCSR *u = m->upper;
+
+	if(u->w != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	// output matrix size
+	uint width = v->w;
+	uint height = u->h;
+	Matrix *mv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvSymmetric_source);
+		cl::Kernel kernelZero(program, "kernelZero");
+		cl::Kernel kernel(program, "kernelSpmvSymmetric");
+
+		// allocate global memory on GPU
+		uint nzNbr = u->nzNbr ? u->nzNbr : 1;
+		size_t valuesSizeInBytes = (size_t) nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (u->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) v->h * sizeof(float);
+		size_t mvSizeInBytes = (size_t) (u->h ? u->h : 1) * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMV = acquireBuffer(CL_MEM_READ_WRITE, mvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		top(0); // start time measurement
+		if( u->nzNbr )
+		{
+			queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, valuesSizeInBytes, u->data);
+			queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, col_indSizeInBytes, u->col_ind);
+		}
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, u->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = (((size_t) u->h + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernels
+		kernelZero.setArg(0, u->h);
+		kernelZero.setArg(1, gpuMV);
+		kernel.setArg(0, u->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuV);
+		kernel.setArg(5, gpuMV);
+
+		// run kernels, y accumulates mirrored values so it must be cleared first
+		top(1);
+		if( u->h )
+		{
+			queue.enqueueNDRangeKernel(kernelZero, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+		}
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		if( u->h )
+			queue.enqueueReadBuffer(gpuMV, CL_TRUE, 0, (size_t) u->h * sizeof(float), mv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	recordComputeTime(gpuComputeTime);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: M(%dx%d)xV computed in %f ms (%f ms of pure computation), %d values stored.\n", name, u->w, u->h, gpuRunTime, gpuComputeTime, u->nzNbr);
+
+	return mv;
+}
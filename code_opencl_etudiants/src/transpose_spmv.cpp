@@ -0,0 +1,96 @@
+#include<stdexcept>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"transpose_spmv.h"
+
+
+/**
+  Choose how to compute Mt.x.
+*/
+TransposeMethod chooseTransposeMethod(const MatrixCSR *m)
+{
+	// mean number of threads adding into the same y value
+	const uint maxNzPerColumn = 32;
+
+	if( m->nzNbr > (unsigned long) maxNzPerColumn * m->w )
+		return TRANSPOSE_CSC;
+	else
+		return TRANSPOSE_SCATTER;
+}
+
+
+/**
+  Compute Mt x V on CPU.
+*/
+Matrix* cpuSpmvTranspose(const MatrixCSR *m, const Matrix *v, MatrixCSR **csc, const Matrix *reference, TransposeMethod method)
+{
+	if(m->h != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	if( method == TRANSPOSE_AUTO )
+		method = chooseTransposeMethod(m);
+	const char *name = (method == TRANSPOSE_CSC) ? "Transpose CSC method on cpu" : "Transpose scatter method on cpu";
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->w;
+	Matrix *mtv = createMatrix(width, height);
+	float *y = mtv->data;
+	const float *x = v->data;
+
+	top(0);
+	if( method == TRANSPOSE_CSC )
+	{
+		// build CSC view once, keep it if the caller wants it
+		MatrixCSR *t = csc ? *csc : NULL;
+		if( ! t )
+			t = transposeCSR(m);
+
+		#pragma omp parallel for schedule(dynamic, 64)
+		for(long r = 0; r < (long) t->h; r++)
+		{
+			float dot = 0.0f;
+			for(uint i = t->row_ptr[r]; i < t->row_ptr[r+1]; i++)
+				dot += t->data[i] * x[t->col_ind[i]];
+			y[r] = dot;
+		}
+
+		if( csc )
+			*csc = t;
+		else
+			deleteMatrixCSR(&t);
+	}
+	else
+	{
+		for(uint c = 0; c < height; c++)
+			y[c] = 0.0f;
+
+		#pragma omp parallel for schedule(dynamic, 64)
+		for(long r = 0; r < (long) m->h; r++)
+		{
+			float xr = x[r];
+			for(uint i = m->row_ptr[r]; i < m->row_ptr[r+1]; i++)
+			{
+				#pragma omp atomic
+				y[m->col_ind[i]] += m->data[i] * xr;
+			}
+		}
+	}
+	double cpuRunTime = top(0);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mtv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: Mt(%dx%d)xV computed in %f ms.\n", name, m->h, m->w, cpuRunTime);
+
+	return mtv;
+}
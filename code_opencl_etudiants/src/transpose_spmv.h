@@ -0,0 +1,39 @@
+#ifndef __TRANSPOSE_SPMV_H__
+#define __TRANSPOSE_SPMV_H__
+
+#include"common.h"
+
+
+/**
+  Methods to compute y = Mt.x from the CSR storage of M.
+*/
+typedef enum transposeMethod
+{
+	TRANSPOSE_AUTO,    // choose from matrix shape, see chooseTransposeMethod()
+	TRANSPOSE_SCATTER, // one row of M per thread, atomic add into y
+	TRANSPOSE_CSC      // row product on the CSC view of M, built once
+} TransposeMethod;
+
+
+/**
+  Choose how to compute Mt.x.
+  Atomic scatter conflicts grow with the number of non zero values per
+  column: it is used for wide matrices, and the CSC view for tall ones.
+*/
+TransposeMethod chooseTransposeMethod(const MatrixCSR *m);
+
+
+/**
+  Compute Mt x V on CPU, without materializing Mt unless the CSC method is
+  chosen. If csc is not NULL, the CSC view is cached in *csc (built on first
+  call if *csc is NULL) and must be deallocated by user with deleteMatrixCSR().
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* cpuSpmvTranspose(const MatrixCSR *m, const Matrix *v, MatrixCSR **csc = NULL, const Matrix *reference = NULL, TransposeMethod method = TRANSPOSE_AUTO);
+
+/**
+  Same as cpuSpmvTranspose(), on GPU.
+*/
+Matrix* gpuSpmvTranspose(const MatrixCSR *m, const Matrix *v, MatrixCSR **csc = NULL, const Matrix *reference = NULL, TransposeMethod method = TRANSPOSE_AUTO);
+
+#endif
@@ -0,0 +1,175 @@
+#include"opencl_tools.h"
+
+#include<cstdio>
+#include<stdexcept>
+
+#include"tools.h"
+#include"csr_tools.h"
+#include"transpose_spmv.h"
+
+
+//---------------------------------------------------------
+
+std::string kernelSpmvTranspose_source =
+	KERNEL_ATOMICS_SOURCE
+	"// one row of M per work item, scatter into y = Mt.x\n"
+	"__kernel void kernelSpmvTransposeScatter(uint rowsNbr, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global uint *row_ptr, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float xr = x[r];\n"
+	"		uint row_beg = row_ptr[r];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_beg; i < row_end; i++)\n"
+	"			atomicAddFloat(&y[col_ind[i]], values[i] * xr);\n"
+	"	}\n"
+	"}\n"
+	"\n"
+	"// one row of the CSC view (column of M) per work item\n"
+	"__kernel void kernelSpmvTransposeCSC(uint rowsNbr, const __global float *values, const __global uint *col_ind,\n"
+	"	const __global uint *row_ptr, const __global float *x, __global float *y)\n"
+	"{\n"
+	"	uint r = get_global_id(0);\n"
+	"	if( r < rowsNbr )\n"
+	"	{\n"
+	"		float dot = 0.0f;\n"
+	"		uint row_beg = row_ptr[r];\n"
+	"		uint row_end = row_ptr[r+1];\n"
+	"\n"
+	"		for(uint i = row_beg; i < row_end; i++)\n"
+	"			dot += values[i] * x[col_ind[i]];\n"
+	"\n"
+	"		y[r] = dot;\n"
+	"	}\n"
+	"}\n";
+
+//---------------------------------------------------------
+
+/**
+  Compute Mt x V on GPU.
+  A reference result can be passed to check that the computation is ok.
+*/
+Matrix* gpuSpmvTranspose(const MatrixCSR *m, const Matrix *v, MatrixCSR **csc, const Matrix *reference, TransposeMethod method)
+{
+	if(m->h != v->h)
+		throw std::runtime_error("Failed to multiply matrices, size mismatch.");
+	if(v->w != 1)
+		throw std::runtime_error("Failed to multiply matrices, vector size mismatch.");
+
+	if( method == TRANSPOSE_AUTO )
+		method = chooseTransposeMethod(m);
+	const char *name = (method == TRANSPOSE_CSC) ? "Transpose CSC method on GPU" : "Transpose scatter method on GPU";
+
+	// output matrix size
+	uint width = v->w;
+	uint height = m->w;
+	Matrix *mtv = createMatrix(width, height);
+
+	// time measurement storage
+	double gpuRunTime = 0;
+	double gpuComputeTime = 0;
+
+	top(0); // start time measurement
+
+	// the CSC view is built on CPU once, and kept if the caller wants it
+	MatrixCSR *t = NULL;
+	const MatrixCSR *a = m;
+	if( method == TRANSPOSE_CSC )
+	{
+		t = csc ? *csc : NULL;
+		if( ! t )
+			t = transposeCSR(m);
+		if( csc )
+			*csc = t;
+		a = t;
+	}
+
+	try
+	{
+		OpenCLEnv &env = getOpenCLEnv();
+		cl::CommandQueue &queue = env.queue;
+
+		cl::Program program = buildProgram(kernelSpmvTranspose_source);
+		cl::Kernel kernelZero(program, "kernelZero");
+		cl::Kernel kernel(program, (method == TRANSPOSE_CSC) ? "kernelSpmvTransposeCSC" : "kernelSpmvTransposeScatter");
+
+		// allocate global memory on GPU
+		size_t valuesSizeInBytes = (size_t) a->nzNbr * sizeof(float);
+		size_t col_indSizeInBytes = (size_t) a->nzNbr * sizeof(uint);
+		size_t row_ptrSizeInBytes = (size_t) (a->h + 1) * sizeof(uint);
+		size_t vSizeInBytes = (size_t) (v->h) * sizeof(float);
+		size_t mtvSizeInBytes = (size_t) height * sizeof(float);
+		cl::Buffer gpuValues = acquireBuffer(CL_MEM_READ_ONLY, valuesSizeInBytes);
+		cl::Buffer gpuCol_ind = acquireBuffer(CL_MEM_READ_ONLY, col_indSizeInBytes);
+		cl::Buffer gpuRow_ptr = acquireBuffer(CL_MEM_READ_ONLY, row_ptrSizeInBytes);
+		cl::Buffer gpuV = acquireBuffer(CL_MEM_READ_ONLY, vSizeInBytes);
+		cl::Buffer gpuMtV = acquireBuffer(CL_MEM_READ_WRITE, mtvSizeInBytes);
+
+		// transfer data from CPU memory to GPU memory
+		queue.enqueueWriteBuffer(gpuValues, CL_TRUE, 0, valuesSizeInBytes, a->data);
+		queue.enqueueWriteBuffer(gpuCol_ind, CL_TRUE, 0, col_indSizeInBytes, a->col_ind);
+		queue.enqueueWriteBuffer(gpuRow_ptr, CL_TRUE, 0, row_ptrSizeInBytes, a->row_ptr);
+		queue.enqueueWriteBuffer(gpuV, CL_TRUE, 0, vSizeInBytes, v->data);
+
+		// set workgroup and grid size
+		size_t work_group_size = 256;
+		size_t global_work_size = ((a->h + work_group_size - 1) / work_group_size) * work_group_size;
+		size_t global_zero_size = ((height + work_group_size - 1) / work_group_size) * work_group_size;
+
+		// set the arguments to our compute kernels
+		kernelZero.setArg(0, height);
+		kernelZero.setArg(1, gpuMtV);
+		kernel.setArg(0, a->h);
+		kernel.setArg(1, gpuValues);
+		kernel.setArg(2, gpuCol_ind);
+		kernel.setArg(3, gpuRow_ptr);
+		kernel.setArg(4, gpuV);
+		kernel.setArg(5, gpuMtV);
+
+		// run kernels, scatter accumulates in y so it must be cleared first
+		top(1);
+		if( method == TRANSPOSE_SCATTER )
+			queue.enqueueNDRangeKernel(kernelZero, cl::NullRange, cl::NDRange(global_zero_size), cl::NDRange(work_group_size));
+		queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_work_size), cl::NDRange(work_group_size));
+
+		// Wait for the command queue to get serviced before reading back results
+		queue.finish();
+		gpuComputeTime = top(1); // pure computation duration
+
+		// transfer data from GPU memory to CPU memory
+		queue.enqueueReadBuffer(gpuMtV, CL_TRUE, 0, mtvSizeInBytes, mtv->data);
+		gpuRunTime = top(0); // computation and memory transfert duration
+
+		// give buffers back to the pool for the next calls
+		releaseBuffer(gpuValues);
+		releaseBuffer(gpuCol_ind);
+		releaseBuffer(gpuRow_ptr);
+		releaseBuffer(gpuV);
+		releaseBuffer(gpuMtV);
+	}
+	catch( cl::Error err )
+	{
+		printOpenCLError(err);
+
+		throw std::runtime_error("Aborting.");
+	}
+
+	if( t && ! csc )
+		deleteMatrixCSR(&t);
+
+	// check result, display run time if result is correct
+	bool displayRunTime = true;
+	if( reference )
+	{
+		if(! checkResult(name, reference, mtv))
+			displayRunTime = false;
+	}
+
+	if(displayRunTime)
+		printf("%s: Mt(%dx%d)xV computed in %f ms (%f ms of pure computation).\n", name, m->h, m->w, gpuRunTime, gpuComputeTime);
+
+	return mtv;
+}